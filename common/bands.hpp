@@ -0,0 +1,64 @@
+#ifndef COMMON_BANDS_HPP
+#define COMMON_BANDS_HPP
+
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <span>
+#include <vector>
+
+namespace common {
+  constexpr std::size_t BAND_BYTES = std::size_t{4} << 20U;  // Bytes de entrada por banda
+
+  // Banda de filas consecutivas de la carga útil de entrada
+  struct row_band {
+    std::size_t first_row = 0;
+    std::size_t rows      = 0;
+    std::span<std::uint8_t const> data;
+  };
+
+  // Número de filas por banda para que cada una ocupe unos BAND_BYTES de entrada
+  inline std::size_t band_rows(image_header const & header) {
+    std::size_t const row_bytes = std::max<std::size_t>(1, header.width * CHANNELS * header.sample_size());
+    return std::max<std::size_t>(1, BAND_BYTES / row_bytes);
+  }
+
+  // Recorre la imagen por bandas de filas con doble búfer: transform(banda, salida) rellena el búfer
+  // de una banda mientras la anterior se escribe en otro hilo. La memoria usada es O(banda): las
+  // páginas de entrada ya procesadas se liberan y las de la banda siguiente se piden por adelantado.
+  // rows_per_band fija las filas de cada banda; con 0 se usa band_rows
+  template <typename Fn>
+  void stream_bands(ImageInput const & input, ImageOutput & output, Fn && transform, std::size_t rows_per_band = 0) {
+    image_header const & header = input.header();
+    std::size_t const row_bytes = header.width * CHANNELS * header.sample_size();
+    std::size_t const step      = rows_per_band == 0 ? band_rows(header) : rows_per_band;
+    auto const payload          = input.payload(row_bytes * header.height);
+
+    std::array<std::vector<std::uint8_t>, 2> buffers;
+    std::future<void> pending;
+    std::size_t band_index = 0;
+    for (std::size_t first = 0; first < header.height; first += step, ++band_index) {
+      std::size_t const rows = std::min(step, header.height - first);
+      input.prefetch((first + rows) * row_bytes, step * row_bytes);
+      auto & buffer = buffers.at(band_index % 2);
+      transform(row_band{.first_row = first,
+                         .rows      = rows,
+                         .data      = payload.subspan(first * row_bytes, rows * row_bytes)},
+                buffer);
+      if (pending.valid()) { pending.get(); }
+      pending = std::async(std::launch::async, [&output, &buffer] {
+        output.write(std::span<std::uint8_t const>(buffer));
+        output.flush();
+      });
+      input.release(first * row_bytes, rows * row_bytes);
+    }
+    if (pending.valid()) { pending.get(); }
+  }
+}  // namespace common
+
+#endif  // COMMON_BANDS_HPP
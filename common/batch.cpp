@@ -0,0 +1,78 @@
+#include "common/batch.hpp"
+
+#include "common/probe.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace common {
+  namespace {
+    constexpr std::size_t INPUT_ARG     = 1;
+    constexpr std::size_t OUTPUT_ARG    = 2;
+    constexpr std::size_t OPERATION_ARG = 3;
+
+    // Nombre de la salida de file en output_dir: compress escribe un .cppm y decompress un .ppm; el
+    // resto de operaciones conserva el nombre de la entrada
+    std::filesystem::path output_path(std::string const & output_dir, std::string const & file,
+                                      std::span<std::string const> operation) {
+      std::filesystem::path output = std::filesystem::path(output_dir) / std::filesystem::path(file).filename();
+      if (!operation.empty() && operation.front() == "compress") { output.replace_extension(".cppm"); }
+      if (!operation.empty() && operation.front() == "decompress") { output.replace_extension(".ppm"); }
+      return output;
+    }
+  }  // namespace
+
+  bool read_manifest(std::string const & filename, std::string const & program, std::vector<batch_job> & jobs) {
+    std::ifstream manifest(filename);
+    if (manifest.fail()) { return false; }
+    std::string line;
+    while (std::getline(manifest, line)) {
+      std::istringstream words(line);
+      batch_job job{program};
+      for (std::string word; words >> word;) { job.push_back(word); }
+      if (job.size() == 1 || job[1].starts_with('#')) { continue; }
+      jobs.push_back(std::move(job));
+    }
+    return true;
+  }
+
+  std::vector<batch_job> directory_jobs(std::string const & program, std::string const & input_dir,
+                                        std::string const & output_dir, std::span<std::string const> operation) {
+    std::vector<batch_job> jobs;
+    for (auto const & file : list_files(input_dir)) {
+      batch_job job{program, file, output_path(output_dir, file, operation).string()};
+      job.insert(job.end(), operation.begin(), operation.end());
+      jobs.push_back(std::move(job));
+    }
+    return jobs;
+  }
+
+  bool batch_requested(std::vector<std::string> const & args, progargsCommon::options const & opts) {
+    if (!opts.batch.empty()) { return true; }
+    std::error_code error;
+    return args.size() > OPERATION_ARG && args[OPERATION_ARG] != "info" &&
+           std::filesystem::is_directory(args[INPUT_ARG], error);
+  }
+
+  bool collect_jobs(std::vector<std::string> const & args, progargsCommon::options const & opts,
+                    std::vector<batch_job> & jobs) {
+    if (!opts.batch.empty()) {
+      if (!read_manifest(opts.batch, args.front(), jobs)) {
+        std::cerr << "Error opening manifest " << opts.batch << '\n';
+        return false;
+      }
+      return true;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(args[OUTPUT_ARG], error);
+    if (!std::filesystem::is_directory(args[OUTPUT_ARG], error)) {
+      std::cerr << "Error : Output " << args[OUTPUT_ARG] << " must be a directory\n";
+      return false;
+    }
+    jobs = directory_jobs(args.front(), args[INPUT_ARG], args[OUTPUT_ARG],
+                          std::span(args).subspan(OPERATION_ARG));
+    return true;
+  }
+}  // namespace common
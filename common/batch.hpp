@@ -0,0 +1,70 @@
+#ifndef COMMON_BATCH_HPP
+#define COMMON_BATCH_HPP
+
+#include "common/parallel.hpp"
+#include "common/progargs.hpp"
+#include "common/recycle.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace common {
+  // Trabajo del modo batch: los argumentos posicionales de una invocación normal,
+  // "programa entrada salida operación [valores]", y opcionalmente sus propias opciones "--..."
+  using batch_job = std::vector<std::string>;
+
+  // Lee un manifiesto con un trabajo por línea, "entrada salida operación [valores] [--opciones]"
+  // separados por espacios; se ignoran las líneas vacías y las que empiezan por '#'. Devuelve
+  // false si no se puede abrir
+  bool read_manifest(std::string const & filename, std::string const & program, std::vector<batch_job> & jobs);
+
+  // Un trabajo por fichero de input_dir (list_files) con la salida del mismo nombre en output_dir,
+  // que se crea si no existe, salvo la extensión: .cppm con compress y .ppm con decompress.
+  // operation es la operación y sus valores
+  std::vector<batch_job> directory_jobs(std::string const & program, std::string const & input_dir,
+                                        std::string const & output_dir, std::span<std::string const> operation);
+
+  // Modo batch: "--batch MANIFIESTO" o una entrada que es un directorio (salvo info, que ya
+  // sondea directorios por su cuenta)
+  bool batch_requested(std::vector<std::string> const & args, progargsCommon::options const & opts);
+  // Trabajos del modo batch; false y mensaje si el manifiesto no se puede leer o la salida no es
+  // un directorio
+  bool collect_jobs(std::vector<std::string> const & args, progargsCommon::options const & opts,
+                    std::vector<batch_job> & jobs);
+
+  // Hilos de cada trabajo cuando jobs trabajos se reparten threads hilos: uno si hay trabajos de
+  // sobra y, si no, los que sobran repartidos entre los trabajos
+  inline unsigned int job_threads(std::size_t jobs, unsigned int threads) {
+    return static_cast<unsigned int>(std::max<std::size_t>(1, threads / std::max<std::size_t>(1, jobs)));
+  }
+
+  // Ejecuta run(trabajo, hilos) por trabajo en un grupo acotado de hilos que los van tomando según
+  // quedan libres. Cada hilo reutiliza sus búferes de imagen de un trabajo al siguiente
+  // (recycle_scope). run devuelve false si el trabajo falla; una excepción se informa y cuenta
+  // como fallo sin detener el lote. Devuelve el número de trabajos fallidos
+  template <typename Fn>
+  std::size_t run_batch(std::span<batch_job const> jobs, unsigned int threads, Fn const & run) {
+    unsigned int const inner   = job_threads(jobs.size(), threads);
+    unsigned int const workers = std::max(1U, threads / inner);
+    std::atomic<std::size_t> failed{0};
+    parallel_chunks(jobs.size(), 1, workers, [&](std::size_t first, std::size_t) {
+      recycle_scope const recycling;
+      batch_job const & job = jobs[first];
+      try {
+        if (!run(job, inner)) { ++failed; }
+      } catch (std::exception const & error) {
+        std::cerr << (job.size() > 1 ? job[1] : std::string{}) << ": " << error.what() << '\n';
+        ++failed;
+      }
+    });
+    return failed.load();
+  }
+}  // namespace common
+
+#endif  // COMMON_BATCH_HPP
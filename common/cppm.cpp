@@ -0,0 +1,134 @@
+#include "common/cppm.hpp"
+
+#include "common/cpu.hpp"
+#include "common/palette.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#endif
+
+namespace common {
+  namespace {
+    constexpr std::size_t NARROW_ENTRY = 4;  // r, g, b y relleno
+    constexpr std::size_t WIDE_ENTRY   = 8;  // Tres muestras de 16 bits y relleno
+    constexpr std::array<std::size_t, 3> INDEX_WIDTHS = {1, 2, 4};
+
+    std::uint32_t index_at(std::span<std::uint8_t const> indices, std::size_t width, std::size_t position) {
+      if (width == sizeof(std::uint8_t)) { return sample_at<std::uint8_t>(indices, position); }
+      if (width == sizeof(std::uint16_t)) { return sample_at<std::uint16_t>(indices, position); }
+      return sample_at<std::uint32_t>(indices, position);
+    }
+
+    void expand_scalar(std::span<std::uint8_t const> indices, std::size_t width, cppm_palette const & palette,
+                       std::span<std::uint8_t> out) {
+      std::size_t const entry = palette.sample == 1 ? NARROW_ENTRY : WIDE_ENTRY;
+      std::size_t const pixel = CHANNELS * palette.sample;
+      for (std::size_t i = 0; i < indices.size() / width; ++i) {
+        std::uint32_t const index = index_at(indices, width, i);
+        if (index >= palette.colors) { throw std::runtime_error("Invalid color index in CPPM data."); }
+        std::memcpy(out.subspan(i * pixel, pixel).data(), palette.entries.subspan(index * entry, pixel).data(), pixel);
+      }
+    }
+
+#if defined(__x86_64__)
+    constexpr std::size_t LANES = 8;
+    constexpr std::size_t STORE = 32;  // Bytes escritos por cada store de 256 bits
+
+    // Carga 8 índices de 1, 2 o 4 bytes ampliados a 32 bits
+    __attribute__((target("avx2"))) __m256i load_indices(std::span<std::uint8_t const> indices, std::size_t width) {
+      if (width == sizeof(std::uint8_t)) {
+        std::int64_t packed = 0;
+        std::memcpy(&packed, indices.data(), sizeof(packed));
+        return _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(packed));
+      }
+      if (width == sizeof(std::uint16_t)) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(indices.data())));
+      }
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(indices.data()));
+    }
+
+    // Paleta de 8 bits: gather de 8 colores de 32 bits, se quitan los bytes de relleno y se guardan
+    // 24 bytes seguidos. Devuelve cuántos píxeles expandió; el resto (y cualquier bloque con un
+    // índice inválido) queda para el camino escalar
+    __attribute__((target("avx2"))) std::size_t expand_avx2(std::span<std::uint8_t const> indices, std::size_t width,
+                                                             cppm_palette const & palette,
+                                                             std::span<std::uint8_t> out) {
+      __m256i const bound   = _mm256_set1_epi32(static_cast<int>(palette.colors - 1));
+      __m256i const drop    = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,  // NOLINT
+                                               0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+      __m256i const compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);  // NOLINT(*-magic-numbers)
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto const * base = reinterpret_cast<int const *>(palette.entries.data());
+      std::size_t const count = indices.size() / width;
+      std::size_t done        = 0;
+      for (; done + LANES <= count && (done * CHANNELS) + STORE <= out.size(); done += LANES) {
+        __m256i const index = load_indices(indices.subspan(done * width, LANES * width), width);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_min_epu32(index, bound), index)) != -1) { break; }
+        __m256i const colors = _mm256_i32gather_epi32(base, index, NARROW_ENTRY);
+        __m256i const packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(colors, drop), compact);
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.subspan(done * CHANNELS, STORE).data()), packed);
+      }
+      return done;
+    }
+#endif
+
+    // Lee la paleta del fichero y la empaqueta con entradas de tamaño fijo
+    std::vector<std::uint8_t> pack_palette(std::span<std::uint8_t const> table, std::size_t colors,
+                                           std::size_t sample) {
+      std::size_t const entry = sample == 1 ? NARROW_ENTRY : WIDE_ENTRY;
+      std::vector<std::uint8_t> entries(colors * entry, 0);
+      for (std::size_t color = 0; color < colors; ++color) {
+        std::memcpy(std::span(entries).subspan(color * entry).data(),
+                    table.subspan(color * CHANNELS * sample, CHANNELS * sample).data(), CHANNELS * sample);
+      }
+      return entries;
+    }
+  }  // namespace
+
+  std::size_t stored_index_size(ImageInput const & input) {
+    image_header const & header = input.header();
+    std::size_t const table     = header.colors * CHANNELS * header.sample_size();
+    std::size_t const pixels    = header.pixel_count();
+    if (pixels > 0 && input.payload_size() > table && (input.payload_size() - table) % pixels == 0) {
+      std::size_t const width = (input.payload_size() - table) / pixels;
+      if (std::ranges::find(INDEX_WIDTHS, width) != INDEX_WIDTHS.end()) { return width; }
+    }
+    return index_size(header.colors);
+  }
+
+  void expand_indices(std::span<std::uint8_t const> indices, std::size_t width, cppm_palette const & palette,
+                      std::span<std::uint8_t> out) {
+    std::size_t done = 0;
+#if defined(__x86_64__)
+    if (palette.sample == 1 && palette.colors > 0 && has_avx2()) { done = expand_avx2(indices, width, palette, out); }
+#endif
+    expand_scalar(indices.subspan(done * width), width, palette, out.subspan(done * CHANNELS * palette.sample));
+  }
+
+  void decompress_cppm(ImageInput const & input, ImageOutput & output) {
+    image_header const & header = input.header();
+    std::size_t const sample    = header.sample_size();
+    std::size_t const width     = stored_index_size(input);
+    std::size_t const table     = header.colors * CHANNELS * sample;
+    auto const data             = input.payload(table + (header.pixel_count() * width));
+    std::vector<std::uint8_t> const entries = pack_palette(data.first(table), header.colors, sample);
+    cppm_palette const palette{.entries = entries, .colors = header.colors, .sample = sample};
+
+    write_ppm_header(output, {.magic = "P6", .width = header.width, .height = header.height,
+                              .max_color = header.max_color});
+    for (std::size_t first = 0; first < header.pixel_count(); first += PACK_CHUNK) {
+      std::size_t const count = std::min(PACK_CHUNK, header.pixel_count() - first);
+      expand_indices(data.subspan(table + (first * width), count * width), width, palette,
+                     output.acquire(count * CHANNELS * sample));
+    }
+  }
+}  // namespace common
@@ -0,0 +1,34 @@
+#ifndef COMMON_CPPM_HPP
+#define COMMON_CPPM_HPP
+
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace common {
+  // Bytes por índice de un fichero C6 ya abierto. Se deduce del tamaño de la carga útil cuando es
+  // exacto, para aceptar también ficheros que usan 1 byte hasta 256 colores; si no, index_size
+  std::size_t stored_index_size(ImageInput const & input);
+
+  // Paleta de un fichero C6 ya empaquetada para expandirla: 4 bytes por color (r, g, b, relleno)
+  // con muestras de 8 bits u 8 bytes (tres muestras de 16 bits y relleno) con muestras de 16 bits
+  struct cppm_palette {
+    std::span<std::uint8_t const> entries;
+    std::size_t colors = 0;
+    std::size_t sample = 1;  // Bytes por muestra de salida
+  };
+
+  // Expande los índices de ancho width a muestras P6 intercaladas en out. Lanza
+  // std::runtime_error si algún índice no existe en la paleta
+  void expand_indices(std::span<std::uint8_t const> indices, std::size_t width, cppm_palette const & palette,
+                      std::span<std::uint8_t> out);
+
+  // Convierte un fichero C6 abierto en una imagen P6 escrita en output, por bloques y sin
+  // construir ningún vector de píxeles intermedio
+  void decompress_cppm(ImageInput const & input, ImageOutput & output);
+}  // namespace common
+
+#endif  // COMMON_CPPM_HPP
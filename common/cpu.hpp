@@ -0,0 +1,16 @@
+#ifndef COMMON_CPU_HPP
+#define COMMON_CPU_HPP
+
+namespace common {
+  // Consulta CPUID una sola vez para elegir en tiempo de ejecución los núcleos AVX2
+  inline bool has_avx2() {
+#if defined(__x86_64__)
+    static bool const supported = __builtin_cpu_supports("avx2") != 0;
+    return supported;
+#else
+    return false;
+#endif
+  }
+}  // namespace common
+
+#endif  // COMMON_CPU_HPP
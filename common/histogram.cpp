@@ -0,0 +1,129 @@
+#include "common/histogram.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace common {
+  namespace {
+    constexpr std::size_t DENSE_COLORS     = std::size_t{1} << 24U;
+    constexpr std::size_t DENSE_MIN_PIXELS = std::size_t{1} << 20U;  // Por debajo no compensa poner a cero 64 MiB
+    constexpr std::size_t INITIAL_SLOTS    = std::size_t{1} << 12U;
+    constexpr int MAX_NARROW_COLOR         = 255;
+
+    // Clave de desempate cuyo orden ascendente es b, g y r descendentes
+    std::uint64_t tie_order(std::uint64_t key) {
+      return pack_color(CHANNEL_MASK - key_blue(key), CHANNEL_MASK - key_green(key), CHANNEL_MASK - key_red(key));
+    }
+
+    // Frecuencia descendente y, a igual frecuencia, clave ascendente
+    bool more_frequent(color_count const & left, color_count const & right) {
+      if (left.count != right.count) { return left.count > right.count; }
+      return left.key < right.key;
+    }
+
+    // Montículo acotado con los n primeros colores en el orden Order vistos hasta ahora; el último
+    // de ellos en la cima, así que casi todos los colores se descartan con una sola comparación
+    template <bool (*Order)(color_count const &, color_count const &)>
+    class bounded_heap {
+      public:
+        explicit bounded_heap(std::size_t limit) : limit_(limit) { }
+
+        void offer(color_count const & color) {
+          if (colors_.size() < limit_) {
+            colors_.push_back(color);
+            std::ranges::push_heap(colors_, Order);
+          } else if (limit_ > 0 && Order(color, colors_.front())) {
+            std::ranges::pop_heap(colors_, Order);
+            colors_.back() = color;
+            std::ranges::push_heap(colors_, Order);
+          }
+        }
+
+        std::vector<color_count> take() {
+          std::ranges::sort_heap(colors_, Order);
+          return std::move(colors_);
+        }
+
+      private:
+        std::size_t limit_;
+        std::vector<color_count> colors_;
+    };
+  }  // namespace
+
+  bool rarer(color_count const & left, color_count const & right) {
+    if (left.count != right.count) { return left.count < right.count; }
+    return tie_order(left.key) < tie_order(right.key);
+  }
+
+  color_histogram::color_histogram(std::size_t pixels, int max_color)
+    : dense_(max_color <= MAX_NARROW_COLOR && pixels >= DENSE_MIN_PIXELS) {
+    if (dense_) {
+      dense_counts_ = take_buffer<std::uint32_t>(0);  // Conserva la capacidad de una tabla ya usada
+      dense_counts_.assign(DENSE_COLORS, 0);
+    } else {
+      keys_.assign(INITIAL_SLOTS, EMPTY_KEY);
+      counts_.assign(INITIAL_SLOTS, 0);
+    }
+  }
+
+  void color_histogram::grow() {
+    std::vector<std::uint64_t> keys(keys_.size() * 2, EMPTY_KEY);
+    std::vector<std::uint32_t> counts(keys.size(), 0);
+    keys.swap(keys_);
+    counts.swap(counts_);
+    for (std::size_t slot = 0; slot < keys.size(); ++slot) {
+      if (keys[slot] == EMPTY_KEY) { continue; }
+      std::size_t const target = find(keys[slot]);
+      keys_[target]            = keys[slot];
+      counts_[target]          = counts[slot];
+    }
+  }
+
+  void color_histogram::merge(color_histogram const & other) {
+    if (other.dense_) {
+      for (std::size_t index = 0; index < other.dense_counts_.size(); ++index) {
+        if (other.dense_counts_[index] != 0) { add(narrow_key(index), other.dense_counts_[index]); }
+      }
+      return;
+    }
+    for (std::size_t slot = 0; slot < other.keys_.size(); ++slot) {
+      if (other.keys_[slot] != EMPTY_KEY) { add(other.keys_[slot], other.counts_[slot]); }
+    }
+  }
+
+  std::vector<color_count> color_histogram::counts() const {
+    std::vector<color_count> result;
+    if (dense_) {
+      for (std::size_t index = 0; index < dense_counts_.size(); ++index) {
+        if (dense_counts_[index] != 0) { result.push_back({.key = narrow_key(index), .count = dense_counts_[index]}); }
+      }
+      return result;
+    }
+    result.reserve(used_);
+    for (std::size_t slot = 0; slot < keys_.size(); ++slot) {
+      if (keys_[slot] != EMPTY_KEY) { result.push_back({.key = keys_[slot], .count = counts_[slot]}); }
+    }
+    std::ranges::sort(result, {}, &color_count::key);
+    return result;
+  }
+
+  std::vector<color_count> rarest_colors(color_histogram const & histogram, std::size_t n) {
+    bounded_heap<rarer> rarest(n);
+    histogram.for_each([&](color_count const & color) { rarest.offer(color); });
+    return rarest.take();
+  }
+
+  std::vector<color_count> frequent_colors(color_histogram const & histogram, std::size_t n) {
+    bounded_heap<more_frequent> frequent(n);
+    histogram.for_each([&](color_count const & color) { frequent.offer(color); });
+    return frequent.take();
+  }
+
+  std::vector<std::uint64_t> least_frequent(std::span<color_count const> counts, std::size_t n) {
+    bounded_heap<rarer> rarest(n);
+    for (auto const & color : counts) { rarest.offer(color); }
+    std::vector<std::uint64_t> keys;
+    for (auto const & color : rarest.take()) { keys.push_back(color.key); }
+    return keys;
+  }
+}  // namespace common
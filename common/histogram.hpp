@@ -0,0 +1,187 @@
+#ifndef COMMON_HISTOGRAM_HPP
+#define COMMON_HISTOGRAM_HPP
+
+#include "common/palette.hpp"
+#include "common/parallel.hpp"
+#include "common/recycle.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace common {
+  // Mezclador de 64 bits (finalizador de splitmix64) para claves de color: cambiar cualquier bit
+  // de cualquier canal cambia la mitad de los bits del resultado, así que (r, g, b) y sus
+  // permutaciones no colisionan como con un XOR de los tres canales
+  inline std::uint64_t hash_color(std::uint64_t key) {
+    constexpr std::uint64_t FIRST_MULTIPLIER  = 0xBF58476D1CE4E5B9ULL;
+    constexpr std::uint64_t SECOND_MULTIPLIER = 0x94D049BB133111EBULL;
+    constexpr unsigned int FIRST_SHIFT        = 30;
+    constexpr unsigned int SECOND_SHIFT       = 27;
+    constexpr unsigned int THIRD_SHIFT        = 31;
+    key = (key ^ (key >> FIRST_SHIFT)) * FIRST_MULTIPLIER;
+    key = (key ^ (key >> SECOND_SHIFT)) * SECOND_MULTIPLIER;
+    return key ^ (key >> THIRD_SHIFT);
+  }
+
+  constexpr unsigned int NARROW_RED_SHIFT   = 16;
+  constexpr unsigned int NARROW_GREEN_SHIFT = 8;
+  constexpr std::uint64_t NARROW_BYTE       = 0xFF;
+  // Bits de una clave que solo pueden estar a 1 si algún canal no cabe en 8 bits
+  constexpr std::uint64_t WIDE_KEY_BITS =
+      ~((NARROW_BYTE << RED_KEY_SHIFT) | (NARROW_BYTE << GREEN_KEY_SHIFT) | NARROW_BYTE);
+
+  // Posición de un color de 8 bits por canal en una tabla densa de 2^24 entradas, y viceversa
+  inline std::size_t narrow_slot(std::uint64_t key) {
+    return static_cast<std::size_t>((((key >> RED_KEY_SHIFT) & NARROW_BYTE) << NARROW_RED_SHIFT) |
+                                    (((key >> GREEN_KEY_SHIFT) & NARROW_BYTE) << NARROW_GREEN_SHIFT) |
+                                    (key & NARROW_BYTE));
+  }
+
+  inline std::uint64_t narrow_key(std::size_t slot) {
+    return pack_color((slot >> NARROW_RED_SHIFT) & NARROW_BYTE, (slot >> NARROW_GREEN_SHIFT) & NARROW_BYTE,
+                      slot & NARROW_BYTE);
+  }
+
+  struct color_count {
+    std::uint64_t key   = 0;  // Clave de pack_color
+    std::uint32_t count = 0;
+  };
+
+  // Histograma de colores de cutfreq. Con muestras de 8 bits y bastantes píxeles es una tabla densa
+  // de 2^24 contadores indexada por (r, g, b); si no, una tabla hash de direccionamiento abierto
+  // (sondeo lineal, potencia de dos, carga máxima 1/2) sobre hash_color
+  class color_histogram {
+    public:
+      color_histogram(std::size_t pixels, int max_color);
+      color_histogram(color_histogram const &)             = default;
+      color_histogram & operator=(color_histogram const &) = default;
+      color_histogram(color_histogram &&)                  = default;
+      color_histogram & operator=(color_histogram &&)      = default;
+      // La tabla densa se guarda para el siguiente histograma del hilo (ver recycle_scope)
+      ~color_histogram() { recycle_buffer(std::move(dense_counts_)); }
+
+      void add(std::uint64_t key, std::uint32_t count = 1) {
+        if (dense_) {
+          dense_counts_[narrow_slot(key)] += count;
+          return;
+        }
+        std::size_t slot = find(key);
+        if (keys_[slot] == EMPTY_KEY) {
+          if (2 * (used_ + 1) > keys_.size()) {
+            grow();
+            slot = find(key);
+          }
+          keys_[slot] = key;
+          ++used_;
+        }
+        counts_[slot] += count;
+      }
+
+      // Cuenta key_of(i) para i en [0, pixels) con threads hilos. En modo hash cada hilo llena un
+      // histograma parcial con su tramo de píxeles y después se suman; en modo denso se reparten
+      // las posiciones por tramos de la tabla (count_dense), así que no hace falta una tabla de
+      // 64 MiB por hilo. El resultado no depende del número de hilos
+      template <typename Fn>
+      void count(std::size_t pixels, Fn const & key_of, unsigned int threads) {
+        unsigned int const workers = parallel_workers(pixels, threads);
+        if (dense_ && workers == 1) {
+          for (std::size_t i = 0; i < pixels; ++i) { ++dense_counts_[narrow_slot(key_of(i))]; }
+          return;
+        }
+        if (dense_) {
+          count_dense(pixels, key_of, workers);
+          return;
+        }
+        std::vector<color_histogram> partial(workers - 1, color_histogram(0, 0));  // Siempre en modo hash
+        parallel_for(pixels, workers, [&](std::size_t first, std::size_t last, unsigned int worker) {
+          color_histogram & target = worker == 0 ? *this : partial[worker - 1];
+          for (std::size_t i = first; i < last; ++i) { target.add(key_of(i)); }
+        });
+        for (auto const & part : partial) { merge(part); }
+      }
+
+      // Suma los contadores de other (histogramas parciales)
+      void merge(color_histogram const & other);
+      // Colores presentes con su frecuencia, ordenados por clave
+      [[nodiscard]] std::vector<color_count> counts() const;
+      [[nodiscard]] bool dense() const { return dense_; }
+
+      // Llama a visit(color_count) por cada color presente, sin copiar el histograma y sin un orden
+      // garantizado
+      template <typename Fn>
+      void for_each(Fn && visit) const {
+        if (dense_) {
+          for (std::size_t slot = 0; slot < dense_counts_.size(); ++slot) {
+            if (dense_counts_[slot] != 0) { visit(color_count{.key = narrow_key(slot), .count = dense_counts_[slot]}); }
+          }
+          return;
+        }
+        for (std::size_t slot = 0; slot < keys_.size(); ++slot) {
+          if (keys_[slot] != EMPTY_KEY) { visit(color_count{.key = keys_[slot], .count = counts_[slot]}); }
+        }
+      }
+
+    private:
+      static constexpr std::uint64_t EMPTY_KEY   = ~std::uint64_t{0};
+      static constexpr std::size_t DENSE_BLOCK   = std::size_t{1} << 20U;  // Píxeles por reparto de count_dense
+      static constexpr unsigned int DENSE_BITS   = 24;                      // Posiciones de la tabla densa: 2^24
+
+      // Modo denso con varios hilos, por bloques de DENSE_BLOCK píxeles: cada hilo calcula las
+      // posiciones de su tramo del bloque y las deja en un cubo por tramo de la tabla; después cada
+      // hilo suma los cubos de su tramo de la tabla que han llenado todos. Cada píxel se lee una
+      // sola vez, cada contador lo toca un único hilo y los cubos ocupan O(DENSE_BLOCK)
+      template <typename Fn>
+      void count_dense(std::size_t pixels, Fn const & key_of, unsigned int workers) {
+        std::vector<std::vector<std::uint32_t>> buckets(std::size_t{workers} * workers);  // [origen][tramo]
+        for (std::size_t block = 0; block < pixels; block += DENSE_BLOCK) {
+          std::size_t const size = std::min(DENSE_BLOCK, pixels - block);
+          parallel_for(size, workers, [&](std::size_t first, std::size_t last, unsigned int worker) {
+            auto const own = std::span(buckets).subspan(std::size_t{worker} * workers, workers);
+            for (std::size_t i = block + first; i < block + last; ++i) {
+              std::size_t const slot = narrow_slot(key_of(i));
+              own[(slot * workers) >> DENSE_BITS].push_back(static_cast<std::uint32_t>(slot));
+            }
+          });
+          parallel_chunks(workers, 1, workers, [&](std::size_t part, std::size_t) {
+            for (std::size_t source = 0; source < workers; ++source) {
+              auto & bucket = buckets[(source * workers) + part];
+              for (std::uint32_t const slot : bucket) { ++dense_counts_[slot]; }
+              bucket.clear();
+            }
+          });
+        }
+      }
+
+      [[nodiscard]] std::size_t find(std::uint64_t key) const {
+        std::size_t const mask = keys_.size() - 1;
+        std::size_t slot       = static_cast<std::size_t>(hash_color(key)) & mask;
+        while (keys_[slot] != key && keys_[slot] != EMPTY_KEY) { slot = (slot + 1) & mask; }
+        return slot;
+      }
+
+      void grow();
+
+      bool dense_ = false;
+      std::vector<std::uint32_t> dense_counts_;
+      std::vector<std::uint64_t> keys_;
+      std::vector<std::uint32_t> counts_;
+      std::size_t used_ = 0;
+  };
+
+  // Orden de cutfreq: frecuencia ascendente y, a igual frecuencia, b, g y r descendentes
+  bool rarer(color_count const & left, color_count const & right);
+
+  // Los n colores menos frecuentes en el orden de rarer. Selección con un montículo de n
+  // elementos, sin ordenar ni copiar todos los colores
+  std::vector<color_count> rarest_colors(color_histogram const & histogram, std::size_t n);
+  // Los n colores más frecuentes: frecuencia descendente y, a igual frecuencia, clave ascendente
+  std::vector<color_count> frequent_colors(color_histogram const & histogram, std::size_t n);
+  // Las claves de los n colores menos frecuentes de counts, en el orden de rarer
+  std::vector<std::uint64_t> least_frequent(std::span<color_count const> counts, std::size_t n);
+}  // namespace common
+
+#endif  // COMMON_HISTOGRAM_HPP
@@ -0,0 +1,171 @@
+#include "common/imagein.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace common {
+  namespace {
+    constexpr std::size_t HEADER_NUMBERS = 4;  // Como máximo, en la cabecera C6
+    constexpr std::size_t DECIMAL_BASE = 10;
+
+    bool is_space(std::uint8_t character) { return std::isspace(character) != 0; }
+
+    // Salta espacios y comentarios que empiezan por '#' hasta el final de línea
+    void skip_separators(std::span<std::uint8_t const> data, std::size_t & pos) {
+      while (pos < data.size()) {
+        if (data[pos] == '#') {
+          while (pos < data.size() && data[pos] != '\n') { ++pos; }
+        } else if (is_space(data[pos])) {
+          ++pos;
+        } else {
+          return;
+        }
+      }
+    }
+
+    bool parse_number(std::span<std::uint8_t const> data, std::size_t & pos, std::size_t & value) {
+      skip_separators(data, pos);
+      std::size_t const start = pos;
+      value                   = 0;
+      while (pos < data.size() && std::isdigit(data[pos]) != 0) {
+        auto const digit = static_cast<std::size_t>(data[pos] - '0');
+        if (value > (std::numeric_limits<std::size_t>::max() - digit) / DECIMAL_BASE) {
+          return false;
+        }
+        value = (value * DECIMAL_BASE) + digit;
+        ++pos;
+      }
+      return pos > start;
+    }
+
+    // product = producto de factors, o false si no cabe en std::size_t
+    bool checked_product(std::initializer_list<std::size_t> factors, std::size_t & product) {
+      product = 1;
+      for (std::size_t const factor : factors) {
+        if (factor != 0 && product > std::numeric_limits<std::size_t>::max() / factor) { return false; }
+        product *= factor;
+      }
+      return true;
+    }
+
+    // Lee el fichero completo cuando no se puede proyectar en memoria
+    bool read_all(int descriptor, std::vector<std::uint8_t> & buffer) {
+      constexpr std::size_t block = std::size_t{1} << 20U;
+      std::size_t used            = 0;
+      while (true) {
+        buffer.resize(used + block);
+        ssize_t const got = ::read(descriptor, std::span(buffer).subspan(used).data(), block);
+        if (got < 0) { return false; }
+        if (got == 0) { break; }
+        used += static_cast<std::size_t>(got);
+      }
+      buffer.resize(used);
+      return true;
+    }
+  }  // namespace
+
+  bool parse_header(std::span<std::uint8_t const> data, image_header & header) {
+    std::size_t pos = 0;
+    skip_separators(data, pos);
+    std::size_t const start = pos;
+    while (pos < data.size() && !is_space(data[pos])) { ++pos; }
+    //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    header.magic.assign(reinterpret_cast<char const *>(data.subspan(start).data()), pos - start);
+
+    std::size_t values[HEADER_NUMBERS] = {};  // NOLINT(*-avoid-c-arrays)
+    std::size_t const numbers = header.magic == "C6" ? HEADER_NUMBERS : HEADER_NUMBERS - 1;
+    for (std::size_t i = 0; i < numbers; ++i) {
+      if (!parse_number(data, pos, values[i])) { return false; }  // NOLINT(*-constant-array-index)
+    }
+    if (values[2] < 1 || values[2] > static_cast<std::size_t>(MAX_COLOR_16BIT)) { return false; }
+    header.width     = values[0];
+    header.height    = values[1];
+    header.max_color = static_cast<int>(values[2]);
+    header.colors    = values[3];
+    // Así pixel_count() * CHANNELS * sample_size() no desborda en ninguna operación
+    std::size_t bytes = 0;
+    if (!checked_product({header.width, header.height, CHANNELS, header.sample_size()}, bytes) ||
+        !checked_product({header.colors, CHANNELS, header.sample_size()}, bytes)) {
+      return false;
+    }
+    // Un único carácter de espacio separa la cabecera de los datos
+    if (pos < data.size() && is_space(data[pos])) { ++pos; }
+    header.offset = pos;
+    return true;
+  }
+
+  ImageInput::~ImageInput() { close(); }
+
+  void ImageInput::close() {
+    if (mapping_ != nullptr) { ::munmap(mapping_, mapped_size_); }
+    mapping_     = nullptr;
+    mapped_size_ = 0;
+    data_        = {};
+    buffer_.clear();
+    header_ = {};
+  }
+
+  bool ImageInput::open(std::string const & filename) {
+    close();
+    //NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int const descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) { return false; }
+    struct stat info{};
+    bool const regular = ::fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode);
+    if (regular && info.st_size > 0) {
+      mapped_size_ = static_cast<std::size_t>(info.st_size);
+      void * const mapped =
+          ::mmap(nullptr, mapped_size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (mapped != MAP_FAILED) {  // NOLINT(*-pro-type-cstyle-cast, performance-no-int-to-ptr)
+        mapping_ = mapped;
+        ::madvise(mapping_, mapped_size_, MADV_SEQUENTIAL);
+        data_ = std::span(static_cast<std::uint8_t const *>(mapping_), mapped_size_);
+      } else {
+        mapped_size_ = 0;
+      }
+    }
+    if (mapping_ == nullptr) {
+      bool const read_ok = read_all(descriptor, buffer_);
+      if (!read_ok) {
+        ::close(descriptor);
+        return false;
+      }
+      data_ = buffer_;
+    }
+    ::close(descriptor);
+    return parse_header(data_, header_);
+  }
+
+  void ImageInput::advise(std::size_t offset, std::size_t bytes, int advice) const {
+    if (mapping_ == nullptr || bytes == 0) { return; }
+    // madvise exige direcciones alineadas a página: se amplía el rango hacia el inicio
+    auto const page  = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t const begin = ((header_.offset + offset) / page) * page;
+    std::size_t const end   = std::min(header_.offset + offset + bytes, mapped_size_);
+    if (begin >= end) { return; }
+    ::madvise(std::span(static_cast<std::uint8_t *>(mapping_), mapped_size_).subspan(begin).data(),
+              end - begin, advice);
+  }
+
+  void ImageInput::prefetch(std::size_t offset, std::size_t bytes) const {
+    advise(offset, bytes, MADV_WILLNEED);
+  }
+
+  void ImageInput::release(std::size_t offset, std::size_t bytes) const {
+    advise(offset, bytes, MADV_DONTNEED);
+  }
+
+  std::span<std::uint8_t const> ImageInput::payload(std::size_t bytes) const {
+    if (header_.offset > data_.size() || data_.size() - header_.offset < bytes) {
+      throw std::runtime_error("Error reading binary data from stream.");
+    }
+    return data_.subspan(header_.offset, bytes);
+  }
+}  // namespace common
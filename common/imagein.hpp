@@ -0,0 +1,108 @@
+#ifndef COMMON_IMAGEIN_HPP
+#define COMMON_IMAGEIN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace common {
+  constexpr int MAX_COLOR_8BIT   = 255;
+  constexpr int MAX_COLOR_16BIT  = 65535;
+  constexpr std::size_t CHANNELS = 3;
+
+  // Cabecera de un fichero PPM ya analizada
+  struct image_header {
+    std::string magic;
+    std::size_t width  = 0;
+    std::size_t height = 0;
+    int max_color      = 0;
+    std::size_t offset = 0;  // Posición del primer byte de la carga útil
+    std::size_t colors = 0;  // Entradas de la paleta (solo en ficheros C6)
+
+    [[nodiscard]] std::size_t pixel_count() const { return width * height; }
+
+    [[nodiscard]] std::size_t sample_size() const {
+      return max_color <= MAX_COLOR_8BIT ? sizeof(std::uint8_t) : sizeof(std::uint16_t);
+    }
+  };
+
+  // Analiza la cabecera "P6 ancho alto maximo" o "C6 ancho alto maximo colores" (admite
+  // comentarios '#') al inicio de data. Falla si el máximo no está entre 1 y MAX_COLOR_16BIT o si
+  // el tamaño de los píxeles o de la paleta en bytes no cabe en std::size_t
+  bool parse_header(std::span<std::uint8_t const> data, image_header & header);
+
+  // Fichero de imagen proyectado en memoria con mmap; si no es posible se lee en un único bloque.
+  // La cabecera se analiza una sola vez al abrir y la carga útil se expone como una vista.
+  class ImageInput {
+    public:
+      ImageInput() = default;
+      ImageInput(ImageInput const &)             = delete;
+      ImageInput & operator=(ImageInput const &) = delete;
+      ImageInput(ImageInput &&)                  = delete;
+      ImageInput & operator=(ImageInput &&)      = delete;
+      ~ImageInput();
+
+      // Devuelve false si el fichero no se puede abrir o su cabecera no se puede analizar; el
+      // formato (P6 o C6) se comprueba aparte
+      bool open(std::string const & filename);
+
+      [[nodiscard]] image_header const & header() const { return header_; }
+
+      // Vista de los primeros bytes de la carga útil; lanza std::runtime_error si el fichero es corto
+      [[nodiscard]] std::span<std::uint8_t const> payload(std::size_t bytes) const;
+      // Bytes disponibles tras la cabecera
+      [[nodiscard]] std::size_t payload_size() const {
+        return data_.size() > header_.offset ? data_.size() - header_.offset : 0;
+      }
+
+      // Consejos al núcleo sobre un rango de la carga útil proyectada: leerlo por adelantado o
+      // descartar sus páginas una vez procesado. No hacen nada si el fichero se leyó en bloque.
+      void prefetch(std::size_t offset, std::size_t bytes) const;
+      void release(std::size_t offset, std::size_t bytes) const;
+
+    private:
+      void close();
+      void advise(std::size_t offset, std::size_t bytes, int advice) const;
+
+      std::span<std::uint8_t const> data_;
+      std::vector<std::uint8_t> buffer_;
+      void * mapping_          = nullptr;
+      std::size_t mapped_size_ = 0;
+      image_header header_;
+  };
+
+  // Lee una muestra de tipo T (8 o 16 bits, orden nativo) en la posición index de la carga útil
+  template <typename T>
+  T sample_at(std::span<std::uint8_t const> data, std::size_t index) {
+    if constexpr (sizeof(T) == 1) {
+      return data[index];
+    } else {
+      T value{};
+      std::memcpy(&value, data.subspan(index * sizeof(T), sizeof(T)).data(), sizeof(T));
+      return value;
+    }
+  }
+
+  // Llama a func(T{}) con T = uint8_t si max_color cabe en 8 bits o uint16_t si no. Así cada
+  // operación se instancia para los dos anchos de muestra y el tipo se elige al cargar la imagen
+  template <typename Fn>
+  decltype(auto) dispatch_sample(int max_color, Fn && func) {
+    if (max_color <= MAX_COLOR_8BIT) { return func(std::uint8_t{}); }
+    return func(std::uint16_t{});
+  }
+
+  // Recorre count píxeles RGB intercalados llamando a func(i, r, g, b) en un bucle compacto
+  template <typename T, typename Fn>
+  void unpack_rgb(std::span<std::uint8_t const> data, std::size_t count, Fn && func) {
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t const base = i * CHANNELS;
+      func(i, sample_at<T>(data, base), sample_at<T>(data, base + 1),
+           sample_at<T>(data, base + 2));
+    }
+  }
+}  // namespace common
+
+#endif  // COMMON_IMAGEIN_HPP
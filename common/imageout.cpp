@@ -0,0 +1,89 @@
+#include "common/imageout.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace common {
+  namespace {
+    constexpr mode_t FILE_MODE = 0644;
+  }  // namespace
+
+  ImageOutput::~ImageOutput() {
+    try {
+      close();
+    } catch (std::runtime_error const &) {  // NOLINT(bugprone-empty-catch)
+      // Un destructor no puede propagar el error; quien necesite comprobarlo llama a close()
+    }
+  }
+
+  bool ImageOutput::open(std::string const & filename) {
+    close();
+    //NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    descriptor_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FILE_MODE);
+    if (descriptor_ < 0) { return false; }
+    buffer_.resize(OUTPUT_CAPACITY);
+    used_ = 0;
+    return true;
+  }
+
+  void ImageOutput::close() {
+    if (descriptor_ < 0) { return; }
+    int const descriptor = descriptor_;
+    try {
+      flush();
+    } catch (std::runtime_error const &) {
+      ::close(descriptor);
+      descriptor_ = -1;
+      throw;
+    }
+    ::close(descriptor);
+    descriptor_ = -1;
+  }
+
+  void ImageOutput::flush() {
+    if (used_ == 0) { return; }
+    std::size_t const used = used_;
+    used_                  = 0;
+    write_through(std::span<std::uint8_t const>(buffer_).first(used));
+  }
+
+  void ImageOutput::write_through(std::span<std::uint8_t const> bytes) const {
+    while (!bytes.empty()) {
+      ssize_t const written = ::write(descriptor_, bytes.data(), bytes.size());
+      if (written < 0 && errno == EINTR) { continue; }
+      if (written <= 0) { throw std::runtime_error("Error writing binary data to stream."); }
+      bytes = bytes.subspan(static_cast<std::size_t>(written));
+    }
+  }
+
+  std::span<std::uint8_t> ImageOutput::acquire(std::size_t bytes) {
+    if (used_ + bytes > buffer_.size()) {
+      flush();
+      if (bytes > buffer_.size()) { buffer_.resize(bytes); }
+    }
+    auto const reserved = std::span(buffer_).subspan(used_, bytes);
+    used_ += bytes;
+    return reserved;
+  }
+
+  void ImageOutput::write(std::span<std::uint8_t const> bytes) {
+    if (bytes.size() >= buffer_.size()) {
+      flush();
+      write_through(bytes);
+      return;
+    }
+    std::memcpy(acquire(bytes.size()).data(), bytes.data(), bytes.size());
+  }
+
+  void ImageOutput::write(std::string_view text) {
+    //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    write(std::span(reinterpret_cast<std::uint8_t const *>(text.data()), text.size()));
+  }
+
+  void write_ppm_header(ImageOutput & output, image_header const & header) {
+    output.write(header.magic + "\n" + std::to_string(header.width) + " " +
+                 std::to_string(header.height) + "\n" + std::to_string(header.max_color) + "\n");
+  }
+}  // namespace common
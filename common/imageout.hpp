@@ -0,0 +1,143 @@
+#ifndef COMMON_IMAGEOUT_HPP
+#define COMMON_IMAGEOUT_HPP
+
+#include "common/imagein.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace common {
+  constexpr std::size_t PACK_CHUNK      = std::size_t{1} << 14U;  // Píxeles empaquetados por bloque
+  constexpr std::size_t OUTPUT_CAPACITY = std::size_t{1} << 20U;  // Bytes acumulados antes de escribir
+
+  // Fichero de salida con un búfer propio reutilizable: las cabeceras, filas empaquetadas e índices
+  // se acumulan en memoria y se vuelcan al descriptor con escrituras grandes.
+  class ImageOutput {
+    public:
+      ImageOutput() = default;
+      ImageOutput(ImageOutput const &)             = delete;
+      ImageOutput & operator=(ImageOutput const &) = delete;
+      ImageOutput(ImageOutput &&)                  = delete;
+      ImageOutput & operator=(ImageOutput &&)      = delete;
+      ~ImageOutput();
+
+      // Crea o trunca el fichero; devuelve false si no se puede abrir
+      bool open(std::string const & filename);
+      // Vuelca el búfer y cierra; lanza std::runtime_error si la escritura falla
+      void close();
+      void flush();
+
+      void write(std::string_view text);
+      void write(std::span<std::uint8_t const> bytes);
+
+      // Equivalente con búfer de binario::write_birary
+      template <typename T>
+      void write_value(T const & value) {
+        std::memcpy(acquire(sizeof(T)).data(), &value, sizeof(T));
+      }
+
+      // Reserva bytes al final del búfer para que el llamante los rellene directamente
+      std::span<std::uint8_t> acquire(std::size_t bytes);
+
+    private:
+      void write_through(std::span<std::uint8_t const> bytes) const;
+
+      int descriptor_ = -1;
+      std::vector<std::uint8_t> buffer_;
+      std::size_t used_ = 0;
+  };
+
+  // Vista de tres planos de color (SOA) con el mismo número de muestras
+  template <typename T>
+  struct planes_view {
+    std::span<T const> red;
+    std::span<T const> green;
+    std::span<T const> blue;
+  };
+
+  // Satura una muestra al rango [0, limit] antes de estrecharla
+  template <typename Out, typename T>
+  Out saturate(T value, int limit) {
+    if constexpr (std::is_signed_v<T>) {
+      return static_cast<Out>(std::clamp(value, T{0}, static_cast<T>(limit)));
+    } else {
+      return static_cast<Out>(std::min(value, static_cast<T>(limit)));
+    }
+  }
+
+  // Almacena una muestra de 8 o 16 bits (orden nativo, el mismo que usa el lector)
+  template <typename Out>
+  void store_sample(std::span<std::uint8_t> out, std::size_t index, Out value) {
+    if constexpr (sizeof(Out) == 1) {
+      out[index] = value;
+    } else {
+      std::memcpy(out.subspan(index * sizeof(Out), sizeof(Out)).data(), &value, sizeof(Out));
+    }
+  }
+
+  // Intercala y estrecha count muestras de los planos a partir de first; bucle sin dependencias
+  // entre iteraciones para que el compilador lo vectorice
+  template <typename Out, typename T>
+  void pack_planes(planes_view<T> planes, std::size_t first, std::span<std::uint8_t> out) {
+    int const limit         = sizeof(Out) == 1 ? MAX_COLOR_8BIT : MAX_COLOR_16BIT;
+    std::size_t const count = out.size() / (CHANNELS * sizeof(Out));
+    for (std::size_t i = 0; i < count; ++i) {
+      store_sample<Out>(out, (i * CHANNELS), saturate<Out>(planes.red[first + i], limit));
+      store_sample<Out>(out, (i * CHANNELS) + 1, saturate<Out>(planes.green[first + i], limit));
+      store_sample<Out>(out, (i * CHANNELS) + 2, saturate<Out>(planes.blue[first + i], limit));
+    }
+  }
+
+  // Igual que pack_planes para píxeles AOS con miembros r, g y b
+  template <typename Out, typename P>
+  void pack_pixels(std::span<P const> pixels, std::span<std::uint8_t> out) {
+    int const limit = sizeof(Out) == 1 ? MAX_COLOR_8BIT : MAX_COLOR_16BIT;
+    for (std::size_t i = 0; i < pixels.size(); ++i) {
+      store_sample<Out>(out, (i * CHANNELS), saturate<Out>(pixels[i].r, limit));
+      store_sample<Out>(out, (i * CHANNELS) + 1, saturate<Out>(pixels[i].g, limit));
+      store_sample<Out>(out, (i * CHANNELS) + 2, saturate<Out>(pixels[i].b, limit));
+    }
+  }
+
+  // Escribe la carga útil P6 de unos planos SOA por bloques de PACK_CHUNK píxeles
+  template <typename T>
+  void write_planes(ImageOutput & output, planes_view<T> planes, int max_color) {
+    std::size_t const sample = max_color <= MAX_COLOR_8BIT ? 1 : 2;
+    for (std::size_t first = 0; first < planes.red.size(); first += PACK_CHUNK) {
+      std::size_t const count = std::min(PACK_CHUNK, planes.red.size() - first);
+      auto const out          = output.acquire(count * CHANNELS * sample);
+      if (sample == 1) {
+        pack_planes<std::uint8_t>(planes, first, out);
+      } else {
+        pack_planes<std::uint16_t>(planes, first, out);
+      }
+    }
+  }
+
+  // Escribe la carga útil P6 de un vector de píxeles AOS por bloques de PACK_CHUNK píxeles
+  template <typename P>
+  void write_pixels(ImageOutput & output, std::span<P const> pixels, int max_color) {
+    std::size_t const sample = max_color <= MAX_COLOR_8BIT ? 1 : 2;
+    for (std::size_t first = 0; first < pixels.size(); first += PACK_CHUNK) {
+      auto const chunk = pixels.subspan(first, std::min(PACK_CHUNK, pixels.size() - first));
+      auto const out   = output.acquire(chunk.size() * CHANNELS * sample);
+      if (sample == 1) {
+        pack_pixels<std::uint8_t>(chunk, out);
+      } else {
+        pack_pixels<std::uint16_t>(chunk, out);
+      }
+    }
+  }
+
+  // Cabecera P6 con el formato de los escritores existentes: "P6\nancho alto\nmaximo\n"
+  void write_ppm_header(ImageOutput & output, image_header const & header);
+}  // namespace common
+
+#endif  // COMMON_IMAGEOUT_HPP
@@ -1,29 +1,229 @@
 #include "common/info.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace common {
-  void info(const progargsCommon::parameters_files& params) {
-    std::ifstream imagen(params.input_file, std::ios::binary);
-    if (imagen.fail()) {
-      std::cerr << "Error opening file " << params.input_file << '\n';
-      return;
+  namespace {
+    constexpr int MEAN_DIGITS = 3;
+    constexpr std::size_t BATCH_FILES = 4096;  // Ficheros sondeados por cada escritura en std::cout
+    constexpr unsigned char FIRST_PRINTABLE = 0x20;
+    constexpr std::array<std::string_view, CHANNELS> CHANNEL_NAMES = {"red", "green", "blue"};
+
+    std::uint16_t channel_of(std::uint64_t key, std::size_t channel) {
+      if (channel == 0) { return key_red(key); }
+      return channel == 1 ? key_green(key) : key_blue(key);
+    }
+
+    // Extremos y media a partir del histograma del canal, que después se recorta a max_color + 1
+    // entradas (o hasta el mayor valor presente, si alguno se sale del máximo declarado)
+    void summarize(channel_stats & stats, std::size_t pixels, int max_color) {
+      auto const & histogram = stats.histogram;
+      auto const first = std::ranges::find_if(histogram, [](std::uint64_t count) { return count != 0; });
+      if (first == histogram.end()) {
+        stats.histogram.resize(static_cast<std::size_t>(max_color) + 1);
+        return;
+      }
+      auto const last = std::find_if(histogram.rbegin(), histogram.rend(), [](std::uint64_t count) {
+        return count != 0;
+      });
+      stats.min = static_cast<int>(first - histogram.begin());
+      stats.max = static_cast<int>(histogram.rend() - last) - 1;
+      std::uint64_t sum = 0;
+      for (std::size_t value = 0; value < histogram.size(); ++value) { sum += value * histogram[value]; }
+      stats.mean = static_cast<double>(sum) / static_cast<double>(pixels);
+      stats.histogram.resize(static_cast<std::size_t>(std::max(max_color, stats.max)) + 1);
     }
-    std::string identification;
-    int width     = 0;
-    int height    = 0;
-    int max_color = 0;
 
-      imagen >> identification;
-      if (identification != "P6") {
-          std::cerr << "Invalid PPM format\n";
-          return;
+    // Media con MEAN_DIGITS decimales, sin tocar el formato del flujo de salida
+    std::string format_mean(double mean) {
+      std::ostringstream out;
+      out << std::fixed << std::setprecision(MEAN_DIGITS) << mean;
+      return out.str();
+    }
+
+    std::string json_string(std::string_view text) {
+      std::ostringstream out;
+      out << '"';
+      for (char const character : text) {
+        auto const code = static_cast<unsigned char>(character);
+        if (character == '"' || character == '\\') {
+          out << '\\' << character;
+        } else if (code < FIRST_PRINTABLE) {
+          out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(code) << std::dec;
+        } else {
+          out << character;
+        }
+      }
+      out << '"';
+      return out.str();
+    }
+
+    void write_channel_json(std::ostream & out, channel_stats const & stats) {
+      out << "{\"min\": " << stats.min << ", \"max\": " << stats.max << ", \"mean\": " << format_mean(stats.mean)
+          << ", \"histogram\": [";
+      for (std::size_t value = 0; value < stats.histogram.size(); ++value) {
+        out << (value == 0 ? "" : ", ") << stats.histogram[value];
       }
-    imagen >> width >> height >> max_color;
+      out << "]}";
+    }
 
-    std::cout << "Input: "<< params.input_file <<'\n'<<"Output: "<<params.output_file<<'\n'<<"Operation: info"<<"\n";
-    std::cout <<"Image size: "<<width<<"x"<<height<<"\n"<<"Max level: "<<max_color;
+    // Sondeo de todos los ficheros del directorio por lotes, para no acumular la salida entera
+    bool info_directory(std::string const & directory, progargsCommon::options const & opts) {
+      std::vector<std::string> const files = list_files(directory);
+      std::span<std::string const> const pending(files);
+      std::ostringstream batch;
+      for (std::size_t first = 0; first < files.size(); first += BATCH_FILES) {
+        batch.str({});
+        for (auto const & probe : probe_headers(pending.subspan(first, std::min(BATCH_FILES, files.size() - first)),
+                                                opts.threads)) {
+          write_probe(batch, probe, opts.json);
+        }
+        std::cout << batch.view();
+      }
+      return true;
+    }
+
+    bool info_header(progargsCommon::parameters_files const & params, progargsCommon::options const & opts) {
+      header_probe probe;
+      probe.path  = params.input_file;
+      probe.valid = probe_header(params.input_file, probe.header);
+      if (opts.json) {
+        write_probe(std::cout, probe, true);
+      } else if (probe.valid) {
+        write_header(std::cout, params, probe.header);
+      } else {
+        std::cerr << "Invalid PPM format\n";
+      }
+      return probe.valid;
+    }
+  }  // namespace
+
+  image_stats analyze_pixels(std::span<std::uint8_t const> data, image_header const & header, std::size_t top,
+                             unsigned int threads) {
+    std::size_t const pixels = header.pixel_count();
+    color_histogram histogram(pixels, header.max_color);
+    dispatch_sample(header.max_color, [&](auto sample) {
+      using T = decltype(sample);
+      histogram.count(
+          pixels,
+          [data](std::size_t i) {
+            std::size_t const base = i * CHANNELS;
+            return pack_color(sample_at<T>(data, base), sample_at<T>(data, base + 1), sample_at<T>(data, base + 2));
+          },
+          threads);
+    });
+
+    image_stats stats;
+    for (auto & channel : stats.channels) { channel.histogram.assign(CHANNEL_MASK + 1, 0); }
+    histogram.for_each([&stats](color_count const & color) {
+      ++stats.unique_colors;
+      for (std::size_t channel = 0; channel < CHANNELS; ++channel) {
+        stats.channels[channel].histogram[channel_of(color.key, channel)] += color.count;
+      }
+    });
+    for (auto & channel : stats.channels) { summarize(channel, pixels, header.max_color); }
+    stats.top = frequent_colors(histogram, top);
+    return stats;
+  }
+
+  void write_header(std::ostream & out, progargsCommon::parameters_files const & params, image_header const & header) {
+    out << "Input: " << params.input_file << '\n' << "Output: " << params.output_file << '\n' << "Operation: info\n";
+    out << "Image size: " << header.width << "x" << header.height << "\n" << "Max level: " << header.max_color << '\n';
+  }
+
+  void write_probe(std::ostream & out, header_probe const & probe, bool json) {
+    bool const palette = probe.header.magic == "C6";
+    if (json) {
+      out << "{\"input\": " << json_string(probe.path) << ", \"valid\": " << (probe.valid ? "true" : "false");
+      if (probe.valid) {
+        out << ", \"magic\": \"" << probe.header.magic << "\", \"width\": " << probe.header.width
+            << ", \"height\": " << probe.header.height << ", \"max_color\": " << probe.header.max_color;
+        if (palette) { out << ", \"colors\": " << probe.header.colors; }
+      }
+      out << "}\n";
+      return;
+    }
+    if (!probe.valid) {
+      out << probe.path << ": invalid header\n";
+      return;
+    }
+    out << probe.path << ": " << probe.header.magic << ' ' << probe.header.width << 'x' << probe.header.height
+        << " max " << probe.header.max_color;
+    if (palette) { out << " colors " << probe.header.colors; }
+    out << '\n';
+  }
+
+  void write_info(std::ostream & out, progargsCommon::parameters_files const & params, image_header const & header,
+                  image_stats const & stats) {
+    write_header(out, params, header);
+    out << "Unique colors: " << stats.unique_colors << '\n';
+    for (std::size_t channel = 0; channel < CHANNELS; ++channel) {
+      channel_stats const & values = stats.channels[channel];
+      out << "Channel " << CHANNEL_NAMES[channel] << ": min " << values.min << ", max " << values.max << ", mean "
+          << format_mean(values.mean) << '\n';
+    }
+    out << "Most frequent colors:\n";
+    for (auto const & color : stats.top) {
+      out << "  (" << key_red(color.key) << ", " << key_green(color.key) << ", " << key_blue(color.key)
+          << "): " << color.count << '\n';
+    }
+  }
+
+  void write_info_json(std::ostream & out, progargsCommon::parameters_files const & params,
+                       image_header const & header, image_stats const & stats) {
+    out << "{\"input\": " << json_string(params.input_file) << ", \"width\": " << header.width
+        << ", \"height\": " << header.height << ", \"max_color\": " << header.max_color
+        << ", \"pixels\": " << header.pixel_count() << ", \"unique_colors\": " << stats.unique_colors
+        << ", \"channels\": {";
+    for (std::size_t channel = 0; channel < CHANNELS; ++channel) {
+      out << (channel == 0 ? "" : ", ") << '"' << CHANNEL_NAMES[channel] << "\": ";
+      write_channel_json(out, stats.channels[channel]);
+    }
+    out << "}, \"top_colors\": [";
+    for (std::size_t i = 0; i < stats.top.size(); ++i) {
+      std::uint64_t const key = stats.top[i].key;
+      out << (i == 0 ? "" : ", ") << "{\"red\": " << key_red(key) << ", \"green\": " << key_green(key)
+          << ", \"blue\": " << key_blue(key) << ", \"count\": " << stats.top[i].count << "}";
+    }
+    out << "]}\n";
+  }
+
+  bool info(progargsCommon::parameters_files const & params, progargsCommon::options const & opts) {
+    std::error_code error;
+    if (std::filesystem::is_directory(params.input_file, error)) {
+      return info_directory(params.input_file, opts);
+    }
+    if (opts.header_only) { return info_header(params, opts); }
+    ImageInput input;
+    bool const opened = input.open(params.input_file);
+    if (!opened && !std::filesystem::is_regular_file(params.input_file, error)) {
+      std::cerr << "Error opening file " << params.input_file << '\n';
+      return false;
+    }
+    image_header const & header = input.header();
+    if (!opened || header.magic != "P6") {
+      std::cerr << "Invalid PPM format\n";
+      return false;
+    }
+    try {
+      auto const data = input.payload(header.pixel_count() * CHANNELS * header.sample_size());
+      image_stats const stats = analyze_pixels(data, header, opts.top, opts.threads);
+      if (opts.json) {
+        write_info_json(std::cout, params, header, stats);
+      } else {
+        write_info(std::cout, params, header, stats);
+      }
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
+    }
+    return true;
   }
-}
\ No newline at end of file
+}  // namespace common
@@ -1,12 +1,53 @@
-
 #ifndef COMMON_INFO_HPP
 #define COMMON_INFO_HPP
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/probe.hpp"
 #include "common/progargs.hpp"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
 
 namespace common {
+  // Estadísticas de un canal: extremos, media y píxeles por cada valor de 0 a max_color
+  struct channel_stats {
+    int min     = 0;
+    int max     = 0;
+    double mean = 0.0;
+    std::vector<std::uint64_t> histogram;
+  };
+
+  struct image_stats {
+    std::size_t unique_colors = 0;
+    std::array<channel_stats, CHANNELS> channels;
+    std::vector<color_count> top;  // Colores más frecuentes (ver frequent_colors)
+  };
+
+  // Estadísticas de la carga útil P6 data en una sola pasada: los píxeles solo se leen para
+  // llenar el histograma de colores (repartido entre threads hilos) y todo lo demás sale de él
+  image_stats analyze_pixels(std::span<std::uint8_t const> data, image_header const & header, std::size_t top,
+                             unsigned int threads = 1);
+
+  // Primeras líneas del informe de info: ficheros, operación, tamaño y máximo
+  void write_header(std::ostream & out, progargsCommon::parameters_files const & params, image_header const & header);
+  // Una línea por fichero sondeado: "ruta: P6 ANCHOxALTO max M" (con "colors N" en C6) o, con
+  // json, un objeto JSON por línea
+  void write_probe(std::ostream & out, header_probe const & probe, bool json);
+
+  // Informe de info en texto o en JSON (un único objeto)
+  void write_info(std::ostream & out, progargsCommon::parameters_files const & params, image_header const & header,
+                  image_stats const & stats);
+  void write_info_json(std::ostream & out, progargsCommon::parameters_files const & params,
+                       image_header const & header, image_stats const & stats);
 
-  void info(const progargsCommon::parameters_files& params);
+  // Operación info: analiza la imagen y escribe el informe en std::cout; false si no se puede.
+  // Con --header solo se lee la cabecera; si la entrada es un directorio se sondean las cabeceras
+  // de todos sus ficheros, repartidos entre --threads hilos
+  bool info(progargsCommon::parameters_files const & params, progargsCommon::options const & opts = {});
 }
 
-#endif //COMMON_INFO_HPP
\ No newline at end of file
+#endif //COMMON_INFO_HPP
@@ -0,0 +1,172 @@
+#include "common/levels.hpp"
+
+#include "common/cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#endif
+
+namespace common {
+  namespace {
+    constexpr unsigned int MAX_LEVEL    = 65535;
+    constexpr std::size_t TABLE_PADDING = 1;
+    constexpr double HALF               = 0.5;
+
+    // Comprueba un máximo antes de usarlo: el de entrada dimensiona la tabla
+    unsigned int checked_level(unsigned int level) {
+      if (level > MAX_LEVEL) { throw std::runtime_error("Invalid maximum color value"); }
+      return level;
+    }
+
+#if defined(__x86_64__)
+    constexpr std::size_t LANES = 8;  // Muestras de 32 bits por registro AVX2
+
+    // Consulta la tabla de 8 en 8 con gathers de 32 bits (se queda con los 16 bits bajos) y
+    // devuelve cuántas muestras procesó antes del primer bloque con valores fuera de la tabla
+    __attribute__((target("avx2"))) std::size_t apply_avx2(std::span<std::uint16_t const> table,
+                                                            std::span<unsigned int> samples) {
+      __m256i const bound = _mm256_set1_epi32(static_cast<int>(table.size() - 1 - TABLE_PADDING));
+      __m256i const low   = _mm256_set1_epi32(MAX_LEVEL);
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto const * base = reinterpret_cast<int const *>(table.data());
+      std::size_t done  = 0;
+      for (; done + LANES <= samples.size(); done += LANES) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto * lane         = reinterpret_cast<__m256i *>(samples.subspan(done, LANES).data());
+        __m256i const value = _mm256_loadu_si256(lane);
+        __m256i const inside = _mm256_cmpeq_epi32(_mm256_min_epu32(value, bound), value);
+        if (_mm256_movemask_epi8(inside) != -1) { break; }
+        __m256i const mapped = _mm256_i32gather_epi32(base, value, sizeof(std::uint16_t));
+        _mm256_storeu_si256(lane, _mm256_and_si256(mapped, low));
+      }
+      return done;
+    }
+
+    // Ocho muestras de 8 o 16 bits ampliadas a 32 bits
+    template <typename In>
+    __attribute__((target("avx2"))) __m256i load_lanes(In const * input) {
+      if constexpr (sizeof(In) == 1) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(input)));
+      } else {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(input)));
+      }
+    }
+
+    // Guarda ocho valores de 32 bits (ya dentro del rango de Out) como muestras de Out
+    template <typename Out>
+    __attribute__((target("avx2"))) void store_lanes(__m256i values, Out * output) {
+      constexpr int LOW_HALVES = 0b1000;  // Qwords 0 y 2: la mitad empaquetada de cada carril de 128 bits
+      __m128i const words = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(values, values),
+                                                                             LOW_HALVES));
+      if constexpr (sizeof(Out) == 1) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(output), _mm_packus_epi16(words, words));
+      } else {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output), words);
+      }
+    }
+
+    // Como apply_avx2, pero de input a output con muestras de 8 o 16 bits y saturando al rango de
+    // Out igual que level_table::convert
+    template <typename In, typename Out>
+    __attribute__((target("avx2"))) std::size_t convert_avx2(std::span<std::uint16_t const> table,
+                                                              std::span<In const> input, std::span<Out> output) {
+      __m256i const bound = _mm256_set1_epi32(static_cast<int>(table.size() - 1 - TABLE_PADDING));
+      __m256i const low   = _mm256_set1_epi32(MAX_LEVEL);
+      __m256i const limit = _mm256_set1_epi32(std::numeric_limits<Out>::max());
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto const * base = reinterpret_cast<int const *>(table.data());
+      std::size_t done  = 0;
+      for (; done + LANES <= input.size(); done += LANES) {
+        __m256i const value  = load_lanes(input.subspan(done, LANES).data());
+        __m256i const inside = _mm256_cmpeq_epi32(_mm256_min_epu32(value, bound), value);
+        if (_mm256_movemask_epi8(inside) != -1) { break; }
+        __m256i const mapped = _mm256_and_si256(_mm256_i32gather_epi32(base, value, sizeof(std::uint16_t)), low);
+        store_lanes(_mm256_min_epu32(mapped, limit), output.subspan(done, LANES).data());
+      }
+      return done;
+    }
+#endif
+
+    // Camino de level_table::apply entre muestras de 8 o 16 bits; table incluye el relleno
+    template <typename In, typename Out>
+    void convert_samples(level_table const & levels, [[maybe_unused]] std::span<std::uint16_t const> table,
+                         std::span<In const> input, std::span<Out> output) {
+      std::size_t done = 0;
+#if defined(__x86_64__)
+      while (has_avx2() && done < input.size()) {
+        done += convert_avx2(table, input.subspan(done), output.subspan(done));
+        // Bloque con algún valor fuera de la tabla (o cola final): camino escalar
+        for (std::size_t const end = std::min(done + LANES, input.size()); done < end; ++done) {
+          output[done] = levels.convert<Out>(input[done]);
+        }
+      }
+#endif
+      for (; done < input.size(); ++done) { output[done] = levels.convert<Out>(input[done]); }
+    }
+  }  // namespace
+
+  level_table::level_table(unsigned int old_max, unsigned int new_max, rounding mode)
+    : old_max_(checked_level(old_max)), new_max_(checked_level(new_max)),
+      // Con máximo de entrada 0 no hay escala definida: todo se lleva a 0
+      factor_(old_max == 0 ? 0.0 : static_cast<double>(new_max) / old_max), mode_(mode),
+      table_(old_max_ + 1 + TABLE_PADDING, 0) {
+    for (std::size_t value = 0; value <= old_max_ && old_max != 0; ++value) {
+      if (mode == rounding::truncate) {
+        // Misma expresión que el cálculo en coma flotante original para ser bit a bit exacta
+        table_[value] = static_cast<std::uint16_t>(static_cast<unsigned int>(static_cast<double>(value) * factor_));
+      } else {
+        table_[value] = static_cast<std::uint16_t>(((value * new_max) + (old_max / 2)) / old_max);
+      }
+    }
+  }
+
+  double level_table::scale(double value) const {
+    double const scaled = value * factor_;
+    return mode_ == rounding::truncate ? scaled : std::floor(scaled + HALF);
+  }
+
+  void level_table::apply_scalar(std::span<unsigned int> samples) const {
+    for (auto & sample : samples) { sample = (*this)(sample); }
+  }
+
+  void level_table::apply(std::span<unsigned int> samples) const {
+#if defined(__x86_64__)
+    if (has_avx2()) {
+      while (!samples.empty()) {
+        samples = samples.subspan(apply_avx2(table_, samples));
+        // Bloque con algún valor fuera de la tabla (o cola final): camino escalar
+        std::size_t const rest = std::min(LANES, samples.size());
+        apply_scalar(samples.first(rest));
+        samples = samples.subspan(rest);
+      }
+      return;
+    }
+#endif
+    apply_scalar(samples);
+  }
+
+  void level_table::apply_narrow(std::span<std::uint8_t const> input, std::span<std::uint8_t> output) const {
+    convert_samples(*this, table_, input, output);
+  }
+
+  void level_table::apply_narrow(std::span<std::uint8_t const> input, std::span<std::uint16_t> output) const {
+    convert_samples(*this, table_, input, output);
+  }
+
+  void level_table::apply_narrow(std::span<std::uint16_t const> input, std::span<std::uint8_t> output) const {
+    convert_samples(*this, table_, input, output);
+  }
+
+  void level_table::apply_narrow(std::span<std::uint16_t const> input, std::span<std::uint16_t> output) const {
+    convert_samples(*this, table_, input, output);
+  }
+}  // namespace common
@@ -0,0 +1,85 @@
+#ifndef COMMON_LEVELS_HPP
+#define COMMON_LEVELS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace common {
+  // Redondeo de maxlevel: truncate reproduce static_cast<T>(valor * escala) bit a bit,
+  // nearest redondea al entero más próximo con aritmética entera exacta
+  enum class rounding : std::uint8_t { truncate, nearest };
+
+  // Tabla de correspondencia de maxlevel con una entrada por cada valor en [0, old_max].
+  // Se construye una vez por imagen (o por flujo de bandas) y sustituye la multiplicación
+  // en coma flotante por muestra por una consulta; los valores fuera de rango usan la fórmula.
+  class level_table {
+    public:
+      // Lanza std::runtime_error si alguno de los dos máximos pasa de 65535
+      level_table(unsigned int old_max, unsigned int new_max, rounding mode = rounding::truncate);
+
+      template <typename T>
+      [[nodiscard]] T operator()(T value) const {
+        if constexpr (std::is_signed_v<T>) {
+          if (value < 0) { return static_cast<T>(scale(static_cast<double>(value))); }
+        }
+        if (static_cast<std::size_t>(value) <= old_max_) {
+          return static_cast<T>(table_[static_cast<std::size_t>(value)]);
+        }
+        return static_cast<T>(scale(static_cast<double>(value)));
+      }
+
+      // Escala una muestra y la satura al rango de Out, como haría el empaquetado de la salida
+      template <typename Out, typename In>
+      [[nodiscard]] Out convert(In value) const {
+        std::uint64_t const scaled = static_cast<std::size_t>(value) <= old_max_
+                                         ? std::uint64_t{table_[static_cast<std::size_t>(value)]}
+                                         : static_cast<std::uint64_t>(scale(static_cast<double>(value)));
+        return static_cast<Out>(std::min<std::uint64_t>(scaled, std::numeric_limits<Out>::max()));
+      }
+
+      // Aplica la tabla in situ; usa gathers AVX2 cuando la CPU lo admite
+      void apply(std::span<unsigned int> samples) const;
+
+      // Aplica la tabla de input a output, que puede tener otro ancho de muestra. Con muestras de
+      // 8 o 16 bits a ambos lados usa gathers AVX2 cuando la CPU lo admite
+      template <typename In, typename Out>
+      void apply(std::span<In const> input, std::span<Out> output) const {
+        if constexpr (narrow_sample<In> && narrow_sample<Out>) {
+          apply_narrow(input, output);
+        } else {
+          for (std::size_t i = 0; i < input.size(); ++i) { output[i] = convert<Out>(input[i]); }
+        }
+      }
+
+      [[nodiscard]] unsigned int new_max() const { return new_max_; }
+
+      [[nodiscard]] std::span<std::uint16_t const> entries() const {
+        return std::span(table_).first(old_max_ + 1);
+      }
+
+    private:
+      template <typename T>
+      static constexpr bool narrow_sample = std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::uint16_t>;
+
+      [[nodiscard]] double scale(double value) const;
+      void apply_scalar(std::span<unsigned int> samples) const;
+      void apply_narrow(std::span<std::uint8_t const> input, std::span<std::uint8_t> output) const;
+      void apply_narrow(std::span<std::uint8_t const> input, std::span<std::uint16_t> output) const;
+      void apply_narrow(std::span<std::uint16_t const> input, std::span<std::uint8_t> output) const;
+      void apply_narrow(std::span<std::uint16_t const> input, std::span<std::uint16_t> output) const;
+
+      std::size_t old_max_;
+      unsigned int new_max_;
+      double factor_;
+      rounding mode_;
+      // Una entrada extra de relleno para que las cargas de 32 bits de la versión AVX2 no se salgan
+      std::vector<std::uint16_t> table_;
+  };
+}  // namespace common
+
+#endif  // COMMON_LEVELS_HPP
@@ -0,0 +1,124 @@
+#include "common/nearest.hpp"
+
+#include "common/palette.hpp"
+#include "common/parallel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace common {
+  namespace {
+    constexpr std::size_t GRID_CELLS    = color_index::GRID_CELLS;
+    constexpr std::size_t QUERY_CHUNK   = 64;  // Consultas por bloque en nearest por lotes
+    constexpr std::size_t NARROW_COLORS = std::size_t{1} << 24U;
+
+    std::uint64_t axis_distance(std::uint16_t left, std::uint16_t right) {
+      std::uint64_t const diff = left > right ? std::uint64_t{left} - right : std::uint64_t{right} - left;
+      return diff * diff;
+    }
+
+    std::uint64_t distance(std::uint64_t left, std::uint64_t right) {
+      return axis_distance(key_red(left), key_red(right)) + axis_distance(key_green(left), key_green(right)) +
+             axis_distance(key_blue(left), key_blue(right));
+    }
+
+    // Celdas de un eje a distancia como mucho ring de center
+    std::size_t ring_low(std::size_t center, std::size_t ring) { return center > ring ? center - ring : 0; }
+
+    std::size_t ring_high(std::size_t center, std::size_t ring) { return std::min(GRID_CELLS - 1, center + ring); }
+
+    std::size_t gap(std::size_t left, std::size_t right) { return left > right ? left - right : right - left; }
+  }  // namespace
+
+  color_index::color_index(std::span<std::uint64_t const> colors)
+    : color_index([colors](auto const & visit) {
+        for (auto const key : colors) { visit(key); }
+      }) { }
+
+  std::array<std::size_t, 3> color_index::cell_of(std::uint64_t key) const {
+    auto const axis = [this](std::uint16_t sample) {
+      return std::min(GRID_CELLS - 1, static_cast<std::size_t>(sample / cell_width_));
+    };
+    return {axis(key_red(key)), axis(key_green(key)), axis(key_blue(key))};
+  }
+
+  void color_index::scan_cell(std::uint64_t key, std::array<std::size_t, 3> const & cell, candidate & best) const {
+    std::size_t const index = flat_cell(cell);
+    for (std::size_t i = starts_[index]; i < starts_[index + 1]; ++i) {
+      std::uint64_t const color = colors_[i];
+      std::uint64_t const dist  = distance(key, color);
+      if (dist < best.distance || (dist == best.distance && color < best.key)) {
+        best = {.key = color, .distance = dist};
+      }
+    }
+  }
+
+  // Celdas cuya distancia de Chebyshev a center es exactamente ring
+  void color_index::scan_ring(std::uint64_t key, std::array<std::size_t, 3> const & center, std::size_t ring,
+                              candidate & best) const {
+    for (std::size_t red = ring_low(center[0], ring); red <= ring_high(center[0], ring); ++red) {
+      for (std::size_t green = ring_low(center[1], ring); green <= ring_high(center[1], ring); ++green) {
+        bool const edge = gap(red, center[0]) == ring || gap(green, center[1]) == ring;
+        for (std::size_t blue = ring_low(center[2], ring); blue <= ring_high(center[2], ring); ++blue) {
+          if (edge || gap(blue, center[2]) == ring) { scan_cell(key, {red, green, blue}, best); }
+        }
+      }
+    }
+  }
+
+  std::uint64_t color_index::nearest(std::uint64_t key) const {
+    if (colors_.empty()) { return key; }
+    auto const center = cell_of(key);
+    candidate best{.key = key, .distance = std::numeric_limits<std::uint64_t>::max()};
+    for (std::size_t ring = 0; ring < GRID_CELLS; ++ring) {
+      scan_ring(key, center, ring, best);
+      // Cualquier color de un anillo posterior dista al menos ring * ancho + 1 en algún eje; a
+      // igual distancia podría tener clave menor, por eso la comparación es estricta
+      std::uint64_t const reach = (ring * cell_width_) + 1;
+      if (best.distance < reach * reach) { break; }
+    }
+    return best.key;
+  }
+
+  std::vector<std::uint64_t> color_index::nearest(std::span<std::uint64_t const> keys, unsigned int threads) const {
+    std::vector<std::uint64_t> result(keys.size());
+    parallel_chunks(keys.size(), QUERY_CHUNK, threads, [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; ++i) { result[i] = nearest(keys[i]); }
+    });
+    return result;
+  }
+
+  cutfreq_plan plan_cutfreq(color_histogram const & histogram, std::size_t n, unsigned int threads) {
+    auto const rarest = rarest_colors(histogram, n);
+    cutfreq_plan plan;
+    for (auto const & color : rarest) { plan.removed.push_back(color.key); }
+    if (rarest.empty()) { return plan; }
+    // Los eliminados son exactamente los que no van detrás del último en el orden de rarer
+    color_count const boundary = rarest.back();
+    color_index const survivors([&](auto const & visit) {
+      histogram.for_each([&](color_count const & color) {
+        if (rarer(boundary, color)) { visit(color.key); }
+      });
+    });
+    plan.replacement = survivors.nearest(plan.removed, threads);
+    return plan;
+  }
+
+  color_remap::color_remap(cutfreq_plan const & plan)
+    : keys_(std::bit_ceil(2 * plan.removed.size() + 1), EMPTY_KEY), replacement_(keys_.size()) {
+    std::size_t const mask = keys_.size() - 1;
+    for (std::size_t i = 0; i < plan.removed.size(); ++i) {
+      std::size_t slot = static_cast<std::size_t>(hash_color(plan.removed[i])) & mask;
+      while (keys_[slot] != EMPTY_KEY) { slot = (slot + 1) & mask; }
+      keys_[slot]        = plan.removed[i];
+      replacement_[slot] = plan.replacement[i];
+    }
+    if (std::ranges::none_of(plan.removed, [](std::uint64_t key) { return (key & WIDE_KEY_BITS) != 0; })) {
+      removed_.assign(NARROW_COLORS / WORD_BITS, 0);
+      for (auto const key : plan.removed) {
+        removed_[narrow_slot(key) / WORD_BITS] |= std::uint64_t{1} << (narrow_slot(key) % WORD_BITS);
+      }
+    }
+  }
+}  // namespace common
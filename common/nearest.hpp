@@ -0,0 +1,114 @@
+#ifndef COMMON_NEAREST_HPP
+#define COMMON_NEAREST_HPP
+
+#include "common/histogram.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace common {
+  // Índice de vecino más próximo sobre un conjunto de colores (claves de pack_color): rejilla densa
+  // de 32^3 celdas con los colores de cada celda contiguos. La consulta recorre anillos de celdas
+  // cada vez más lejanos y para cuando ningún anillo pendiente puede mejorar el mejor candidato
+  class color_index {
+    public:
+      static constexpr std::size_t GRID_CELLS = 32;  // Celdas por eje
+      static constexpr std::size_t CELL_COUNT = GRID_CELLS * GRID_CELLS * GRID_CELLS;
+
+      explicit color_index(std::span<std::uint64_t const> colors);
+
+      // Índice sobre los colores que visita for_each_color(visit), que llama a visit(clave) por
+      // cada uno. Recorre los colores tres veces en lugar de pedir una copia
+      template <typename ForEach>
+        requires(!std::convertible_to<ForEach, std::span<std::uint64_t const>>)
+      explicit color_index(ForEach const & for_each_color) : starts_(CELL_COUNT + 1, 0) {
+        std::uint64_t top = 0;
+        for_each_color([&](std::uint64_t key) {
+          top = std::max({top, std::uint64_t{key_red(key)}, std::uint64_t{key_green(key)}, std::uint64_t{key_blue(key)}});
+        });
+        // Ancho de celda para que la muestra más alta caiga en la última celda
+        cell_width_ = (top / GRID_CELLS) + 1;
+        for_each_color([&](std::uint64_t key) { ++starts_[cell_index(key) + 1]; });
+        for (std::size_t cell = 1; cell < starts_.size(); ++cell) { starts_[cell] += starts_[cell - 1]; }
+        colors_.resize(starts_.back());
+        std::vector<std::uint32_t> next(starts_.begin(), starts_.end() - 1);
+        for_each_color([&](std::uint64_t key) { colors_[next[cell_index(key)]++] = key; });
+      }
+
+      [[nodiscard]] bool empty() const { return colors_.empty(); }
+      // Color del índice más cercano a key en distancia euclídea; a igual distancia, el de clave
+      // menor. Con el índice vacío devuelve key
+      [[nodiscard]] std::uint64_t nearest(std::uint64_t key) const;
+      // nearest de cada consulta, repartidas por bloques entre threads hilos
+      [[nodiscard]] std::vector<std::uint64_t> nearest(std::span<std::uint64_t const> keys,
+                                                       unsigned int threads) const;
+
+    private:
+      struct candidate {
+        std::uint64_t key;
+        std::uint64_t distance;
+      };
+
+      [[nodiscard]] std::array<std::size_t, 3> cell_of(std::uint64_t key) const;
+      [[nodiscard]] std::size_t cell_index(std::uint64_t key) const { return flat_cell(cell_of(key)); }
+      static std::size_t flat_cell(std::array<std::size_t, 3> const & cell) {
+        return (((cell[0] * GRID_CELLS) + cell[1]) * GRID_CELLS) + cell[2];
+      }
+      void scan_cell(std::uint64_t key, std::array<std::size_t, 3> const & cell, candidate & best) const;
+      void scan_ring(std::uint64_t key, std::array<std::size_t, 3> const & center, std::size_t ring,
+                     candidate & best) const;
+
+      std::uint64_t cell_width_ = 1;
+      std::vector<std::uint32_t> starts_;  // Primer color de cada celda (y uno más al final)
+      std::vector<std::uint64_t> colors_;  // Colores agrupados por celda
+  };
+
+  // Colores que cutfreq elimina y el sustituto de cada uno
+  struct cutfreq_plan {
+    std::vector<std::uint64_t> removed;
+    std::vector<std::uint64_t> replacement;
+  };
+
+  // Elimina los n colores menos frecuentes del histograma y sustituye cada uno por el más próximo
+  // de los que quedan. Si no queda ninguno, cada color se sustituye por sí mismo. Los colores
+  // supervivientes se leen directamente del histograma, sin listas intermedias
+  cutfreq_plan plan_cutfreq(color_histogram const & histogram, std::size_t n, unsigned int threads);
+
+  // Sustituciones de un cutfreq_plan compiladas para la pasada sobre los píxeles: tabla hash de
+  // direccionamiento abierto con hash_color. Si todos los colores eliminados son de 8 bits, un
+  // bit por cada uno de los 2^24 colores filtra antes los píxeles que se quedan, que así no
+  // llegan a la tabla
+  class color_remap {
+    public:
+      explicit color_remap(cutfreq_plan const & plan);
+
+      // Sustituto de key, o key si no se elimina
+      [[nodiscard]] std::uint64_t operator()(std::uint64_t key) const {
+        if (!removed_.empty()) {
+          if ((key & WIDE_KEY_BITS) != 0) { return key; }
+          std::size_t const slot = narrow_slot(key);
+          if (((removed_[slot / WORD_BITS] >> (slot % WORD_BITS)) & 1U) == 0) { return key; }
+        }
+        std::size_t const mask = keys_.size() - 1;
+        for (std::size_t slot = static_cast<std::size_t>(hash_color(key)) & mask;; slot = (slot + 1) & mask) {
+          if (keys_[slot] == key) { return replacement_[slot]; }
+          if (keys_[slot] == EMPTY_KEY) { return key; }
+        }
+      }
+
+    private:
+      static constexpr std::uint64_t EMPTY_KEY = ~std::uint64_t{0};
+      static constexpr std::size_t WORD_BITS   = 64;
+
+      std::vector<std::uint64_t> removed_;  // Filtro de 2^24 bits (vacío si hay colores de 16 bits)
+      std::vector<std::uint64_t> keys_;
+      std::vector<std::uint64_t> replacement_;
+  };
+}  // namespace common
+
+#endif  // COMMON_NEAREST_HPP
@@ -0,0 +1,159 @@
+#include "common/palette.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <string>
+#include <utility>
+
+namespace common {
+  namespace {
+    constexpr std::size_t DENSE_COLORS  = std::size_t{1} << 24U;
+    constexpr std::size_t WORD_BITS     = 64;
+    constexpr unsigned int WORD_SHIFT   = 6;
+    constexpr std::uint64_t BYTE_MASK   = 0xFF;
+    constexpr unsigned int DENSE_RED    = 16;
+    constexpr unsigned int DENSE_GREEN  = 8;
+    constexpr std::uint64_t NARROW_MASK = (BYTE_MASK << RED_KEY_SHIFT) | (BYTE_MASK << GREEN_KEY_SHIFT) | BYTE_MASK;
+    constexpr std::size_t RADIX         = std::size_t{1} << 16U;
+    constexpr unsigned int RADIX_BITS   = 16;
+    constexpr unsigned int KEY_BITS     = 48;
+    constexpr std::size_t MAX_8BIT_INDEX  = 255;
+    constexpr std::size_t MAX_16BIT_INDEX = 65535;
+
+    // Posición del color en el conjunto denso: r, g y b de 8 bits seguidos
+    std::size_t dense_index(std::uint64_t key) {
+      return (std::size_t{key_red(key)} << DENSE_RED) | (std::size_t{key_green(key)} << DENSE_GREEN) |
+             std::size_t{key_blue(key)};
+    }
+
+    std::uint64_t dense_key(std::size_t index) {
+      return pack_color((index >> DENSE_RED) & BYTE_MASK, (index >> DENSE_GREEN) & BYTE_MASK, index & BYTE_MASK);
+    }
+
+    // Una pasada estable del radix LSD sobre el dígito de 16 bits en shift; se omite si todas las
+    // claves comparten ese dígito
+    void radix_pass(std::vector<std::uint64_t> & keys, std::vector<std::uint32_t> & order, unsigned int shift,
+                    std::vector<std::size_t> & counts) {
+      std::ranges::fill(counts, 0);
+      for (auto const key : keys) { ++counts[(key >> shift) & CHANNEL_MASK]; }
+      if (std::ranges::find(counts, keys.size()) != counts.end()) { return; }
+      std::size_t sum = 0;
+      for (auto & count : counts) { sum += std::exchange(count, sum); }
+      std::vector<std::uint64_t> sorted_keys(keys.size());
+      std::vector<std::uint32_t> sorted_order(order.size());
+      for (std::size_t i = 0; i < keys.size(); ++i) {
+        std::size_t const slot = counts[(keys[i] >> shift) & CHANNEL_MASK]++;
+        sorted_keys[slot]      = keys[i];
+        sorted_order[slot]     = order[i];
+      }
+      keys.swap(sorted_keys);
+      order.swap(sorted_order);
+    }
+
+    template <typename Out>
+    void pack_indices(std::span<std::uint32_t const> indices, std::span<std::uint8_t> out) {
+      for (std::size_t i = 0; i < indices.size(); ++i) { store_sample<Out>(out, i, static_cast<Out>(indices[i])); }
+    }
+  }  // namespace
+
+  color_bitset::color_bitset() : words_(DENSE_COLORS / WORD_BITS, 0) { }
+
+  bool color_bitset::mark(std::uint64_t key) {
+    if ((key & ~NARROW_MASK) != 0) { return false; }
+    std::size_t const index = dense_index(key);
+    words_[index >> WORD_SHIFT] |= std::uint64_t{1} << (index % WORD_BITS);
+    return true;
+  }
+
+  bool color_bitset::mark_shared(std::uint64_t key) {
+    if ((key & ~NARROW_MASK) != 0) { return false; }
+    std::size_t const index = dense_index(key);
+    std::uint64_t const bit = std::uint64_t{1} << (index % WORD_BITS);
+    std::atomic_ref<std::uint64_t> const word(words_[index >> WORD_SHIFT]);
+    // Solo se escribe la primera vez que aparece el color; las repeticiones se quedan en una lectura
+    if ((word.load(std::memory_order_relaxed) & bit) == 0) { word.fetch_or(bit, std::memory_order_relaxed); }
+    return true;
+  }
+
+  void color_bitset::finish(std::vector<std::uint64_t> & colors) {
+    ranks_.resize(words_.size());
+    std::uint32_t total = 0;
+    for (std::size_t word = 0; word < words_.size(); ++word) {
+      ranks_[word] = total;
+      total += static_cast<std::uint32_t>(std::popcount(words_[word]));
+    }
+    colors.clear();
+    colors.reserve(total);
+    for (std::size_t word = 0; word < words_.size(); ++word) {
+      for (std::uint64_t bits = words_[word]; bits != 0; bits &= bits - 1) {
+        colors.push_back(dense_key((word << WORD_SHIFT) + static_cast<std::size_t>(std::countr_zero(bits))));
+      }
+    }
+  }
+
+  std::uint32_t color_bitset::rank(std::uint64_t key) const {
+    std::size_t const index  = dense_index(key);
+    std::uint64_t const word = words_[index >> WORD_SHIFT];
+    std::uint64_t const below = word & ((std::uint64_t{1} << (index % WORD_BITS)) - 1);
+    return ranks_[index >> WORD_SHIFT] + static_cast<std::uint32_t>(std::popcount(below));
+  }
+
+  void sort_palette(std::vector<std::uint64_t> keys, palette & result) {
+    std::vector<std::uint32_t> order(keys.size());
+    for (std::size_t i = 0; i < order.size(); ++i) { order[i] = static_cast<std::uint32_t>(i); }
+    std::vector<std::size_t> counts(RADIX);
+    for (unsigned int shift = 0; shift < KEY_BITS; shift += RADIX_BITS) { radix_pass(keys, order, shift, counts); }
+
+    result.colors.clear();
+    result.indices.resize(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      if (i == 0 || keys[i] != keys[i - 1]) { result.colors.push_back(keys[i]); }
+      result.indices[order[i]] = static_cast<std::uint32_t>(result.colors.size() - 1);
+    }
+  }
+
+  void merge_colors(std::vector<std::vector<std::uint64_t>> & local, std::vector<std::uint64_t> & colors) {
+    colors.clear();
+    for (auto & keys : local) {
+      auto const middle = static_cast<std::ptrdiff_t>(colors.size());
+      colors.insert(colors.end(), keys.begin(), keys.end());
+      std::inplace_merge(colors.begin(), colors.begin() + middle, colors.end());
+      std::vector<std::uint64_t>().swap(keys);
+    }
+    colors.erase(std::unique(colors.begin(), colors.end()), colors.end());
+  }
+
+  std::size_t index_size(std::size_t colors) {
+    if (colors <= MAX_8BIT_INDEX) { return sizeof(std::uint8_t); }
+    if (colors <= MAX_16BIT_INDEX) { return sizeof(std::uint16_t); }
+    return sizeof(std::uint32_t);
+  }
+
+  void write_cppm_header(ImageOutput & output, image_header const & header, std::size_t colors) {
+    output.write(header.magic + " " + std::to_string(header.width) + " " + std::to_string(header.height) + " " +
+                 std::to_string(header.max_color) + " " + std::to_string(colors) + "\n");
+  }
+
+  void write_indices(ImageOutput & output, std::span<std::uint32_t const> indices, std::size_t colors,
+                     unsigned int threads) {
+    std::size_t const width = index_size(colors);
+    std::size_t const block = OUTPUT_CAPACITY / width;
+    for (std::size_t first = 0; first < indices.size(); first += block) {
+      auto const chunk = indices.subspan(first, std::min(block, indices.size() - first));
+      auto const out   = output.acquire(chunk.size() * width);
+      // Cada hilo rellena su propio tramo, ya dimensionado, del bloque reservado
+      parallel_for(chunk.size(), threads, [&](std::size_t begin, std::size_t end, unsigned int) {
+        auto const part  = chunk.subspan(begin, end - begin);
+        auto const bytes = out.subspan(begin * width, part.size() * width);
+        if (width == sizeof(std::uint8_t)) {
+          pack_indices<std::uint8_t>(part, bytes);
+        } else if (width == sizeof(std::uint16_t)) {
+          pack_indices<std::uint16_t>(part, bytes);
+        } else {
+          pack_indices<std::uint32_t>(part, bytes);
+        }
+      });
+    }
+  }
+}  // namespace common
@@ -0,0 +1,140 @@
+#ifndef COMMON_PALETTE_HPP
+#define COMMON_PALETTE_HPP
+
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+#include "common/parallel.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace common {
+  constexpr unsigned int RED_KEY_SHIFT   = 32;
+  constexpr unsigned int GREEN_KEY_SHIFT = 16;
+  constexpr std::uint64_t CHANNEL_MASK   = 0xFFFF;
+
+  // Clave de 48 bits (16 por canal) cuyo orden numérico es el lexicográfico (r, g, b)
+  inline std::uint64_t pack_color(std::uint64_t red, std::uint64_t green, std::uint64_t blue) {
+    return (red << RED_KEY_SHIFT) | (green << GREEN_KEY_SHIFT) | blue;
+  }
+
+  inline std::uint16_t key_red(std::uint64_t key) {
+    return static_cast<std::uint16_t>((key >> RED_KEY_SHIFT) & CHANNEL_MASK);
+  }
+
+  inline std::uint16_t key_green(std::uint64_t key) {
+    return static_cast<std::uint16_t>((key >> GREEN_KEY_SHIFT) & CHANNEL_MASK);
+  }
+
+  inline std::uint16_t key_blue(std::uint64_t key) { return static_cast<std::uint16_t>(key & CHANNEL_MASK); }
+
+  // Paleta de compress: colores únicos en orden lexicográfico y el índice de cada píxel
+  struct palette {
+    std::vector<std::uint64_t> colors;
+    std::vector<std::uint32_t> indices;
+  };
+
+  // Conjunto denso de colores de 8 bits por canal: un bit por cada uno de los 2^24 colores y el
+  // rango acumulado por palabra, de modo que el índice de paleta sale de un popcount
+  class color_bitset {
+    public:
+      color_bitset();
+
+      // Marca el color; devuelve false si algún canal no cabe en 8 bits
+      bool mark(std::uint64_t key);
+      // Igual que mark, pero varios hilos pueden marcar a la vez el mismo conjunto: OR atómico,
+      // y solo si el color aún no estaba
+      bool mark_shared(std::uint64_t key);
+      // Calcula los rangos y devuelve los colores presentes ya ordenados
+      void finish(std::vector<std::uint64_t> & colors);
+      [[nodiscard]] std::uint32_t rank(std::uint64_t key) const;
+
+    private:
+      std::vector<std::uint64_t> words_;
+      std::vector<std::uint32_t> ranks_;
+  };
+
+  // Ordena (radix LSD de 16 bits) las claves de una imagen de 16 bits y asigna los índices
+  void sort_palette(std::vector<std::uint64_t> keys, palette & result);
+
+  // Une las listas de colores únicos de cada hilo en la paleta global ordenada
+  void merge_colors(std::vector<std::vector<std::uint64_t>> & local, std::vector<std::uint64_t> & colors);
+
+  // Paleta por tabla densa: un único conjunto de 2 MiB que todos los hilos marcan a la vez, sin
+  // copias por hilo que combinar (con un hilo, sin operaciones atómicas). Devuelve false si alguna
+  // muestra no cabe en 8 bits
+  template <typename Fn>
+  bool dense_palette(std::size_t count, Fn const & key_of, unsigned int threads, palette & result) {
+    unsigned int const workers = parallel_workers(count, threads);
+    color_bitset present;
+    std::vector<std::uint8_t> narrow(workers, 1);
+    parallel_for(count, workers, [&](std::size_t first, std::size_t last, unsigned int worker) {
+      for (std::size_t i = first; i < last && narrow[worker] != 0; ++i) {
+        narrow[worker] = (workers == 1 ? present.mark(key_of(i)) : present.mark_shared(key_of(i))) ? 1 : 0;
+      }
+    });
+    if (std::ranges::find(narrow, 0) != narrow.end()) { return false; }
+    present.finish(result.colors);
+    result.indices.resize(count);
+    parallel_for(count, workers, [&](std::size_t first, std::size_t last, unsigned int) {
+      for (std::size_t i = first; i < last; ++i) { result.indices[i] = present.rank(key_of(i)); }
+    });
+    return true;
+  }
+
+  // Paleta por ordenación: con un hilo radix de (clave, píxel); con varios, cada hilo ordena sus
+  // colores únicos, se mezclan y los índices se buscan en paralelo sobre la paleta global
+  template <typename Fn>
+  void sorted_palette(std::size_t count, Fn const & key_of, unsigned int threads, palette & result) {
+    unsigned int const workers = parallel_workers(count, threads);
+    if (workers == 1) {
+      std::vector<std::uint64_t> keys(count);
+      for (std::size_t i = 0; i < count; ++i) { keys[i] = key_of(i); }
+      sort_palette(std::move(keys), result);
+      return;
+    }
+    std::vector<std::vector<std::uint64_t>> local(workers);
+    parallel_for(count, workers, [&](std::size_t first, std::size_t last, unsigned int worker) {
+      auto & keys = local[worker];
+      for (std::size_t i = first; i < last; ++i) { keys.push_back(key_of(i)); }
+      std::ranges::sort(keys);
+      keys.erase(std::ranges::unique(keys).begin(), keys.end());
+    });
+    merge_colors(local, result.colors);
+    result.indices.resize(count);
+    parallel_for(count, workers, [&](std::size_t first, std::size_t last, unsigned int) {
+      for (std::size_t i = first; i < last; ++i) {
+        auto const found  = std::ranges::lower_bound(result.colors, key_of(i));
+        result.indices[i] = static_cast<std::uint32_t>(found - result.colors.begin());
+      }
+    });
+  }
+
+  // Construye la paleta de count píxeles cuya clave devuelve key_of(i), que debe poder llamarse
+  // desde varios hilos: tabla densa si las muestras son de 8 bits, ordenación si no. El resultado
+  // no depende del número de hilos.
+  template <typename Fn>
+  palette build_palette(std::size_t count, int max_color, Fn && key_of, unsigned int threads = 1) {
+    palette result;
+    if (max_color <= MAX_COLOR_8BIT && dense_palette(count, key_of, threads, result)) { return result; }
+    sorted_palette(count, key_of, threads, result);
+    return result;
+  }
+
+  // Bytes por índice en un fichero C6: 1 hasta 255 colores, 2 hasta 65535 y 4 a partir de ahí
+  std::size_t index_size(std::size_t colors);
+
+  // Cabecera C6 en una sola línea: "magico ancho alto maximo colores"
+  void write_cppm_header(ImageOutput & output, image_header const & header, std::size_t colors);
+
+  // Escribe los índices de paleta con el ancho que corresponde al número de colores; cada bloque
+  // del búfer de salida se reparte entre threads hilos
+  void write_indices(ImageOutput & output, std::span<std::uint32_t const> indices, std::size_t colors,
+                     unsigned int threads = 1);
+}  // namespace common
+
+#endif  // COMMON_PALETTE_HPP
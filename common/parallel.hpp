@@ -0,0 +1,59 @@
+#ifndef COMMON_PARALLEL_HPP
+#define COMMON_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace common {
+  constexpr std::size_t MIN_PARALLEL_ITEMS = std::size_t{1} << 15U;  // Por debajo no compensa lanzar hilos
+
+  // Número de tramos que usará parallel_for para count elementos
+  inline unsigned int parallel_workers(std::size_t count, unsigned int threads) {
+    return static_cast<unsigned int>(
+        std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(1, count / MIN_PARALLEL_ITEMS)));
+  }
+
+  // Reparte [0, count) en tramos contiguos, uno por hilo, y llama a body(primero, ultimo, hilo).
+  // El tramo del hilo 0 lo ejecuta el llamante; con threads <= 1 todo es secuencial.
+  template <typename Fn>
+  void parallel_for(std::size_t count, unsigned int threads, Fn && body) {
+    unsigned int const workers = parallel_workers(count, threads);
+    if (workers == 1) {
+      body(std::size_t{0}, count, 0U);
+      return;
+    }
+    std::size_t const step = (count + workers - 1) / workers;
+    std::vector<std::jthread> pool;
+    pool.reserve(workers - 1);
+    for (unsigned int worker = 1; worker < workers; ++worker) {
+      std::size_t const first = std::min(count, std::size_t{worker} * step);
+      pool.emplace_back([&body, first, last = std::min(count, first + step), worker] { body(first, last, worker); });
+    }
+    body(std::size_t{0}, std::min(count, step), 0U);
+  }
+
+  // Reparte [0, count) en bloques de chunk elementos que los hilos van tomando de un contador
+  // compartido según quedan libres, y llama a body(primero, ultimo) por bloque. Sirve cuando el
+  // coste por bloque es desigual; el resultado no puede depender del hilo que ejecute cada bloque
+  template <typename Fn>
+  void parallel_chunks(std::size_t count, std::size_t chunk, unsigned int threads, Fn && body) {
+    std::size_t const chunks = (count + chunk - 1) / chunk;
+    std::atomic<std::size_t> next{0};
+    auto const worker = [&] {
+      for (std::size_t index = next++; index < chunks; index = next++) {
+        body(index * chunk, std::min(count, (index + 1) * chunk));
+      }
+    };
+    auto const workers =
+        static_cast<unsigned int>(std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(1, chunks)));
+    std::vector<std::jthread> pool;
+    pool.reserve(workers - 1);
+    for (unsigned int extra = 1; extra < workers; ++extra) { pool.emplace_back(worker); }
+    worker();
+  }
+}  // namespace common
+
+#endif  // COMMON_PARALLEL_HPP
@@ -0,0 +1,91 @@
+#include "common/probe.hpp"
+
+#include "common/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <system_error>
+#include <unistd.h>
+
+namespace common {
+  namespace {
+    constexpr std::size_t PROBE_CHUNK = 64;  // Ficheros por bloque en probe_headers
+
+    // Un pread desde el inicio del fichero; bytes leídos o -1
+    ssize_t read_prefix(int descriptor, std::span<std::uint8_t> buffer) {
+      ssize_t got = 0;
+      do {
+        got = ::pread(descriptor, buffer.data(), buffer.size(), 0);
+      } while (got < 0 && errno == EINTR);
+      return got;
+    }
+
+    bool known_magic(image_header const & header) { return header.magic == "P6" || header.magic == "C6"; }
+
+    bool known_format(image_header const & header) {
+      return known_magic(header) && header.max_color > 0 && header.max_color <= MAX_COLOR_16BIT;
+    }
+
+    // No hace falta leer más si lo leído es el fichero entero, si no empieza como un PPM o CPPM,
+    // o si la cabecera se analizó sin llegar al final de lo leído
+    bool complete(bool parsed, image_header const & header, std::size_t got, std::size_t size) {
+      if (got < size || !known_magic(header)) { return true; }
+      return parsed && header.offset < got;
+    }
+
+    bool probe_descriptor(int descriptor, image_header & header) {
+      std::array<std::uint8_t, PROBE_BYTES> prefix{};
+      ssize_t got = read_prefix(descriptor, prefix);
+      if (got < 0) { return false; }
+      bool parsed = parse_header(std::span(prefix).first(static_cast<std::size_t>(got)), header);
+      if (complete(parsed, header, static_cast<std::size_t>(got), prefix.size())) {
+        return parsed && known_format(header);
+      }
+      std::vector<std::uint8_t> buffer;
+      for (std::size_t size = 2 * PROBE_BYTES; size <= MAX_PROBE_BYTES; size *= 2) {
+        buffer.resize(size);
+        header = {};
+        got    = read_prefix(descriptor, buffer);
+        if (got < 0) { return false; }
+        parsed = parse_header(std::span(buffer).first(static_cast<std::size_t>(got)), header);
+        if (complete(parsed, header, static_cast<std::size_t>(got), size)) { return parsed && known_format(header); }
+      }
+      return false;
+    }
+  }  // namespace
+
+  bool probe_header(std::string const & filename, image_header & header) {
+    header = {};
+    //NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int const descriptor = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) { return false; }
+    bool const valid = probe_descriptor(descriptor, header);
+    ::close(descriptor);
+    return valid;
+  }
+
+  std::vector<std::string> list_files(std::string const & directory) {
+    std::vector<std::string> files;
+    std::error_code error;
+    for (std::filesystem::directory_iterator entries(directory, error), end; !error && entries != end;
+         entries.increment(error)) {
+      if (entries->is_regular_file(error)) { files.push_back(entries->path().string()); }
+    }
+    std::ranges::sort(files);
+    return files;
+  }
+
+  std::vector<header_probe> probe_headers(std::span<std::string const> files, unsigned int threads) {
+    std::vector<header_probe> result(files.size());
+    parallel_chunks(files.size(), PROBE_CHUNK, threads, [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; ++i) {
+        result[i].path  = files[i];
+        result[i].valid = probe_header(files[i], result[i].header);
+      }
+    });
+    return result;
+  }
+}  // namespace common
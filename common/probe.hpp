@@ -0,0 +1,34 @@
+#ifndef COMMON_PROBE_HPP
+#define COMMON_PROBE_HPP
+
+#include "common/imagein.hpp"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace common {
+  constexpr std::size_t PROBE_BYTES     = 512;                       // Primer pread de la cabecera
+  constexpr std::size_t MAX_PROBE_BYTES = std::size_t{1} << 16U;     // Límite con comentarios largos
+
+  // Lee la cabecera P6 o C6 de filename sin tocar la carga útil: un único pread de los primeros
+  // PROBE_BYTES bytes que se analiza con parse_header. Solo si los comentarios no caben se repite
+  // con el doble de bytes. Devuelve false si no se puede leer o no es una cabecera P6/C6 válida
+  bool probe_header(std::string const & filename, image_header & header);
+
+  struct header_probe {
+    std::string path;
+    image_header header;
+    bool valid = false;
+  };
+
+  // Ficheros regulares de directory (sin recursión), ordenados por nombre; vacío si no es un directorio
+  std::vector<std::string> list_files(std::string const & directory);
+
+  // probe_header de cada fichero, en bloques que threads hilos van tomando; el resultado está en
+  // el mismo orden que files
+  std::vector<header_probe> probe_headers(std::span<std::string const> files, unsigned int threads = 1);
+}  // namespace common
+
+#endif  // COMMON_PROBE_HPP
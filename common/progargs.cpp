@@ -5,28 +5,171 @@
 #include <string>
 #include <ranges>
 #include <algorithm>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace progargsCommon {
+  namespace {
+    // Ancho o alto de "resize W H": entero positivo que cabe en un int
+    bool positive_size(std::string const &value) {
+      try {
+        std::size_t used = 0;
+        int const parsed = std::stoi(value, &used);
+        return used == value.size() && parsed > 0 && !value.starts_with('+');
+      } catch (std::logic_error const &) {
+        return false;
+      }
+    }
+  }  // namespace
+
   bool check_argc(int & argc) {
     return argc >= 4;
   }
+  bool parse_threads(std::string const &value, unsigned int &threads) {
+    constexpr unsigned long max_threads = 1024;
+    try {
+      std::size_t used = 0;
+      unsigned long const parsed = std::stoul(value, &used);
+      if (used != value.size() || parsed == 0 || parsed > max_threads) {
+        throw std::invalid_argument(value);
+      }
+      threads = static_cast<unsigned int>(parsed);
+      return true;
+    } catch (std::logic_error const &) {
+      std::cerr << "Error : Invalid number of threads " << value << "\n";
+      return false;
+    }
+  }
+
+  bool parse_top(std::string const &value, std::size_t &top) {
+    constexpr unsigned long max_top = 1UL << 20U;
+    try {
+      std::size_t used = 0;
+      unsigned long const parsed = std::stoul(value, &used);
+      if (used != value.size() || parsed > max_top || value.starts_with('-')) {
+        throw std::invalid_argument(value);
+      }
+      top = parsed;
+      return true;
+    } catch (std::logic_error const &) {
+      std::cerr << "Error : Invalid number of colors " << value << "\n";
+      return false;
+    }
+  }
+
+  bool parse_filter(std::string const &value, common::resize_filter &filter) {
+    std::vector<std::pair<std::string, common::resize_filter>> const filters = {
+        {"bilinear", common::resize_filter::bilinear},
+        {"box", common::resize_filter::box},
+        {"bicubic", common::resize_filter::bicubic},
+        {"lanczos3", common::resize_filter::lanczos3}};
+    auto const found = std::ranges::find(filters, value, &std::pair<std::string, common::resize_filter>::first);
+    if (found == filters.end()) {
+      std::cerr << "Error : Unknown filter " << value << "\n";
+      return false;
+    }
+    filter = found->second;
+    return true;
+  }
+
+  bool parse_sizes(std::vector<std::string> const &args, std::vector<common::resize_target> &sizes) {
+    constexpr std::size_t first_size = 4;
+    sizes.clear();
+    for (std::size_t i = first_size; i < args.size(); ++i) {
+      std::string const & arg = args[i];
+      std::size_t const split = arg.find('x');
+      if (split == 0 || split == std::string::npos || split + 1 == arg.size() ||
+          arg.find_first_not_of("0123456789x") != std::string::npos || arg.find('x', split + 1) != std::string::npos) {
+        return false;
+      }
+      try {
+        common::resize_target const size{.width  = std::stoul(arg.substr(0, split)),
+                                         .height = std::stoul(arg.substr(split + 1))};
+        if (size.width == 0 || size.height == 0) { return false; }
+        sizes.push_back(size);
+      } catch (std::out_of_range const &) {
+        return false;
+      }
+    }
+    return !sizes.empty();
+  }
+
+  std::string sized_filename(std::string const &output, common::resize_target size) {
+    std::string suffix = "-";
+    suffix += std::to_string(size.width);
+    suffix += 'x';
+    suffix += std::to_string(size.height);
+    // Un punto al inicio del nombre (".oculto") no separa ninguna extensión
+    std::size_t const slash = output.find_last_of('/');
+    std::size_t const name  = slash == std::string::npos ? 0 : slash + 1;
+    std::size_t const dot   = output.find_last_of('.');
+    if (dot == std::string::npos || dot <= name) { return output + suffix; }
+    return output.substr(0, dot) + suffix + output.substr(dot);
+  }
+
+  bool extract_options(std::vector<std::string> &args, options &opts) {
+    std::vector<std::string> positional;
+    positional.reserve(args.size());
+    for (std::size_t i = 0; i < args.size(); ++i) {
+      std::string const & arg = args[i];
+      if (!arg.starts_with("--")) {
+        positional.push_back(arg);
+      } else if (arg == "--stream") {
+        opts.stream = true;
+      } else if (arg == "--round") {
+        opts.rounding = common::rounding::nearest;
+      } else if (arg == "--threads" && i + 1 < args.size()) {
+        if (!parse_threads(args[++i], opts.threads)) { return false; }
+      } else if (arg.starts_with("--threads=")) {
+        if (!parse_threads(arg.substr(arg.find('=') + 1), opts.threads)) { return false; }
+      } else if (arg == "--filter" && i + 1 < args.size()) {
+        if (!parse_filter(args[++i], opts.filter)) { return false; }
+      } else if (arg.starts_with("--filter=")) {
+        if (!parse_filter(arg.substr(arg.find('=') + 1), opts.filter)) { return false; }
+      } else if (arg == "--json") {
+        opts.json = true;
+      } else if (arg == "--header") {
+        opts.header_only = true;
+      } else if (arg == "--batch" && i + 1 < args.size()) {
+        opts.batch = args[++i];
+      } else if (arg.starts_with("--batch=")) {
+        opts.batch = arg.substr(arg.find('=') + 1);
+      } else if (arg == "--top" && i + 1 < args.size()) {
+        if (!parse_top(args[++i], opts.top)) { return false; }
+      } else if (arg.starts_with("--top=")) {
+        if (!parse_top(arg.substr(arg.find('=') + 1), opts.top)) { return false; }
+      } else {
+        std::cerr << "Error : Unknown option " << arg << "\n";
+        return false;
+      }
+    }
+    args = std::move(positional);
+    return true;
+  }
+
   bool args_checker(std::vector<std::string> const &args) {
     bool const contained = pertenencia(args[3]);
     size_t const argc1 =5;
     size_t const argc2 =6;
     if (contained) {
-       if (strcmp(args[3].c_str(), "compress") == 0 ) {
+       if (strcmp(args[3].c_str(), "compress") == 0 || strcmp(args[3].c_str(), "decompress") == 0) {
         if (args.size() != 4) {
           std::cerr << "Error : Wrong number of arguments; Needed 4 parameters\nParameters introcduced: "<<args.size()<<"\n";
           return false;
         }
          return true;
       }if (strcmp(args[3].c_str(), "resize") == 0 ) {
+        std::vector<common::resize_target> sizes;
+        if (parse_sizes(args, sizes)) { return true; }
         if (args.size() != argc2) {
           std::cerr << "Error : Wrong number of arguments; Needed 6 parameters\nParameters introcduced: "<<args.size()<<"\n";
           return false;
         }
+        if (!positive_size(args[4]) || !positive_size(args[5])) {
+          std::cerr << "Error : Invalid size " << args[4] << " " << args[5] << "; width and height must be positive\n";
+          return false;
+        }
         return true;
       }if (strcmp(args[3].c_str(), "maxlevel") == 0 ) {
         if (args.size() != argc1) {
@@ -34,6 +177,12 @@ namespace progargsCommon {
           return false;
         }
         return true;
+      }if (strcmp(args[3].c_str(), "info") == 0) {
+        if (args.size() != 4) {
+          std::cerr << "Error : Wrong number of arguments; Needed 4 parameters\nParameters introcduced: "<<args.size()<<"\n";
+          return false;
+        }
+        return true;
       }if (strcmp(args[3].c_str(), "cutfreq") == 0 ) {
         if (args.size() != argc1) {
           std::cerr << "Error : Wrong number of arguments; Needed 5 parameters\nParameters introcduced:"<<args.size()<<"\n";
@@ -49,7 +198,7 @@ namespace progargsCommon {
   }
 
   bool pertenencia(std::string const & operation) {
-    std::vector<std::string> const operations = {"compress", "resize", "cutfreq", "maxlevel", "info"};
+    std::vector<std::string> const operations = {"compress", "decompress", "resize", "cutfreq", "maxlevel", "info"};
     return std::ranges::any_of(operations, [&operation](const std::string& element) {
         return element == operation;
     });
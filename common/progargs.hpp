@@ -1,5 +1,9 @@
 #ifndef COMMON_PROGARGS_HPP
 #define COMMON_PROGARGS_HPP
+#include "common/levels.hpp"
+#include "common/resample.hpp"
+
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -12,7 +16,32 @@ namespace progargsCommon {
     std::string output_file;
   };
 
+  // Opciones generales "--opcion" que pueden acompañar a cualquier operación
+  struct options {
+    bool stream = false;  // Procesar por bandas de filas sin cargar la imagen completa
+    common::rounding rounding = common::rounding::truncate;  // "--round": maxlevel al entero más próximo
+    unsigned int threads = 1;  // "--threads N": hilos para las operaciones paralelas
+    common::resize_filter filter = common::resize_filter::bilinear;  // "--filter NOMBRE" de resize
+    bool json = false;  // "--json": info escribe sus estadísticas en JSON
+    std::size_t top = 10;  // "--top N": colores más frecuentes que muestra info
+    bool header_only = false;  // "--header": info solo lee la cabecera, sin la carga útil
+    std::string batch = {};  // "--batch FICHERO": manifiesto de trabajos del modo batch
+  };
+
   bool check_argc(int &argc);
+  // Retira de args las opciones "--..." y las guarda en opts; false si alguna no es válida
+  bool extract_options(std::vector<std::string> &args, options &opts);
+  // Convierte el valor de "--threads" (entero entre 1 y 1024); false y mensaje si no es válido
+  bool parse_threads(std::string const &value, unsigned int &threads);
+  // Convierte el valor de "--top" (entero entre 0 y 2^20); false y mensaje si no es válido
+  bool parse_top(std::string const &value, std::size_t &top);
+  // Convierte el valor de "--filter" (bilinear, box, bicubic o lanczos3); false y mensaje si no existe
+  bool parse_filter(std::string const &value, common::resize_filter &filter);
+  // Lista de tamaños "ANCHOxALTO" de resize a partir de args[4]; false si no hay ninguno o alguno
+  // no tiene esa forma (sin mensajes: también se usa para distinguir "resize W H")
+  bool parse_sizes(std::vector<std::string> const &args, std::vector<common::resize_target> &sizes);
+  // Nombre de la salida de un nivel: "salida.ppm" pasa a ser "salida-ANCHOxALTO.ppm"
+  std::string sized_filename(std::string const &output, common::resize_target size);
   bool args_checker(std::vector<std::string> const &args);
   bool pertenencia(std::string const & operation);
 }
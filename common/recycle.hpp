@@ -0,0 +1,103 @@
+#ifndef COMMON_RECYCLE_HPP
+#define COMMON_RECYCLE_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace common {
+  constexpr std::size_t SPARE_BUFFERS = 4;  // Búferes guardados por tipo y por hilo (p. ej. tres planos)
+  // Bytes guardados por hilo entre todos los tipos: cabe la tabla densa del histograma (64 MiB) y
+  // los planos de una imagen mediana; los búferes mayores se liberan
+  constexpr std::size_t SPARE_BYTES = std::size_t{128} << 20U;
+
+  namespace detail {
+    inline bool & recycling() {
+      thread_local bool active = false;
+      return active;
+    }
+
+    // Bytes de capacidad de todos los búferes guardados en el hilo
+    inline std::size_t & spare_bytes() {
+      thread_local std::size_t bytes = 0;
+      return bytes;
+    }
+
+    template <typename T>
+    std::size_t buffer_bytes(std::vector<T> const & buffer) {
+      return buffer.capacity() * sizeof(T);
+    }
+
+    template <typename T>
+    std::vector<std::vector<T>> & spare_buffers() {
+      thread_local std::vector<std::vector<T>> spare;
+      return spare;
+    }
+  }  // namespace detail
+
+  // Mientras exista en un hilo, los búferes de imagen que se devuelven con recycle_buffer se
+  // guardan para la siguiente imagen del mismo hilo en lugar de liberarse (modo batch). Lo guardado
+  // se libera al terminar el hilo
+  class recycle_scope {
+    public:
+      recycle_scope() : previous_(std::exchange(detail::recycling(), true)) { }
+      recycle_scope(recycle_scope const &)             = delete;
+      recycle_scope & operator=(recycle_scope const &) = delete;
+      recycle_scope(recycle_scope &&)                  = delete;
+      recycle_scope & operator=(recycle_scope &&)      = delete;
+      ~recycle_scope() { detail::recycling() = previous_; }
+
+    private:
+      bool previous_;
+  };
+
+  // Vector de size elementos; dentro de un recycle_scope reutiliza, si lo hay, el búfer guardado
+  // de mayor capacidad, y fuera de él es un vector nuevo. Los elementos reutilizados conservan su
+  // valor anterior
+  template <typename T>
+  std::vector<T> take_buffer(std::size_t size) {
+    auto & spare = detail::spare_buffers<T>();
+    std::vector<T> buffer;
+    if (detail::recycling() && !spare.empty()) {
+      buffer = std::move(spare.back());
+      spare.pop_back();
+      detail::spare_bytes() -= detail::buffer_bytes(buffer);
+    }
+    buffer.resize(size);
+    return buffer;
+  }
+
+  // Devuelve un búfer que ya no se usa: dentro de un recycle_scope se guarda (los SPARE_BUFFERS
+  // de mayor capacidad, ordenados de menor a mayor, sin pasar de SPARE_BYTES en el hilo) y fuera de
+  // él se libera. Si no cabe, se descartan primero los búferes guardados más pequeños del tipo
+  template <typename T>
+  void recycle_buffer(std::vector<T> && buffer) {
+    std::size_t const bytes = detail::buffer_bytes(buffer);
+    if (!detail::recycling() || bytes == 0 || bytes > SPARE_BYTES) {
+      std::vector<T>().swap(buffer);
+      return;
+    }
+    auto & spare = detail::spare_buffers<T>();
+    auto position = spare.begin();
+    while (position != spare.end() && position->capacity() < buffer.capacity()) { ++position; }
+    spare.insert(position, std::move(buffer));
+    detail::spare_bytes() += bytes;
+    while (!spare.empty() && (spare.size() > SPARE_BUFFERS || detail::spare_bytes() > SPARE_BYTES)) {
+      detail::spare_bytes() -= detail::buffer_bytes(spare.front());
+      spare.erase(spare.begin());
+    }
+  }
+
+  // Dimensiona buffer a size elementos; si no tiene capacidad, lo cambia por un búfer guardado
+  template <typename T>
+  void size_buffer(std::vector<T> & buffer, std::size_t size) {
+    if (buffer.capacity() >= size) {
+      buffer.resize(size);
+      return;
+    }
+    recycle_buffer(std::move(buffer));
+    buffer = take_buffer<T>(size);
+  }
+}  // namespace common
+
+#endif  // COMMON_RECYCLE_HPP
@@ -0,0 +1,558 @@
+#include "common/resample.hpp"
+
+#include "common/bands.hpp"
+#include "common/cpu.hpp"
+#include "common/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#endif
+
+namespace common {
+  namespace {
+    constexpr std::size_t NO_ROW           = std::numeric_limits<std::size_t>::max();
+    constexpr std::size_t RESIZE_BAND_ROWS = 32;  // Filas de salida por banda que toma cada hilo
+
+    // Acumulador suficiente para muestra * peso * peso: 32 bits con muestras de 8 y 64 con 16
+    template <typename T>
+    using accumulator = std::conditional_t<sizeof(T) == 1, std::uint32_t, std::uint64_t>;
+
+    template <typename T>
+    constexpr accumulator<T> resize_one = accumulator<T>{1} << resize_bits<T>;
+
+#if defined(__x86_64__)
+    constexpr std::size_t LANES = 8;
+    constexpr std::size_t BLOCK = 32;  // Muestras de 8 bits por store de 256 bits
+    constexpr int GATHER_BYTES  = 4;
+
+    // Paso horizontal de un plano de 8 bits, 8 columnas por iteración: un gather de 32 bits en la
+    // muestra baja trae también la siguiente (la alta, o una de peso cero), y madd_epi16 hace
+    // baja * (uno - peso) + alta * peso sobre pares de 16 bits. samples llega hasta el final del
+    // plano, para no leer fuera al recoger las últimas columnas
+    __attribute__((target("avx2"))) std::size_t interpolate_avx2(std::span<std::uint8_t const> samples,
+                                                                  resize_axis const & columns,
+                                                                  std::span<std::uint32_t> line) {
+      __m256i const one      = _mm256_set1_epi32(static_cast<int>(resize_one<std::uint8_t>));
+      __m256i const low_byte = _mm256_set1_epi32(0xFF);           // NOLINT(*-magic-numbers)
+      __m256i const high_byte = _mm256_set1_epi32(0xFF00);        // NOLINT(*-magic-numbers)
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto const * base = reinterpret_cast<int const *>(samples.data());
+      std::size_t done  = 0;
+      for (; done + LANES <= line.size() && columns.low[done + LANES - 1] + GATHER_BYTES <= samples.size();
+           done += LANES) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m256i const low    = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&columns.low[done]));
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m256i const weight = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&columns.weight[done]));
+        __m256i const pair   = _mm256_i32gather_epi32(base, low, 1);
+        __m256i const taps   = _mm256_or_si256(_mm256_and_si256(pair, low_byte),
+                                               _mm256_slli_epi32(_mm256_and_si256(pair, high_byte), LANES));
+        __m256i const mix    = _mm256_or_si256(_mm256_sub_epi32(one, weight), _mm256_slli_epi32(weight, 16));
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&line[done]), _mm256_madd_epi16(taps, mix));
+      }
+      return done;
+    }
+
+    // Mezcla vertical de 8 filas intermedias ya cargadas
+    __attribute__((target("avx2"))) __m256i blend_lanes(std::uint32_t const * low, std::uint32_t const * high,
+                                                         __m256i keep, __m256i weight) {
+      //NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+      __m256i const top    = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(low));
+      __m256i const bottom = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(high));
+      //NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+      __m256i const sum = _mm256_add_epi32(_mm256_mullo_epi32(top, keep), _mm256_mullo_epi32(bottom, weight));
+      return _mm256_srli_epi32(sum, 2 * resize_bits<std::uint8_t>);
+    }
+
+    // Paso vertical de un plano de 8 bits: 32 muestras de salida por iteración, empaquetadas a bytes
+    __attribute__((target("avx2"))) std::size_t blend_avx2(std::span<std::uint32_t const> low,
+                                                            std::span<std::uint32_t const> high, std::uint32_t weight,
+                                                            std::span<std::uint8_t> out) {
+      __m256i const keep  = _mm256_set1_epi32(static_cast<int>(resize_one<std::uint8_t> - weight));
+      __m256i const mix   = _mm256_set1_epi32(static_cast<int>(weight));
+      __m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);  // NOLINT(*-magic-numbers)
+      std::size_t done    = 0;
+      for (; done + BLOCK <= out.size(); done += BLOCK) {
+        __m256i const first  = blend_lanes(&low[done], &high[done], keep, mix);
+        __m256i const second = blend_lanes(&low[done + LANES], &high[done + LANES], keep, mix);
+        __m256i const third  = blend_lanes(&low[done + (2 * LANES)], &high[done + (2 * LANES)], keep, mix);
+        __m256i const fourth = blend_lanes(&low[done + (3 * LANES)], &high[done + (3 * LANES)], keep, mix);
+        __m256i const words  = _mm256_packus_epi16(_mm256_packus_epi32(first, second),
+                                                   _mm256_packus_epi32(third, fourth));
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[done]), _mm256_permutevar8x32_epi32(words, order));
+      }
+      return done;
+    }
+#endif
+
+    // Columnas de la fila que resuelve el núcleo vectorial; solo hay uno para planos de 8 bits
+    template <typename T>
+    std::size_t interpolate_simd([[maybe_unused]] std::span<T const> samples, [[maybe_unused]] std::size_t channels,
+                                 [[maybe_unused]] resize_axis const & columns,
+                                 [[maybe_unused]] std::span<accumulator<T>> line) {
+#if defined(__x86_64__)
+      if constexpr (std::is_same_v<T, std::uint8_t>) {
+        if (channels == 1 && has_avx2()) { return interpolate_avx2(samples, columns, line); }
+      }
+#endif
+      return 0;
+    }
+
+    template <typename T>
+    std::size_t blend_simd([[maybe_unused]] std::span<accumulator<T> const> low,
+                           [[maybe_unused]] std::span<accumulator<T> const> high, [[maybe_unused]] std::uint32_t weight,
+                           [[maybe_unused]] std::span<T> out) {
+#if defined(__x86_64__)
+      if constexpr (std::is_same_v<T, std::uint8_t>) {
+        if (has_avx2()) { return blend_avx2(low, high, weight, out); }
+      }
+#endif
+      return 0;
+    }
+
+    // Las dos filas de origen interpoladas en horizontal que se están usando; al avanzar hacia
+    // abajo se reemplaza la que ya no hace falta. rows(fila) da las muestras de una fila de origen
+    // desde su inicio (puede haber más detrás, que el núcleo vectorial aprovecha para no salirse)
+    template <typename T, typename Rows>
+    class row_cache {
+      public:
+        row_cache(Rows rows, std::size_t channels, resize_axis const & columns)
+          : rows_source_(std::move(rows)), channels_(channels), columns_(&columns),
+            lines_{std::vector<accumulator<T>>(columns.low.size() * channels),
+                   std::vector<accumulator<T>>(columns.low.size() * channels)} { }
+
+        // Fila row interpolada en horizontal, sin descartar la fila keep
+        std::span<accumulator<T> const> fetch(std::size_t row, std::size_t keep) {
+          for (std::size_t slot = 0; slot < rows_.size(); ++slot) {
+            if (rows_[slot] == row) { return lines_[slot]; }
+          }
+          std::size_t const slot = rows_[0] == keep ? 1 : 0;
+          interpolate(rows_source_(row), lines_[slot]);
+          rows_[slot] = row;
+          return lines_[slot];
+        }
+
+      private:
+        void interpolate(std::span<T const> samples, std::vector<accumulator<T>> & line) const {
+          std::size_t const channels = channels_;
+          for (std::size_t x = interpolate_simd<T>(samples, channels, *columns_, line); x < columns_->low.size(); ++x) {
+            std::size_t const low  = columns_->low[x] * channels;
+            std::size_t const high = columns_->high[x] * channels;
+            auto const weight      = accumulator<T>{columns_->weight[x]};
+            for (std::size_t channel = 0; channel < channels; ++channel) {
+              line[(x * channels) + channel] = (accumulator<T>{samples[low + channel]} * (resize_one<T> - weight)) +
+                                               (accumulator<T>{samples[high + channel]} * weight);
+            }
+          }
+        }
+
+        Rows rows_source_;
+        std::size_t channels_;
+        resize_axis const * columns_;  // Compartida por todas las bandas
+        std::array<std::vector<accumulator<T>>, 2> lines_;
+        std::array<std::size_t, 2> rows_{NO_ROW, NO_ROW};
+    };
+
+    // Fila de salida a partir de las dos filas intermedias y el peso vertical de la alta
+    template <typename T>
+    void blend_row(std::span<accumulator<T> const> low, std::span<accumulator<T> const> high, std::uint32_t weight,
+                   std::span<T> out) {
+      constexpr unsigned int SHIFT = 2 * resize_bits<T>;
+      auto const high_weight       = accumulator<T>{weight};
+      for (std::size_t i = blend_simd<T>(low, high, weight, out); i < out.size(); ++i) {
+        out[i] = static_cast<T>(((low[i] * (resize_one<T> - high_weight)) + (high[i] * high_weight)) >> SHIFT);
+      }
+    }
+  }  // namespace
+
+  namespace {
+    // Filas de origen de resize en flujo: cada una se copia de la carga útil proyectada a un búfer
+    // propio. Las páginas se piden por adelantado y se liberan por bloques de BAND_BYTES
+    template <typename T>
+    class stream_rows {
+      public:
+        explicit stream_rows(ImageInput const & input)
+          : input_(&input), row_bytes_(input.header().width * CHANNELS * sizeof(T)),
+            payload_(input.payload(row_bytes_ * input.header().height)),
+            row_(input.header().width * CHANNELS) { }
+
+        std::span<T const> operator()(std::size_t row) {
+          std::size_t const offset = row * row_bytes_;
+          if (offset >= released_ + BAND_BYTES) {
+            input_->release(released_, offset - released_);
+            released_ = offset;
+          }
+          if (offset + row_bytes_ > requested_) {
+            std::size_t const ahead = std::max(BAND_BYTES, row_bytes_);
+            input_->prefetch(offset, ahead);
+            requested_ = offset + ahead;
+          }
+          std::memcpy(row_.data(), payload_.subspan(offset, row_bytes_).data(), row_bytes_);
+          return row_;
+        }
+
+      private:
+        ImageInput const * input_;
+        std::size_t row_bytes_;
+        std::span<std::uint8_t const> payload_;
+        std::vector<T> row_;
+        std::size_t released_  = 0;
+        std::size_t requested_ = 0;
+    };
+
+    template <typename T>
+    void stream_bilinear(ImageInput const & input, ImageOutput & output, resize_target target) {
+      image_header const & header = input.header();
+      resize_axis const columns   = bilinear_axis(header.width, target.width, resize_bits<T>);
+      resize_axis const rows      = bilinear_axis(header.height, target.height, resize_bits<T>);
+      row_cache<T, stream_rows<T>> cache(stream_rows<T>(input), CHANNELS, columns);
+      std::vector<T> line(target.width * CHANNELS);
+      for (std::size_t y = 0; y < target.height; ++y) {
+        blend_row<T>(cache.fetch(rows.low[y], rows.high[y]), cache.fetch(rows.high[y], rows.low[y]), rows.weight[y],
+                     line);
+        std::span<std::uint8_t> const bytes = output.acquire(line.size() * sizeof(T));
+        std::memcpy(bytes.data(), line.data(), bytes.size());
+      }
+    }
+  }  // namespace
+
+  void stream_resize(ImageInput const & input, ImageOutput & output, resize_target target) {
+    image_header header = input.header();
+    header.width        = target.width;
+    header.height       = target.height;
+    write_ppm_header(output, header);
+    if (input.header().pixel_count() == 0) { return; }
+    dispatch_sample(header.max_color, [&]<typename T>(T) { stream_bilinear<T>(input, output, target); });
+  }
+
+  resize_axis bilinear_axis(std::size_t source, std::size_t target, unsigned int bits) {
+    resize_axis axis{.low = std::vector<std::uint32_t>(target), .high = std::vector<std::uint32_t>(target),
+                     .weight = std::vector<std::uint32_t>(target)};
+    // Con un único destino no hay escala definida: se toma la primera muestra
+    double const scale = target > 1 && source > 0
+                             ? (static_cast<double>(source) - 1) / (static_cast<double>(target) - 1)
+                             : 0.0;
+    std::size_t const last = source > 0 ? source - 1 : 0;
+    for (std::size_t i = 0; i < target; ++i) {
+      double const position = static_cast<double>(i) * scale;
+      double const floor    = std::floor(position);
+      axis.low[i]    = static_cast<std::uint32_t>(std::min(static_cast<std::size_t>(floor), last));
+      axis.high[i]   = static_cast<std::uint32_t>(std::min(static_cast<std::size_t>(std::ceil(position)), last));
+      axis.weight[i] = static_cast<std::uint32_t>(std::lround(std::ldexp(position - floor, static_cast<int>(bits))));
+    }
+    return axis;
+  }
+
+  template <typename T>
+  void resize_bilinear(sample_grid<T const> source, sample_grid<T> target, unsigned int threads) {
+    if (source.width == 0 || source.height == 0) { return; }
+    resize_axis const columns = bilinear_axis(source.width, target.width, resize_bits<T>);
+    resize_axis const rows    = bilinear_axis(source.height, target.height, resize_bits<T>);
+    std::size_t const line    = target.width * target.channels;
+
+    // Cada banda tiene su propia caché y solo interpola las filas de origen que usa; las filas de
+    // salida no dependen del reparto, así que el resultado es el mismo con cualquier número de hilos
+    auto const band = [&](std::size_t first, std::size_t last) {
+      auto const source_rows = [&source](std::size_t row) {
+        return source.data.subspan(row * source.width * source.channels);
+      };
+      row_cache<T, decltype(source_rows)> cache(source_rows, source.channels, columns);
+      for (std::size_t y = first; y < last; ++y) {
+        blend_row<T>(cache.fetch(rows.low[y], rows.high[y]), cache.fetch(rows.high[y], rows.low[y]), rows.weight[y],
+                     target.data.subspan(y * line, line));
+      }
+    };
+    parallel_chunks(target.height, RESIZE_BAND_ROWS, parallel_workers(target.height * line, threads), band);
+  }
+
+  namespace {
+    constexpr double BOX_RADIUS     = 0.5;
+    constexpr double CUBIC_A        = -0.5;  // Catmull-Rom
+    constexpr double LANCZOS_LOBES  = 3.0;
+    constexpr std::size_t MAX_BANKS = 64;  // Al llenarse la caché se vacía y se empieza de nuevo
+    constexpr std::size_t FILTER_BAND_ROWS = 64;
+
+    double box_weight(double distance) { return distance >= -BOX_RADIUS && distance < BOX_RADIUS ? 1.0 : 0.0; }
+
+    double cubic_weight(double distance) {
+      double const x = std::abs(distance);
+      if (x < 1.0) { return (((CUBIC_A + 2) * x - (CUBIC_A + 3)) * x * x) + 1; }
+      if (x < 2.0) { return ((((x - 5) * x) + 8) * x - 4) * CUBIC_A; }  // NOLINT(*-magic-numbers)
+      return 0.0;
+    }
+
+    double lanczos_weight(double distance) {
+      if (distance == 0.0) { return 1.0; }
+      if (std::abs(distance) >= LANCZOS_LOBES) { return 0.0; }
+      double const angle = std::numbers::pi * distance;
+      return LANCZOS_LOBES * std::sin(angle) * std::sin(angle / LANCZOS_LOBES) / (angle * angle);
+    }
+
+    struct filter_kernel {
+      double (*weight)(double) = nullptr;
+      double radius            = 0.0;
+    };
+
+    // Filtro ya ensanchado para un eje con source muestras de origen
+    struct filter_axis {
+      filter_kernel kernel;
+      double stretch      = 1.0;
+      std::size_t source  = 0;
+    };
+
+    filter_kernel kernel_of(resize_filter filter) {
+      if (filter == resize_filter::box) { return {.weight = box_weight, .radius = BOX_RADIUS}; }
+      if (filter == resize_filter::bicubic) { return {.weight = cubic_weight, .radius = 2.0}; }
+      return {.weight = lanczos_weight, .radius = LANCZOS_LOBES};
+    }
+
+    // Pesos de una muestra de destino centrada en center (índice de origen, puede ser fraccionario);
+    // devuelve la primera muestra de origen. Las muestras fuera de la imagen se pliegan sobre el borde
+    std::uint32_t bank_entry(filter_axis const & axis, double center, std::span<float> weights) {
+      double const support = axis.kernel.radius * axis.stretch;
+      auto const low  = static_cast<std::ptrdiff_t>(std::ceil(center - support));
+      auto const high = static_cast<std::ptrdiff_t>(std::floor(center + support));
+      auto const last = static_cast<std::ptrdiff_t>(axis.source) - 1;
+      auto const base = std::clamp<std::ptrdiff_t>(low, 0, static_cast<std::ptrdiff_t>(axis.source - weights.size()));
+      std::vector<double> sums(weights.size(), 0.0);
+      double total = 0.0;
+      for (std::ptrdiff_t tap = low; tap <= high; ++tap) {
+        double const weight = axis.kernel.weight((static_cast<double>(tap) - center) / axis.stretch);
+        auto const slot     = static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(tap, 0, last) - base);
+        if (weight == 0.0 || slot >= sums.size()) { continue; }
+        sums[slot] += weight;
+        total += weight;
+      }
+      // Si no queda ningún peso (no debería pasar) se toma la muestra más cercana
+      if (total == 0.0) {
+        sums[static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(std::lround(center), base, last) - base)] = 1.0;
+        total = 1.0;
+      }
+      for (std::size_t tap = 0; tap < weights.size(); ++tap) { weights[tap] = static_cast<float>(sums[tap] / total); }
+      return static_cast<std::uint32_t>(base);
+    }
+
+    filter_bank build_bank(resize_filter filter, std::size_t source, std::size_t target) {
+      double const scale = static_cast<double>(source) / static_cast<double>(target);
+      // Al reducir, el filtro se ensancha con la escala para promediar todo lo que cubre
+      filter_axis const axis{.kernel = kernel_of(filter), .stretch = std::max(1.0, scale), .source = source};
+      filter_bank bank;
+      bank.taps = std::min(source, static_cast<std::size_t>(std::ceil(2 * axis.kernel.radius * axis.stretch)) + 1);
+      bank.first.resize(target);
+      bank.weights.resize(target * bank.taps);
+      for (std::size_t i = 0; i < target; ++i) {
+        double const center = ((static_cast<double>(i) + BOX_RADIUS) * scale) - BOX_RADIUS;
+        bank.first[i] = bank_entry(axis, center, std::span(bank.weights).subspan(i * bank.taps, bank.taps));
+      }
+      bank.by_tap.resize(bank.weights.size());
+      for (std::size_t i = 0; i < target; ++i) {
+        for (std::size_t tap = 0; tap < bank.taps; ++tap) {
+          bank.by_tap[(tap * target) + i] = bank.weights[(i * bank.taps) + tap];
+        }
+      }
+      return bank;
+    }
+
+#if defined(__x86_64__)
+    // sum += row * weight, 8 muestras por iteración
+    __attribute__((target("avx2"))) std::size_t accumulate_avx2(std::span<float const> row, float weight,
+                                                                 std::span<float> sum) {
+      __m256 const scale = _mm256_set1_ps(weight);
+      std::size_t done   = 0;
+      for (; done + LANES <= sum.size(); done += LANES) {
+        __m256 const product = _mm256_mul_ps(_mm256_loadu_ps(&row[done]), scale);
+        _mm256_storeu_ps(&sum[done], _mm256_add_ps(_mm256_loadu_ps(&sum[done]), product));
+      }
+      return done;
+    }
+#endif
+
+    void accumulate(std::span<float const> row, float weight, std::span<float> sum) {
+      std::size_t done = 0;
+#if defined(__x86_64__)
+      if (has_avx2()) { done = accumulate_avx2(row, weight, sum); }
+#endif
+      for (; done < sum.size(); ++done) { sum[done] += row[done] * weight; }
+    }
+
+#if defined(__x86_64__)
+    // Paso horizontal de los filtros, 8 muestras de destino por iteración y canal: por cada tap, un
+    // gather de las muestras de origen y los pesos de ese tap, ya seguidos en by_tap. Suma en el
+    // mismo orden que el bucle escalar, así que el resultado es idéntico
+    __attribute__((target("avx2"))) std::size_t filter_row_avx2(std::span<float const> values, std::size_t channels,
+                                                                 filter_bank const & columns, std::span<float> out) {
+      std::size_t const target = columns.first.size();
+      __m256i const stride     = _mm256_set1_epi32(static_cast<int>(channels));
+      std::array<float, LANES> lanes{};
+      std::size_t done = 0;
+      for (; done + LANES <= target; done += LANES) {
+        //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m256i const first = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&columns.first[done]));
+        for (std::size_t channel = 0; channel < channels; ++channel) {
+          __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(first, stride),
+                                           _mm256_set1_epi32(static_cast<int>(channel)));
+          __m256 sum    = _mm256_setzero_ps();
+          for (std::size_t tap = 0; tap < columns.taps; ++tap) {
+            __m256 const weight = _mm256_loadu_ps(&columns.by_tap[(tap * target) + done]);
+            __m256 const sample = _mm256_i32gather_ps(values.data(), index, sizeof(float));
+            sum   = _mm256_add_ps(sum, _mm256_mul_ps(sample, weight));
+            index = _mm256_add_epi32(index, stride);
+          }
+          if (channels == 1) {
+            _mm256_storeu_ps(&out[done], sum);
+            continue;
+          }
+          _mm256_storeu_ps(lanes.data(), sum);
+          for (std::size_t lane = 0; lane < LANES; ++lane) {
+            out[((done + lane) * channels) + channel] = lanes.at(lane);
+          }
+        }
+      }
+      return done;
+    }
+#endif
+
+    // Convolución separable con los bancos de columnas y filas: cada banda de filas de salida
+    // filtra en horizontal las filas de origen que cubre y luego las combina en vertical
+    template <typename T>
+    class filter_pass {
+      public:
+        filter_pass(sample_grid<T const> source, sample_grid<T> target, filter_bank const & columns,
+                    filter_bank const & rows)
+          : source_(source), target_(target), columns_(&columns), rows_(&rows) { }
+
+        void band(std::size_t first, std::size_t last, float limit) const {
+          std::size_t const line  = target_.width * target_.channels;
+          std::size_t const begin = rows_->first[first];
+          std::size_t const end   = rows_->first[last - 1] + rows_->taps;
+          std::vector<float> lines((end - begin) * line);
+          for (std::size_t row = begin; row < end; ++row) {
+            filter_row(row, std::span(lines).subspan((row - begin) * line, line));
+          }
+          std::vector<float> sum(line);
+          for (std::size_t y = first; y < last; ++y) {
+            std::ranges::fill(sum, 0.0F);
+            for (std::size_t tap = 0; tap < rows_->taps; ++tap) {
+              std::size_t const row = rows_->first[y] + tap - begin;
+              float const weight    = rows_->weights[(y * rows_->taps) + tap];
+              accumulate(std::span<float const>(lines).subspan(row * line, line), weight, sum);
+            }
+            auto const out = target_.data.subspan(y * line, line);
+            for (std::size_t i = 0; i < line; ++i) { out[i] = static_cast<T>(std::clamp(sum[i], 0.0F, limit) + 0.5F); }
+          }
+        }
+
+      private:
+        void filter_row(std::size_t row, std::span<float> out) const {
+          std::size_t const channels = source_.channels;
+          auto const samples         = source_.data.subspan(row * source_.width * channels, source_.width * channels);
+          // La fila se pasa a float una vez; cada salida es un producto escalar sobre ella
+          std::vector<float> values(samples.begin(), samples.end());
+          std::size_t done = 0;
+#if defined(__x86_64__)
+          if (has_avx2() && values.size() <= static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            done = filter_row_avx2(values, channels, *columns_, out);
+          }
+#endif
+          for (std::size_t x = done; x < target_.width; ++x) {
+            auto const weights = std::span(columns_->weights).subspan(x * columns_->taps, columns_->taps);
+            auto const taps    = std::span<float const>(values).subspan(columns_->first[x] * channels);
+            for (std::size_t channel = 0; channel < channels; ++channel) {
+              float value = 0.0F;
+              for (std::size_t tap = 0; tap < weights.size(); ++tap) {
+                value += taps[(tap * channels) + channel] * weights[tap];
+              }
+              out[(x * channels) + channel] = value;
+            }
+          }
+        }
+
+        sample_grid<T const> source_;
+        sample_grid<T> target_;
+        filter_bank const * columns_;
+        filter_bank const * rows_;
+    };
+  }  // namespace
+
+  std::shared_ptr<filter_bank const> cached_bank(resize_filter filter, std::size_t source, std::size_t target) {
+    static std::mutex guard;
+    static std::map<std::tuple<resize_filter, std::size_t, std::size_t>, std::shared_ptr<filter_bank const>> banks;
+    auto const key = std::tuple{filter, source, target};
+    {
+      std::scoped_lock const lock(guard);
+      if (auto const found = banks.find(key); found != banks.end()) { return found->second; }
+    }
+    auto bank = std::make_shared<filter_bank const>(build_bank(filter, source, target));
+    std::scoped_lock const lock(guard);
+    if (banks.size() >= MAX_BANKS) { banks.clear(); }
+    return banks.try_emplace(key, std::move(bank)).first->second;
+  }
+
+  template <typename T>
+  void resample(sample_grid<T const> source, sample_grid<T> target, int max_color, resize_settings settings) {
+    if (settings.filter == resize_filter::bilinear) {
+      resize_bilinear(source, target, settings.threads);
+      return;
+    }
+    if (source.width == 0 || source.height == 0 || target.width == 0 || target.height == 0) { return; }
+    auto const columns = cached_bank(settings.filter, source.width, target.width);
+    auto const rows    = cached_bank(settings.filter, source.height, target.height);
+    filter_pass<T> const pass(source, target, *columns, *rows);
+    auto const limit = static_cast<float>(max_color);
+    unsigned int const workers = parallel_workers(target.height * target.width * target.channels, settings.threads);
+    parallel_chunks(target.height, FILTER_BAND_ROWS, workers,
+                    [&](std::size_t first, std::size_t last) { pass.band(first, last, limit); });
+  }
+
+  pyramid_plan plan_pyramid(resize_target source, std::span<resize_target const> levels) {
+    pyramid_plan plan{.parent = std::vector<std::size_t>(levels.size(), levels.size()), .waves = {}};
+    auto const area = [&](std::size_t level) { return levels[level].width * levels[level].height; };
+    auto const fits = [](resize_target inner, resize_target outer) {
+      return inner.width <= outer.width && inner.height <= outer.height;
+    };
+    std::vector<std::size_t> order(levels.size());
+    for (std::size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+    std::ranges::stable_sort(order, std::greater{}, area);
+
+    std::vector<std::size_t> depth(levels.size(), 0);
+    for (std::size_t done = 0; done < order.size(); ++done) {
+      std::size_t const level = order[done];
+      // Candidatos: niveles ya planificados que reducen el origen y contienen a este
+      for (std::size_t previous = 0; previous < done; ++previous) {
+        std::size_t const candidate = order[previous];
+        if (fits(levels[level], levels[candidate]) && fits(levels[candidate], source) &&
+            (plan.parent[level] == levels.size() || area(candidate) <= area(plan.parent[level]))) {
+          plan.parent[level] = candidate;
+        }
+      }
+      depth[level] = plan.parent[level] == levels.size() ? 0 : depth[plan.parent[level]] + 1;
+      if (plan.waves.size() <= depth[level]) { plan.waves.resize(depth[level] + 1); }
+      plan.waves[depth[level]].push_back(level);
+    }
+    return plan;
+  }
+
+  template void resize_bilinear<std::uint8_t>(sample_grid<std::uint8_t const> source,
+                                               sample_grid<std::uint8_t> target, unsigned int threads);
+  template void resize_bilinear<std::uint16_t>(sample_grid<std::uint16_t const> source,
+                                                sample_grid<std::uint16_t> target, unsigned int threads);
+
+  template void resample<std::uint8_t>(sample_grid<std::uint8_t const> source, sample_grid<std::uint8_t> target,
+                                       int max_color, resize_settings settings);
+  template void resample<std::uint16_t>(sample_grid<std::uint16_t const> source, sample_grid<std::uint16_t> target,
+                                        int max_color, resize_settings settings);
+}  // namespace common
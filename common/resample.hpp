@@ -0,0 +1,108 @@
+#ifndef COMMON_RESAMPLE_HPP
+#define COMMON_RESAMPLE_HPP
+
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+#include "common/parallel.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace common {
+  // Bits fraccionarios de los pesos en coma fija: con 8 bits el producto de dos pesos y una
+  // muestra cabe en 32 bits; con 16 se usan acumuladores de 64 y más precisión
+  template <typename T>
+  constexpr unsigned int resize_bits = sizeof(T) == 1 ? 11 : 16;
+
+  // Tabla de un eje del redimensionado bilineal: para cada posición de destino, las dos muestras de
+  // origen y el peso de la alta con bits fraccionarios (la baja pesa 2^bits - weight). Se calcula
+  // una vez por eje, con la misma correspondencia x * (origen - 1) / (destino - 1) de siempre
+  struct resize_axis {
+    std::vector<std::uint32_t> low;
+    std::vector<std::uint32_t> high;
+    std::vector<std::uint32_t> weight;
+  };
+
+  resize_axis bilinear_axis(std::size_t source, std::size_t target, unsigned int bits);
+
+  // Rejilla de height filas de width píxeles con channels muestras intercaladas por píxel
+  // (3 para AOS, 1 para cada plano SOA)
+  template <typename T>
+  struct sample_grid {
+    std::span<T> data;
+    std::size_t width    = 0;
+    std::size_t height   = 0;
+    std::size_t channels = 1;
+  };
+
+  // Redimensionado bilineal separable en coma fija: cada fila de origen necesaria se interpola en
+  // horizontal una sola vez y las filas de destino se mezclan en vertical a partir de esas dos
+  // filas intermedias. Con threads > 1 las bandas de filas de salida se reparten entre hilos.
+  // Instanciado para muestras de 8 y 16 bits
+  template <typename T>
+  void resize_bilinear(sample_grid<T const> source, sample_grid<T> target, unsigned int threads = 1);
+
+  // Filtro de resize: bilinear es el de siempre; box promedia el área de cada píxel de destino (al
+  // reducir) o repite el más cercano (al ampliar); bicubic es Catmull-Rom y lanczos3 usa 3 lóbulos
+  enum class resize_filter : std::uint8_t { bilinear, box, bicubic, lanczos3 };
+
+  // Banco de pesos de un eje para los filtros con soporte arbitrario: cada muestra de destino usa
+  // taps muestras de origen consecutivas desde first, con pesos normalizados a suma 1
+  struct filter_bank {
+    std::size_t taps = 0;
+    std::vector<std::uint32_t> first;
+    std::vector<float> weights;  // taps pesos por muestra de destino
+    std::vector<float> by_tap;   // Los mismos pesos por tap: el de cada muestra de destino, seguidos
+  };
+
+  // Banco para el par (origen, destino) de un eje. Se guarda en una caché compartida, así que los
+  // planos, los niveles o las imágenes con las mismas dimensiones reutilizan el mismo
+  std::shared_ptr<filter_bank const> cached_bank(resize_filter filter, std::size_t source, std::size_t target);
+
+  struct resize_settings {
+    resize_filter filter = resize_filter::bilinear;
+    unsigned int threads = 1;
+  };
+
+  // Redimensiona con el filtro pedido; las muestras se redondean y se saturan a [0, max_color].
+  // bilinear usa resize_bilinear tal cual
+  template <typename T>
+  void resample(sample_grid<T const> source, sample_grid<T> target, int max_color, resize_settings settings);
+
+  struct resize_target {
+    std::size_t width  = 0;
+    std::size_t height = 0;
+  };
+
+  // Resize bilineal en flujo: escribe la cabecera P6 y cada fila de destino en cuanto se calcula.
+  // Las filas de origen se copian de input según se necesitan y sus páginas se liberan al dejarlas
+  // atrás; solo se guardan dos filas interpoladas, así que la memoria no depende del alto
+  void stream_resize(ImageInput const & input, ImageOutput & output, resize_target target);
+
+  // Pirámide de varios tamaños a partir de una sola imagen: cada nivel se obtiene del nivel ya
+  // calculado más pequeño que lo contiene (o del origen si no hay ninguno, o si es una ampliación).
+  // parent[i] == número de niveles indica el origen; waves agrupa los niveles por profundidad,
+  // de forma que los de una misma oleada solo dependen de oleadas anteriores
+  struct pyramid_plan {
+    std::vector<std::size_t> parent;
+    std::vector<std::vector<std::size_t>> waves;
+  };
+
+  pyramid_plan plan_pyramid(resize_target source, std::span<resize_target const> levels);
+
+  // Llama a build(nivel, hilos) oleada a oleada; los niveles de una oleada se calculan a la vez y
+  // se reparten entre ellos los threads hilos
+  template <typename Fn>
+  void for_each_level(pyramid_plan const & plan, unsigned int threads, Fn && build) {
+    for (auto const & wave : plan.waves) {
+      auto const inner = std::max(1U, threads / static_cast<unsigned int>(wave.size()));
+      parallel_chunks(wave.size(), 1, threads, [&](std::size_t first, std::size_t) { build(wave[first], inner); });
+    }
+  }
+}  // namespace common
+
+#endif  // COMMON_RESAMPLE_HPP
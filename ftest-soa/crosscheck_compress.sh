@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Comprueba que imtool-soa y imtool-aos producen el mismo fichero CPPM byte a byte
+if [ "$#" -lt 3 ]; then
+    echo "Usage: $0 <imtool-aos> <imtool-soa> <image1.ppm> [image2.ppm ...]"
+    exit 1
+fi
+
+AOS="$1"
+SOA="$2"
+shift 2
+STATUS=0
+
+for IMAGE in "$@"; do
+    OUT_AOS=$(mktemp)
+    OUT_SOA=$(mktemp)
+    "$AOS" "$IMAGE" "$OUT_AOS" compress > /dev/null
+    "$SOA" "$IMAGE" "$OUT_SOA" compress > /dev/null
+    if cmp -s "$OUT_AOS" "$OUT_SOA"; then
+        echo "OK: $IMAGE"
+    else
+        echo "DIFERENTE: $IMAGE"
+        STATUS=1
+    fi
+    rm -f "$OUT_AOS" "$OUT_SOA"
+done
+
+exit $STATUS
@@ -1,17 +1,28 @@
 #include "imgaos/imageaos.hpp"
-#include "common/binario.hpp"
+#include "common/bands.hpp"
+#include "common/cppm.hpp"
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+#include "common/levels.hpp"
+#include "common/nearest.hpp"
+#include "common/palette.hpp"
+#include "common/parallel.hpp"
 #include "common/progargs.hpp"
+#include "common/recycle.hpp"
+#include "common/resample.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
-#include <limits>
 #include <map>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -24,288 +35,358 @@ namespace imgaos {
   Image::Image(image_size size_init, int const max_c)
       : size{size_init}, max_color(max_c), pixels(static_cast<std::vector<Pixel>::size_type>(size_init.width * size_init.height)) {}
 
-  std::map<Pixel, uint32_t> getColors(std::vector<Pixel>& input, Image & picture){
-    std::map<Pixel, uint32_t> color_table;
-     // Contador explícito para los índices
-
-    for (const auto& color : input) {
-      // Solo añadir el color si no está en la tabla
-      if (color_table.find(color) == color_table.end()) {
-        color_table[color] = 0;
-        picture.colors++;
+  namespace {
+    template <typename P>
+    common::palette paletteOf(std::vector<P> const & pixels, int max_color, unsigned int threads) {
+      return common::build_palette(pixels.size(), max_color, [&pixels](std::size_t index) {
+        P const & pixel = pixels[index];
+        return common::pack_color(static_cast<uint64_t>(pixel.r), static_cast<uint64_t>(pixel.g),
+                                  static_cast<uint64_t>(pixel.b));
+      }, threads);
+    }
+
+    // Cabecera, tabla de colores e índices de un fichero C6 en un fichero ya abierto
+    void writeCPPM(common::ImageOutput & file, common::image_header const & header, common::palette const & colors,
+                   unsigned int threads) {
+      common::write_cppm_header(file, header, colors.colors.size());
+      std::vector<PixelOf<uint16_t>> table(colors.colors.size());
+      for (std::size_t i = 0; i < table.size(); ++i) {
+        uint64_t const key = colors.colors[i];
+        table[i]           = {.r = common::key_red(key), .g = common::key_green(key), .b = common::key_blue(key)};
       }
+      common::write_pixels(file, std::span<PixelOf<uint16_t> const>(table), header.max_color);
+      common::write_indices(file, colors.indices, colors.colors.size(), threads);
     }
-    uint32_t indice = 0;
-    for (auto [color, index] : color_table) {
-      color_table[color] = indice;
-      indice++;
+
+    template <typename T>
+    void unpackInto(std::span<uint8_t const> data, std::vector<PixelOf<T>> & pixels) {
+      common::unpack_rgb<T>(data, pixels.size(), [&pixels](std::size_t index, T red, T green, T blue) {
+        pixels[index] = {.r = red, .g = green, .b = blue};
+      });
     }
 
+    // Vista de las muestras intercaladas (r, g, b sin relleno) de un vector de píxeles compactos
+    template <typename P, typename T = decltype(std::remove_const_t<P>::r)>
+    auto samplesOf(std::span<P> pixels) {
+      static_assert(sizeof(P) == common::CHANNELS * sizeof(T));
+      using Sample = std::conditional_t<std::is_const_v<P>, T const, T>;
+      //NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      return std::span<Sample>(reinterpret_cast<Sample *>(pixels.data()), pixels.size() * common::CHANNELS);
+    }
+
+    // Devuelve los píxeles de una imagen que ya no se usa para la siguiente (modo batch)
+    template <typename T>
+    void recycleImage(ImageOf<T> & image) {
+      common::recycle_buffer(std::move(image.pixels));
+    }
+
+    template <typename T>
+    bool saveImage(ImageOf<T> const & image, std::string const & filename) {
+      common::ImageOutput file;
+      if (!file.open(filename)) {
+        std::cerr << "Error al abrir el fichero " << filename << '\n';
+        return false;
+      }
+      try {
+        common::write_ppm_header(file, {.magic     = "P6", .width = image.width, .height = image.height,
+                                        .max_color = image.max_color});
+        common::write_pixels(file, std::span<PixelOf<T> const>(image.pixels), image.max_color);
+        file.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      return true;
+    }
+  }  // namespace
+
+  common::palette buildPalette(std::vector<Pixel> const & pixels, int max_color, unsigned int threads) {
+    return paletteOf(pixels, max_color, threads);
+  }
+
+  template <typename T>
+  common::palette buildPalette(ImageOf<T> const & image, unsigned int threads) {
+    return paletteOf(image.pixels, image.max_color, threads);
+  }
+
+  template <typename T>
+  void readImage(common::ImageInput const & input, ImageOf<T> & image) {
+    common::image_header const & header = input.header();
+    image.width     = header.width;
+    image.height    = header.height;
+    image.max_color = header.max_color;
+    common::size_buffer(image.pixels, header.pixel_count());
+    unpackInto(input.payload(header.pixel_count() * common::CHANNELS * sizeof(T)), image.pixels);
+  }
+
+  std::map<Pixel, uint32_t> getColors(std::vector<Pixel>& input, Image & picture){
+    // La paleta ya sale ordenada: el mapa se rellena insertando siempre al final
+    common::palette const colors = buildPalette(input, picture.max_color);
+    std::map<Pixel, uint32_t> color_table;
+    for (uint32_t indice = 0; indice < colors.colors.size(); ++indice) {
+      uint64_t const key = colors.colors[indice];
+      color_table.emplace_hint(color_table.end(), Pixel{.r = common::key_red(key), .g = common::key_green(key),
+                                                        .b = common::key_blue(key)}, indice);
+    }
+    picture.colors += static_cast<uint32_t>(colors.colors.size());
     return color_table;
   }
 
   void write_dataCPPM(Image & picture, std::map<Pixel, uint32_t> & colorlist,std::string const & output_file){
-    std::ofstream file(output_file, std::ios::binary);
-    if (!file.is_open()) {
+    common::ImageOutput file;
+    if (!file.open(output_file)) {
       std::cerr << "Error al abrir el fichero " << output_file << "\n";
       return;
     }
-    file << "C6"<< " " << picture.size.width << " " << picture.size.height << " " << picture.max_color << " "<< picture.colors << "\n";
-    constexpr int limit1 = 255;
-    constexpr int limit2 = 65535;
+    file.write("C6 " + std::to_string(picture.size.width) + " " + std::to_string(picture.size.height) +
+               " " + std::to_string(picture.max_color) + " " + std::to_string(picture.colors) + "\n");
+    // La tabla de colores usa muestras de 1 byte (max_color <= 255) o de 2 bytes
+    std::vector<Pixel> palette;
+    palette.reserve(colorlist.size());
     for (const auto& [color, index] : colorlist) {
-      if (picture.max_color <= limit1) {
-        auto const red = static_cast<uint8_t>(color.r);
-        auto const green = static_cast<uint8_t>(color.g);
-        auto const blue = static_cast<uint8_t>(color.b);
-        binario::write_birary(file, red);
-        binario::write_birary(file, green);
-        binario::write_birary(file, blue);
-      }
-      else {
-        binario::write_birary(file, color.r);
-        binario::write_birary(file, color.g);
-        binario::write_birary(file, color.b);
-      }
+      palette.push_back(color);
     }
+    common::write_pixels(file, std::span<Pixel const>(palette), picture.max_color);
   //escribimos los pixeles
+    constexpr int limit1 = 255;
+    constexpr int limit2 = 65535;
     for (const auto& pixel : picture.pixels) {
       uint32_t const index = colorlist[pixel]; // Obtén el índice del color del píxel
       if (picture.colors <= limit1) {
-        binario::write_birary(file, static_cast<uint8_t>(index));
+        file.write_value(static_cast<uint8_t>(index));
       } else if (picture.colors <= limit2) {
-        binario::write_birary(file, static_cast<uint16_t>(index));
+        file.write_value(static_cast<uint16_t>(index));
       } else {
-        binario::write_birary(file, index);
+        file.write_value(index);
       }
     }
   }
 
-  // Implementación de compress (por completar)
-  void compress(progargsCommon::parameters_files &params) {
-    std::ifstream input(params.input_file, std::ios::binary);
+  void write_dataCPPM(Image const & picture, common::palette const & colors, std::string const & output_file,
+                      unsigned int threads) {
+    common::ImageOutput file;
+    if (!file.open(output_file)) {
+      std::cerr << "Error al abrir el fichero " << output_file << "\n";
+      return;
+    }
+    writeCPPM(file, {.magic     = "C6",
+                     .width     = static_cast<std::size_t>(picture.size.width),
+                     .height    = static_cast<std::size_t>(picture.size.height),
+                     .max_color = picture.max_color}, colors, threads);
+    file.close();
+  }
 
-    if (input.fail()) {
+  bool compress(progargsCommon::parameters_files &params, progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!input.open(params.input_file)) {
       std::cerr << "Error al abrir el fichero " << params.input_file << '\n';
-      return;
+      return false;
     }
 
-    std::string identification;
-    int width     = 0;
-    int height    = 0;
-    int max_color = 0;
-    input >> identification >> width >> height >> max_color;
-    input.get();
-    if (strcmp(identification.c_str(), "P6")!=0) {
+    common::image_header const & header = input.header();
+    if (header.magic != "P6") {
       std::cerr << "Invalid file type, the file:"<<params.input_file << " must be in PPM format\n";
-      return;
+      return false;
     }
-    Image picture({.width=width, .height=height}, max_color);
-    int const color_frontera = 255;
-
-    for(std::size_t i = 0; i < picture.pixels.size(); i++) {
-      if (picture.max_color <= color_frontera) {
-        picture.pixels[i].r = static_cast<int>(binario::read_binary<uint8_t>(input));
-        picture.pixels[i].g = static_cast<int>(binario::read_binary<uint8_t>(input));
-        picture.pixels[i].b = static_cast<int>(binario::read_binary<uint8_t>(input));
-      } else {
-        picture.pixels[i].r = static_cast<int>(binario::read_binary<uint16_t>(input));
-        picture.pixels[i].g = static_cast<int>(binario::read_binary<uint16_t>(input));
-        picture.pixels[i].b = static_cast<int>(binario::read_binary<uint16_t>(input));
+    // Píxeles de 3 bytes si maxval <= 255 y de 6 si no
+    return common::dispatch_sample(header.max_color, [&]<typename T>(T) {
+      ImageOf<T> picture;
+      readImage(input, picture);
+      common::palette const colors = buildPalette(picture, opts.threads);
+      common::ImageOutput file;
+      if (!file.open(params.output_file)) {
+        std::cerr << "Error al abrir el fichero " << params.output_file << "\n";
+        return false;
       }
-    }
+      try {
+        writeCPPM(file, {.magic = "C6", .width = header.width, .height = header.height, .max_color = header.max_color},
+                  colors, opts.threads);
+        file.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      recycleImage(picture);
+      return true;
+    });
+  }
 
-    std::map<Pixel, uint32_t> colorlist = getColors(picture.pixels, picture);
+  bool decompress(progargsCommon::parameters_files const & params) {
+    common::ImageInput input;
+    if (!input.open(params.input_file)) {
+      std::cerr << "Error al abrir el fichero " << params.input_file << '\n';
+      return false;
+    }
+    if (input.header().magic != "C6") {
+      std::cerr << "Invalid file type, the file:" << params.input_file << " must be in CPPM format\n";
+      return false;
+    }
+    common::ImageOutput output;
+    if (!output.open(params.output_file)) {
+      std::cerr << "Error al abrir el fichero " << params.output_file << '\n';
+      return false;
+    }
+    try {
+      common::decompress_cppm(input, output);
+      output.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
+    }
+    return true;
+  }
 
-    write_dataCPPM(picture, colorlist ,params.output_file);
+  // Desempaqueta la carga útil P6 en un vector de píxeles AOS
+  void readImagePixels(common::ImageInput const & input, std::vector<Pixel> & pixels) {
+    common::image_header const & header = input.header();
+    auto const data = input.payload(pixels.size() * common::CHANNELS * header.sample_size());
+    auto const store = [&pixels](std::size_t index, auto red, auto green, auto blue) {
+      pixels[index] = {.r = red, .g = green, .b = blue};
+    };
+    if (header.max_color <= MAX_COLOR_VALUE) {
+      common::unpack_rgb<uint8_t>(data, pixels.size(), store);
+    } else {
+      common::unpack_rgb<uint16_t>(data, pixels.size(), store);
+    }
   }
 
 // Función para leer una imagen PPM y almacenarla en un vector de píxeles
 std::vector<Pixel> readPPM(std::string const & filename, std::size_t & width, std::size_t & height) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) { throw std::runtime_error("Error: No se pudo abrir el archivo de entrada."); }
-
-  std::string header;
-  file >> header;
-  if (header != "P6") { throw std::runtime_error("Error: Formato de archivo PPM no soportado."); }
-
-  file >> width >> height;
-  int maxVal = 0;
-  file >> maxVal;
-  file.ignore(1);
+  common::ImageInput input;
+  if (!input.open(filename)) { throw std::runtime_error("Error: No se pudo abrir el archivo de entrada."); }
 
-  std::vector<Pixel> image(width * height);
-  if (maxVal <= MAX_COLOR_VALUE) {
-    // Leer los píxeles si el valor máximo de color es menor o igual a 255
-    for (std::size_t i = 0; i < width * height; ++i) {
-      image[i].r = binario::read_binary<unsigned char>(file);
-      image[i].g = binario::read_binary<unsigned char>(file);
-      image[i].b = binario::read_binary<unsigned char>(file);
-    }
-  } else if (maxVal <= MAX_COLOR_VALUE_EXTENDED) {
-    // Leer los píxeles si el valor máximo de color es menor o igual a 65535
-    for (std::size_t i = 0; i < width * height; ++i) {
-      image[i].r = binario::read_binary<uint16_t>(file);
-      image[i].g = binario::read_binary<uint16_t>(file);
-      image[i].b = binario::read_binary<uint16_t>(file);
-    }
-  } else {
-    throw std::runtime_error("Error: Valor máximo no soportado: " + std::to_string(maxVal));
+  common::image_header const & header = input.header();
+  if (header.magic != "P6") { throw std::runtime_error("Error: Formato de archivo PPM no soportado."); }
+  if (header.max_color > MAX_COLOR_VALUE_EXTENDED) {
+    throw std::runtime_error("Error: Valor máximo no soportado: " + std::to_string(header.max_color));
   }
 
+  width  = header.width;
+  height = header.height;
+  std::vector<Pixel> image(width * height);
+  readImagePixels(input, image);
   return image;
 }
 
 // Función para escribir una imagen PPM desde un vector de píxeles
 void writePPM(std::string const & filename, std::vector<Pixel> const & image, std::size_t width, std::size_t height) {
-  std::ofstream file(filename, std::ios::binary);
-  if (!file) { throw std::runtime_error("Error: No se pudo abrir el archivo de salida."); }
+  common::ImageOutput file;
+  if (!file.open(filename)) { throw std::runtime_error("Error: No se pudo abrir el archivo de salida."); }
 
-  file << "P6\n" << width << " " << height << "\n" << MAX_COLOR_VALUE << "\n";
-  for (auto const & pixel : image) {
-    binario::write_birary(file, static_cast<unsigned char>(pixel.r));
-    binario::write_birary(file, static_cast<unsigned char>(pixel.g));
-    binario::write_birary(file, static_cast<unsigned char>(pixel.b));
-  }
+  common::write_ppm_header(file, {.magic = "P6", .width = width, .height = height, .max_color = MAX_COLOR_VALUE});
+  common::write_pixels(file, std::span<Pixel const>(image), MAX_COLOR_VALUE);
+  file.close();
 }
 
-// Función para contar la frecuencia de colores en la imagen
-std::unordered_map<Pixel, int, PixelHash> countColorFrequencyWithParams(const CutFreqParams& params) {
-  std::unordered_map<Pixel, int, PixelHash> frequencyMap;
-
-  for (const auto& pixel : params.image) {
-    frequencyMap[pixel]++;
+namespace {
+  // Versiones genéricas de cutfreq: P es Pixel o PixelOf<T>
+  template <typename P>
+  std::uint64_t keyOf(P const & pixel) {
+    return common::pack_color(static_cast<std::uint64_t>(pixel.r), static_cast<std::uint64_t>(pixel.g),
+                              static_cast<std::uint64_t>(pixel.b));
   }
 
-  return frequencyMap;
-}
-
-// Función para obtener los n colores menos frecuentes
-  std::vector<Pixel> getLeastFrequentColors(std::unordered_map<Pixel, int, PixelHash> frequencyMap, int n) {
-    std::vector<std::pair<Pixel, int>> colorFrequency(frequencyMap.begin(), frequencyMap.end());
+  template <typename P>
+  P pixelOf(std::uint64_t key) {
+    using Sample = decltype(P::r);
+    return P{static_cast<Sample>(common::key_red(key)), static_cast<Sample>(common::key_green(key)),
+             static_cast<Sample>(common::key_blue(key))};
+  }
 
-    // Use std::ranges::sort to sort the colors by frequency (menor a mayor) y luego por componentes b, g, r
-    std::ranges::sort(colorFrequency, [](auto const & pixelA, auto const & pixelB) {
-      if (pixelA.second != pixelB.second) {
-        return pixelA.second < pixelB.second;
-      }
-      if (pixelA.first.b != pixelB.first.b) {
-        return pixelA.first.b > pixelB.first.b;
-      }
-      if (pixelA.first.g != pixelB.first.g) {
-        return pixelA.first.g > pixelB.first.g;
-      }
-      return pixelA.first.r > pixelB.first.r;
-    });
+  // Histograma de la imagen; solo PixelOf<uint8_t> garantiza muestras de 8 bits
+  template <typename P>
+  common::color_histogram countFrequency(std::vector<P> const & pixels, unsigned int threads) {
+    int const maxColor = sizeof(P::r) == 1 ? MAX_COLOR_VALUE : MAX_COLOR_VALUE_EXTENDED;
+    common::color_histogram histogram(pixels.size(), maxColor);
+    histogram.count(pixels.size(), [&](std::size_t i) { return keyOf(pixels[i]); }, threads);
+    return histogram;
+  }
 
-    std::vector<Pixel> colorsToRemove;
-    size_t const numColorsToRemove = std::min(static_cast<size_t>(n), colorFrequency.size());
-    colorsToRemove.reserve(numColorsToRemove); // Pre-allocate the capacity
+  template <typename P>
+  std::vector<P> leastFrequent(std::vector<common::color_count> const & counts, int n) {
+    std::vector<P> colorsToRemove;
+    for (auto const key : common::least_frequent(counts, static_cast<std::size_t>(std::max(n, 0)))) {
+      colorsToRemove.push_back(pixelOf<P>(key));
+    }
+    return colorsToRemove;
+  }
 
-    for (size_t i = 0; i < numColorsToRemove; ++i) {
-      colorsToRemove.push_back(colorFrequency[i].first);
+  template <typename P>
+  void cutfreqPixels(std::vector<P> & pixels, int n, unsigned int threads) {
+    if (n < 1) {
+      throw std::invalid_argument("Error: cutfreq no valido: " + std::to_string(n));
     }
 
-    return colorsToRemove;
+    auto const plan = common::plan_cutfreq(countFrequency(pixels, threads), static_cast<std::size_t>(n),
+                                           threads);
+    common::color_remap const remap(plan);
+
+    // Cada hilo sustituye los píxeles de su tramo
+    common::parallel_for(pixels.size(), threads, [&](std::size_t first, std::size_t last, unsigned int) {
+      for (std::size_t i = first; i < last; ++i) {
+        std::uint64_t const key = keyOf(pixels[i]);
+        if (std::uint64_t const target = remap(key); target != key) { pixels[i] = pixelOf<P>(target); }
+      }
+    });
   }
+}  // namespace
 
-// Función para construir un grid optimizado para la búsqueda de colores
-std::unordered_map<int, std::vector<Pixel>> buildGrid(const std::vector<Pixel>& image, int gridSize) {
-  std::unordered_map<int, std::vector<Pixel>> grid;
-  for (const auto& pixel : image) {
-    int const key = ((pixel.r / gridSize) * RED_MULTIPLIER) + ((pixel.g / gridSize) * GREEN_MULTIPLIER) + (pixel.b / gridSize);
-    grid[key].push_back(pixel);
+// Función para contar la frecuencia de colores en la imagen
+std::unordered_map<Pixel, int, PixelHash> countColorFrequencyWithParams(const CutFreqParams& params) {
+  std::unordered_map<Pixel, int, PixelHash> frequencyMap;
+  for (auto const & color : countFrequency(params.image, 1).counts()) {
+    frequencyMap.emplace(pixelOf<Pixel>(color.key), static_cast<int>(color.count));
   }
-  return grid;
+  return frequencyMap;
 }
 
-// Función para encontrar el color más cercano optimizado usando el grid
-Pixel findClosestColorOptimized(const Pixel& color, const std::unordered_map<int, std::vector<Pixel>>& grid, int gridSize) {
-  int const key = ((color.r / gridSize) * RED_MULTIPLIER) + ((color.g / gridSize) * GREEN_MULTIPLIER) + (color.b / gridSize);
-  Pixel closestColor = {.r=0, .g=0, .b=0};
-  double minDistanceSquared = std::numeric_limits<double>::max();
-
-  for (int dr = -1; dr <= 1; ++dr) {
-    for (int dg = -1; dg <= 1; ++dg) {
-      for (int db = -1; db <= 1; ++db) {
-        int const neighborKey = key + (dr * RED_MULTIPLIER) + (dg * GREEN_MULTIPLIER )+ db;
-        if (grid.find(neighborKey) != grid.end()) {
-          for (const auto& neighborColor : grid.at(neighborKey)) {
-            double const distanceSquared = std::pow(color.r - neighborColor.r, 2) +
-                                     std::pow(color.g - neighborColor.g, 2) +
-                                     std::pow(color.b - neighborColor.b, 2);
-            if (distanceSquared < minDistanceSquared) {
-              minDistanceSquared = distanceSquared;
-              closestColor = neighborColor;
-            }
-          }
-        }
-      }
+// Función para obtener los n colores menos frecuentes
+  std::vector<Pixel> getLeastFrequentColors(std::unordered_map<Pixel, int, PixelHash> const & frequencyMap, int n) {
+    std::vector<common::color_count> counts;
+    counts.reserve(frequencyMap.size());
+    for (auto const & [color, count] : frequencyMap) {
+      counts.push_back({.key = keyOf(color), .count = static_cast<std::uint32_t>(count)});
     }
+    return leastFrequent<Pixel>(counts, n);
   }
-  return closestColor;
-}
 
 // Función principal para eliminar los colores menos frecuentes de la imagen
 void cutfreq(CutFreqParams& params) {
-  if (params.n < 1) {
-    throw std::invalid_argument("Error: cutfreq no valido: " + std::to_string(params.n));
-  }
-
-  auto frequencyMap = countColorFrequencyWithParams(params);
-  auto colorsToRemove = getLeastFrequentColors(frequencyMap, params.n);
-  std::unordered_set<Pixel, PixelHash> const colorsToRemoveSet(colorsToRemove.begin(), colorsToRemove.end());
-
-  auto grid = buildGrid(params.image, GRID_SIZE);
-
-  std::unordered_map<Pixel, Pixel, PixelHash> replacementMap;
-  for (const auto& color : colorsToRemove) {
-    Pixel const closestColor = findClosestColorOptimized(color, grid, GRID_SIZE);
-    replacementMap[color] = closestColor;
-  }
-
-  std::unordered_map<Pixel, Pixel, PixelHash> colorCache;
-
-  for (auto& pixel : params.image) {
-    auto cacheIter = colorCache.find(pixel);
-    if (cacheIter != colorCache.end()) {
-      pixel = cacheIter->second;
-    } else {
-      auto iter = replacementMap.find(pixel);
-      if (iter != replacementMap.end()) {
-        pixel = iter->second;
-        colorCache[pixel] = iter->second;
-      }
-    }
-  }
+  cutfreqPixels(params.image, params.n, 1);
 }
 
-
+  template <typename T>
+  void cutfreq(ImageOf<T> & image, int n, unsigned int threads) {
+    cutfreqPixels(image.pixels, n, threads);
+  }
 
   bool loadPhoto(Photo& photo, const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
+    common::ImageInput input;
+    if (!input.open(filename)) {
       std::cerr << "Error al abrir el fichero " << filename << '\n';
       return false;
     }
 
-    if (!readHeader(file, photo)) {
+    if (!readHeader(input, photo)) {
       return false;
     }
 
     photo.pixels.resize(static_cast<unsigned long long>(photo.width) * static_cast<unsigned long long>(photo.height));
     if (photo.maxColorValue <= MAX_COLOR_VALUE) {
-      readPixels<unsigned char>(file, photo);
+      readPixels<unsigned char>(input, photo);
     } else {
-      readPixels<unsigned short>(file, photo);
+      readPixels<unsigned short>(input, photo);
     }
 
     return true;
   }
 
-  bool readHeader(std::ifstream& file, Photo& photo) {
-    file >> photo.magicNumber >> photo.width >> photo.height >> photo.maxColorValue;
-    file.ignore(1); // Ignore the newline character after maxColorValue
+  bool readHeader(common::ImageInput const & input, Photo& photo) {
+    common::image_header const & header = input.header();
+    photo.magicNumber   = header.magic;
+    photo.width         = static_cast<int>(header.width);
+    photo.height        = static_cast<int>(header.height);
+    photo.maxColorValue = static_cast<unsigned int>(header.max_color);
 
     if (photo.magicNumber != "P6") {
       std::cerr << "Error: formato de imagen no valido.\n";
@@ -315,110 +396,184 @@ void cutfreq(CutFreqParams& params) {
   }
 
   template<typename T>
-  void readPixels(std::ifstream& file, Photo& photo) {
-    for (auto& pixel : photo.pixels) {
-      pixel.r = binario::read_binary<T>(file);
-      pixel.g = binario::read_binary<T>(file);
-      pixel.b = binario::read_binary<T>(file);
-    }
+  void readPixels(common::ImageInput const & input, Photo& photo) {
+    unpackPixels<T>(input.payload(photo.pixels.size() * common::CHANNELS * sizeof(T)), photo);
+  }
+
+  template<typename T>
+  void unpackPixels(std::span<uint8_t const> data, Photo& photo) {
+    common::unpack_rgb<T>(data, photo.pixels.size(), [&photo](std::size_t index, T red, T green, T blue) {
+      photo.pixels[index] = {.r = red, .g = green, .b = blue};
+    });
   }
 
   bool savePhoto(const Photo& photo, const std::string& filename) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) {
+    common::ImageOutput file;
+    if (!file.open(filename)) {
       std::cerr << "Error al abrir el fichero " << filename << '\n';
       return false;
     }
 
-    file << photo.magicNumber << "\n" << photo.width << " " << photo.height << "\n" << photo.maxColorValue << "\n";
-
-    if (photo.maxColorValue <= MAX_COLOR_VALUE) {
-      for (const auto& pixel : photo.pixels) {
-        binario::write_birary(file, static_cast<unsigned char>(pixel.r));
-        binario::write_birary(file, static_cast<unsigned char>(pixel.g));
-        binario::write_birary(file, static_cast<unsigned char>(pixel.b));
-      }
-    } else {
-      for (const auto& pixel : photo.pixels) {
-        binario::write_birary(file, static_cast<unsigned short>(pixel.r));
-        binario::write_birary(file, static_cast<unsigned short>(pixel.g));
-        binario::write_birary(file, static_cast<unsigned short>(pixel.b));
-      }
+    try {
+      auto const max_color = static_cast<int>(photo.maxColorValue);
+      common::write_ppm_header(file, {.magic     = photo.magicNumber,
+                                      .width     = static_cast<std::size_t>(photo.width),
+                                      .height    = static_cast<std::size_t>(photo.height),
+                                      .max_color = max_color});
+      common::write_pixels(file, std::span<Pixel const>(photo.pixels), max_color);
+      file.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
     }
 
     return true;
   }
 
-  void maxlevel(Photo& photo, unsigned int newMaxValue) {
-    double const scaleFactor = static_cast<double>(newMaxValue) / photo.maxColorValue;
+  void maxlevel(Photo& photo, unsigned int newMaxValue, common::rounding mode) {
+    maxlevel(photo, common::level_table(photo.maxColorValue, newMaxValue, mode));
+  }
+
+  void maxlevel(Photo& photo, common::level_table const & table) {
     for (auto& pixel : photo.pixels) {
-      pixel.r = static_cast<int>(pixel.r * scaleFactor);
-      pixel.g = static_cast<int>(pixel.g * scaleFactor);
-      pixel.b = static_cast<int>(pixel.b * scaleFactor);
+      pixel.r = table(pixel.r);
+      pixel.g = table(pixel.g);
+      pixel.b = table(pixel.b);
     }
-    photo.maxColorValue = newMaxValue;
+    photo.maxColorValue = table.new_max();
+  }
+
+  template <typename In, typename Out>
+  void maxlevel(ImageOf<In> const & input, ImageOf<Out> & output, common::level_table const & table) {
+    output.width     = input.width;
+    output.height    = input.height;
+    output.max_color = static_cast<int>(table.new_max());
+    common::size_buffer(output.pixels, input.pixels.size());
+    // Las tres muestras de cada píxel se escalan igual: la tabla se aplica a todas seguidas
+    table.apply(samplesOf(std::span(input.pixels)), samplesOf(std::span(output.pixels)));
   }
 
 
+  namespace {
+    // Desempaqueta la carga útil fila a fila; T es el tipo de muestra del fichero y P el del píxel
+    template <typename T, typename P>
+    void readRows(common::ImageInput const & input, std::vector<std::vector<P>> & image) {
+      common::image_header const & header = input.header();
+      image.resize(header.height, std::vector<P>(header.width));
+      auto const data = input.payload(header.pixel_count() * common::CHANNELS * sizeof(T));
+      std::size_t const row_bytes = header.width * common::CHANNELS * sizeof(T);
+      for (std::size_t y_ = 0; y_ < header.height; ++y_) {
+        auto & row = image[y_];
+        common::unpack_rgb<T>(data.subspan(y_ * row_bytes, row_bytes), header.width,
+                              [&row](std::size_t x_, T red, T green, T blue) {
+          row[x_] = {.r = red, .g = green, .b = blue};
+        });
+      }
+    }
+
+    template <typename P>
+    bool saveRows(std::string const & filename, std::vector<std::vector<P>> const & image, int max_color) {
+      common::ImageOutput file;
+      if (!file.open(filename)) {
+        std::cerr << "Error al abrir el fichero " << filename << " para escritura.\n";
+        return false;
+      }
+
+      try {
+        // El empaquetado satura cada canal a [0, max_color] según el ancho de muestra
+        common::write_ppm_header(file, {.magic     = "P6",
+                                        .width     = image[0].size(),
+                                        .height    = image.size(),
+                                        .max_color = max_color});
+        for (auto const & row : image) {
+          common::write_pixels(file, std::span<P const>(row), max_color);
+        }
+        file.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      return true;
+    }
+
+    // Vista de una imagen por filas: una vista por fila calculada una sola vez. Sobre ImageOf todas
+    // apuntan al mismo búfer contiguo con paso width
+    template <typename P>
+    using RowSpans = std::vector<std::span<P const>>;
+
+    template <typename P>
+    RowSpans<P> rowsOf(std::vector<std::vector<P>> const & image) {
+      RowSpans<P> rows(image.size());
+      for (std::size_t y_ = 0; y_ < rows.size(); ++y_) {
+        rows[y_] = std::span<P const>(image[y_]);
+      }
+      return rows;
+    }
+
+    // Interpolación bilineal de un píxel de cualquier tipo P (Pixel o PixelOf<T>)
+    template <typename P>
+    P interpolatePixel(RowSpans<P> const & original, double xcoord, double ycoord) {
+      using Sample = decltype(P::r);
+      // Calcular las coordenadas inferiores y superiores en x e y
+      int const width_  = static_cast<int>(original[0].size());
+      int const height_ = static_cast<int>(original.size());
+      int xl_           = std::max(0, static_cast<int>(std::floor(xcoord)));
+      int const xh_     = std::min(width_ - 1, static_cast<int>(std::ceil(xcoord)));
+      int yl_           = std::max(0, static_cast<int>(std::floor(ycoord)));
+      int const yh_     = std::min(height_ - 1, static_cast<int>(std::ceil(ycoord)));
+
+      // Obtener los cuatro píxeles vecinos de las dos filas implicadas
+      std::span<P const> const low  = original[static_cast<std::size_t>(yl_)];
+      std::span<P const> const high = original[static_cast<std::size_t>(yh_)];
+      P const & p1_ = low[static_cast<std::size_t>(xl_)];
+      P const & p2_ = low[static_cast<std::size_t>(xh_)];
+      P const & p3_ = high[static_cast<std::size_t>(xl_)];
+      P const & p4_ = high[static_cast<std::size_t>(xh_)];
+
+      // Función lambda para interpolar un canal de color
+      auto interpolate = [&](double p1_val, double p2_val, double p3_val, double p4_val) {
+        double const dx_ = xcoord - xl_;
+        double const dy_ = ycoord - yl_;
+        double const w1_ = (1 - dx_) * (1 - dy_);
+        double const w2_ = dx_ * (1 - dy_);
+        double const w3_ = (1 - dx_) * dy_;
+        double const w4_ = dx_ * dy_;
+        return static_cast<Sample>(static_cast<uint16_t>((p1_val * w1_) + (p2_val * w2_) + (p3_val * w3_) +
+                                                         (p4_val * w4_)));
+      };
+      return {.r = interpolate(p1_.r, p2_.r, p3_.r, p4_.r),
+              .g = interpolate(p1_.g, p2_.g, p3_.g, p4_.g),
+              .b = interpolate(p1_.b, p2_.b, p3_.b, p4_.b)};
+    }
+  }  // namespace
+
   bool loadPPM(std::string const & filename, std::vector<std::vector<Pixel>> & image) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
+    common::ImageInput input;
+    if (!input.open(filename)) {
       std::cerr << "Error al abrir el fichero " << filename << "\n";
       return false;
     }
 
     // Leer el encabezado del archivo PPM
-    std::string header;
-    file >> header;
-    if (header != "P6") {
-      std::cerr << "Error: formato de imagen erroneo (" << header << ")\n";
+    common::image_header const & header = input.header();
+    if (header.magic != "P6") {
+      std::cerr << "Error: formato de imagen erroneo (" << header.magic << ")\n";
       return false;
     }
 
-    int width         = 0;
-    int height        = 0;
-    int maxColorValue = 0;
-    file >> width >> height >> maxColorValue;
-    file.ignore(kMaxLineLength, '\n');      // Skip to the end of the line
-    if (maxColorValue != kMaxColorValue) {  // Ensure max color value is 255 for 8-bit images
-      std::cerr << "Error: Valor maximo no soportado (" << maxColorValue << ")\n";
+    if (header.max_color != kMaxColorValue) {  // Ensure max color value is 255 for 8-bit images
+      std::cerr << "Error: Valor maximo no soportado (" << header.max_color << ")\n";
       return false;
     }
 
-    // Redimensionar el vector de imagen para contener los píxeles
-    image.resize(static_cast<unsigned long>(height),
-                 std::vector<Pixel>(static_cast<unsigned long>(width)));
-
-    // Leer los datos de los píxeles
-    for (auto & row : image) {
-      for (auto & pixel : row) {
-        pixel.r = (binario::read_binary<uint8_t>(file));
-        pixel.g = (binario::read_binary<uint8_t>(file));
-        pixel.b = (binario::read_binary<uint8_t>(file));
-      }
-    }
+    readRows<uint8_t>(input, image);
     return true;
   }
 
   // Función para guardar una imagen PPM en un archivo
   bool savePPM(std::string const & filename, std::vector<std::vector<Pixel>> const & image) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) {
-      std::cerr << "Error al abrir el fichero " << filename << " para escritura.\n";
-      return false;
-    }
-
-    int const width  = static_cast<int>(image[0].size());
-    int const height = static_cast<int>(image.size());
-    file << "P6\n" << width << " " << height << "\n255\n";  // Ensure max color value is 255
-    for (auto const & row : image) {
-      for (auto const & pixel : row) {
-        binario::write_birary(file, static_cast<uint8_t>(clamp(pixel.r, 0, kMaxColorValue)));
-        binario::write_birary(file, static_cast<uint8_t>(clamp(pixel.g, 0, kMaxColorValue)));
-        binario::write_birary(file, static_cast<uint8_t>(clamp(pixel.b, 0, kMaxColorValue)));
-      }
-    }
-    return true;
+    // Ensure max color value is 255
+    return saveRows(filename, image, kMaxColorValue);
   }
 
   // Función para limitar un valor entre un mínimo y un máximo
@@ -429,132 +584,339 @@ void cutfreq(CutFreqParams& params) {
   // Función para interpolación bilineal de un píxel
   Pixel bilinearInterpolate(std::vector<std::vector<Pixel>> const & original, double xcoord,
                             double ycoord) {
-    // Calcular las coordenadas inferiores y superiores en x e y
-    int const width_  = static_cast<int>(original[0].size());
-    int const height_ = static_cast<int>(original.size());
-    int xl_           = std::max(0, static_cast<int>(std::floor(xcoord)));
-    int const xh_     = std::min(width_ - 1, static_cast<int>(std::ceil(xcoord)));
-    int yl_           = std::max(0, static_cast<int>(std::floor(ycoord)));
-    int const yh_     = std::min(height_ - 1, static_cast<int>(std::ceil(ycoord)));
-
-    // Obtener los cuatro píxeles vecinos
-    Pixel const & p1_ = original[static_cast<unsigned long>(yl_)][static_cast<unsigned long>(xl_)];
-    Pixel const & p2_ = original[static_cast<unsigned long>(yl_)][static_cast<unsigned long>(xh_)];
-    Pixel const & p3_ = original[static_cast<unsigned long>(yh_)][static_cast<unsigned long>(xl_)];
-    Pixel const & p4_ = original[static_cast<unsigned long>(yh_)][static_cast<unsigned long>(xh_)];
-
-    // Función lambda para interpolar un canal de color
-    auto interpolate = [&](double p1_val, double p2_val, double p3_val, double p4_val) {
-      double const dx_ = xcoord - xl_;
-      double const dy_ = ycoord - yl_;
-      double const w1_ = (1 - dx_) * (1 - dy_);
-      double const w2_ = dx_ * (1 - dy_);
-      double const w3_ = (1 - dx_) * dy_;
-      double const w4_ = dx_ * dy_;
-      return static_cast<uint16_t>((p1_val * w1_) + (p2_val * w2_) + (p3_val * w3_) +
-                                   (p4_val * w4_));
-    };
-    Pixel result{.r = interpolate(p1_.r, p2_.r, p3_.r, p4_.r),
-                 .g = interpolate(p1_.g, p2_.g, p3_.g, p4_.g),
-                 .b = interpolate(p1_.b, p2_.b, p3_.b, p4_.b)};
-    return result;
+    return interpolatePixel(rowsOf(original), xcoord, ycoord);
   }
 
-  // Función para redimensionar una imagen usando interpolación bilineal
+  namespace {
+    // Pasa las filas a una imagen compacta con muestras T, la redimensiona y vuelve a filas
+    template <typename T>
+    std::vector<std::vector<Pixel>> resizeRows(std::vector<std::vector<Pixel>> const & original, int max_color,
+                                               int newWidth, int newHeight) {
+      ImageOf<T> compact{.width = original[0].size(), .height = original.size(), .max_color = max_color,
+                         .pixels = {}};
+      compact.pixels.reserve(compact.width * compact.height);
+      for (auto const & row : original) {
+        for (auto const & pixel : row) {
+          compact.pixels.push_back({.r = common::saturate<T>(pixel.r, max_color),
+                                    .g = common::saturate<T>(pixel.g, max_color),
+                                    .b = common::saturate<T>(pixel.b, max_color)});
+        }
+      }
+      ImageOf<T> const scaled = resizeImage(compact, newWidth, newHeight);
+      std::vector<std::vector<Pixel>> resized(scaled.height, std::vector<Pixel>(scaled.width));
+      for (std::size_t i = 0; i < scaled.pixels.size(); ++i) {
+        PixelOf<T> const & pixel = scaled.pixels[i];
+        resized[i / scaled.width][i % scaled.width] = {.r = pixel.r, .g = pixel.g, .b = pixel.b};
+      }
+      return resized;
+    }
+  }  // namespace
+
+  // Función para redimensionar una imagen usando interpolación bilineal. Conserva la interfaz por
+  // filas y usa el mismo motor, con muestras de 8 bits si todas caben
   std::vector<std::vector<Pixel>> resizeImage(std::vector<std::vector<Pixel>> const & original,
                                               int newWidth, int newHeight) {
-    // Obtener ancho y alto de la imagen original
-    int const originalWidth  = static_cast<int>(original[0].size());
-    int const originalHeight = static_cast<int>(original.size());
-    // Crear el vector para la imagen redimensionada
-    std::vector<std::vector<Pixel>> resized(
-        static_cast<unsigned long>(newHeight),
-        std::vector<Pixel>(static_cast<unsigned long>(newWidth)));
-
-    // Recorrer cada píxel de la imagen redimensionada
-    for (std::size_t y_ = 0; y_ < static_cast<std::size_t>(newHeight); ++y_) {
-      for (std::size_t x_ = 0; x_ < static_cast<std::size_t>(newWidth); ++x_) {
-        auto const originalX = static_cast<double>(x_) * (static_cast<double>(originalWidth - 1) /
-                                                          static_cast<double>(newWidth - 1));
-        auto const originalY = static_cast<double>(y_) * (static_cast<double>(originalHeight - 1) /
-                                                          static_cast<double>(newHeight - 1));
-        // Se obtiene el valor del píxel interpolado y se asigna a la posición actual de la imagen
-        // redimensionada.
-        // Obtener el píxel interpolado y asignarlo a la imagen redimensionada
-        resized[y_][x_] = bilinearInterpolate(original, originalX, originalY);
+    bool const narrow = std::ranges::all_of(original, [](std::vector<Pixel> const & row) {
+      return std::ranges::all_of(row, [](Pixel const & pixel) {
+        return std::max({pixel.r, pixel.g, pixel.b}) <= MAX_COLOR_VALUE;
+      });
+    });
+    if (narrow) { return resizeRows<uint8_t>(original, MAX_COLOR_VALUE, newWidth, newHeight); }
+    return resizeRows<uint16_t>(original, MAX_COLOR_VALUE_EXTENDED, newWidth, newHeight);
+  }
+
+  // Redimensionado separable sobre las muestras intercaladas del búfer contiguo, con el filtro de opts
+  template <typename T>
+  ImageOf<T> resizeImage(ImageOf<T> const & original, int newWidth, int newHeight,
+                         progargsCommon::options const & opts) {
+    ImageOf<T> resized{.width     = static_cast<std::size_t>(newWidth),
+                       .height    = static_cast<std::size_t>(newHeight),
+                       .max_color = original.max_color,
+                       .pixels    = {}};
+    common::size_buffer(resized.pixels, resized.width * resized.height);
+    common::resample<T>({.data     = samplesOf(std::span(original.pixels)),
+                         .width    = original.width,
+                         .height   = original.height,
+                         .channels = common::CHANNELS},
+                        {.data     = samplesOf(std::span(resized.pixels)),
+                         .width    = resized.width,
+                         .height   = resized.height,
+                         .channels = common::CHANNELS},
+                        original.max_color, {.filter = opts.filter, .threads = opts.threads});
+    return resized;
+  }
+
+  namespace {
+    // Abre la imagen de entrada de resize y comprueba que es P6
+    bool openResizable(common::ImageInput & input, std::string const & filename) {
+      if (!input.open(filename)) {
+        std::cerr << "Error al abrir el fichero " << filename << "\n";
+        return false;
       }
+      if (input.header().magic != "P6") {
+        std::cerr << "Error: formato de imagen erroneo (" << input.header().magic << ")\n";
+        return false;
+      }
+      return true;
     }
-    return resized;
+
+    // resize --stream: las filas de destino se escriben según salen, sin cargar la imagen
+    bool streamResize(common::ImageInput const & input, std::string const & filename, common::resize_target target,
+                      progargsCommon::options const & opts) {
+      if (opts.filter != common::resize_filter::bilinear) {
+        std::cerr << "Error: --stream solo admite el filtro bilinear\n";
+        return false;
+      }
+      common::ImageOutput output;
+      if (!output.open(filename)) {
+        std::cerr << "Error al abrir el fichero " << filename << " para escritura.\n";
+        return false;
+      }
+      try {
+        common::stream_resize(input, output, target);
+        output.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      return true;
+    }
+  }  // namespace
+
+  bool resize(progargsCommon::parameters_files const & params, int newWidth, int newHeight,
+              progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!openResizable(input, params.input_file)) { return false; }
+    if (opts.stream) {
+      return streamResize(input, params.output_file,
+                          {.width  = static_cast<std::size_t>(newWidth),
+                           .height = static_cast<std::size_t>(newHeight)}, opts);
+    }
+    // Búfer contiguo de entrada y de salida: una sola reserva por imagen
+    return common::dispatch_sample(input.header().max_color, [&]<typename T>(T) {
+      ImageOf<T> original;
+      readImage(input, original);
+      ImageOf<T> resized = resizeImage(original, newWidth, newHeight, opts);
+      bool const saved   = saveImage(resized, params.output_file);
+      recycleImage(original);
+      recycleImage(resized);
+      return saved;
+    });
+  }
+
+  bool resizeMany(progargsCommon::parameters_files const & params, std::vector<common::resize_target> const & sizes,
+                  progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!openResizable(input, params.input_file)) { return false; }
+    if (opts.stream) {
+      // Con --stream cada tamaño se genera por separado a partir de la entrada, sin cargarla
+      return std::ranges::all_of(sizes, [&](common::resize_target const & size) {
+        return streamResize(input, progargsCommon::sized_filename(params.output_file, size), size, opts);
+      });
+    }
+    return common::dispatch_sample(input.header().max_color, [&]<typename T>(T) {
+      ImageOf<T> original;
+      readImage(input, original);
+      common::pyramid_plan const plan = common::plan_pyramid({.width = original.width, .height = original.height},
+                                                             sizes);
+      std::vector<ImageOf<T>> levels(sizes.size());
+      std::atomic<bool> saved{true};
+      common::for_each_level(plan, opts.threads, [&](std::size_t level, unsigned int threads) {
+        ImageOf<T> const & parent = plan.parent[level] == sizes.size() ? original : levels[plan.parent[level]];
+        progargsCommon::options inner = opts;
+        inner.threads = threads;
+        levels[level] = resizeImage(parent, static_cast<int>(sizes[level].width),
+                                    static_cast<int>(sizes[level].height), inner);
+        if (!saveImage(levels[level], progargsCommon::sized_filename(params.output_file, sizes[level]))) {
+          saved = false;
+        }
+      });
+      recycleImage(original);
+      for (auto & level : levels) { recycleImage(level); }
+      return saved.load();
+    });
   }
 
-  void handle_maxlevel_optionAOS(std::vector<std::string> const &args, const progargsCommon::parameters_files& params) {
+  namespace {
+    // Abre la imagen de entrada de maxlevel y comprueba que es P6
+    bool openScaled(common::ImageInput & input, std::string const & filename) {
+      if (!input.open(filename)) {
+        std::cerr << "Error al abrir el fichero " << filename << '\n';
+        return false;
+      }
+      if (input.header().magic != "P6") {
+        std::cerr << "Error: formato de imagen no valido.\n";
+        return false;
+      }
+      return true;
+    }
+
+    // maxlevel de la imagen completa: se carga con el ancho de muestra de la entrada y se escribe
+    // con el que corresponde al nuevo máximo
+    bool imageMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                       common::rounding mode) {
+      common::ImageInput input;
+      if (!openScaled(input, params.input_file)) {
+        return false;
+      }
+      int const inputMax = input.header().max_color;
+      common::level_table const table(static_cast<unsigned int>(inputMax), newMaxValue, mode);
+      return common::dispatch_sample(inputMax, [&]<typename In>(In) {
+        ImageOf<In> image;
+        readImage(input, image);
+        return common::dispatch_sample(static_cast<int>(newMaxValue), [&]<typename Out>(Out) {
+          ImageOf<Out> result;
+          maxlevel(image, result, table);
+          bool const saved = saveImage(result, params.output_file);
+          recycleImage(image);
+          recycleImage(result);
+          return saved;
+        });
+      });
+    }
+  }  // namespace
+
+  bool handle_maxlevel_optionAOS(std::vector<std::string> const &args, const progargsCommon::parameters_files& params,
+                                 progargsCommon::options const & opts) {
     int newMaxValue = 0;
     try {
       newMaxValue = std::stoi(args[4]);
     } catch (const std::invalid_argument&) {
       std::cerr << "Error: El cuarto argumento debe ser entero.\n";
-      return;
+      return false;
     }
 
     if (newMaxValue < 0 || newMaxValue > progargsCommon::MAX_COLOR_VALUE_16BIT) {
       std::cerr << "Error: nuevo valor maximo entre 0 y " << progargsCommon::MAX_COLOR_VALUE_16BIT << ".\n";
-      return;
+      return false;
     }
 
-    Photo image;
-    if (!loadPhoto(image, params.input_file)) {
-      return;
+    if (opts.stream) {
+      if (!streamMaxlevel(params, static_cast<unsigned int>(newMaxValue), opts.rounding)) {
+        return false;
+      }
+      std::cout << "Imagen procesada con exito\n";
+      return true;
     }
 
-    maxlevel(image, static_cast<unsigned int>(newMaxValue));
-
-    if (!savePhoto(image, params.output_file)) {
-      return;
+    if (!imageMaxlevel(params, static_cast<unsigned int>(newMaxValue), opts.rounding)) {
+      return false;
     }
 
     std::cout << "Imagen procesada con exito\n";
+    return true;
   }
 
-  void process_parametersAOS(std::vector<std::string> const &args) {
+  bool streamMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                      common::rounding mode, std::size_t bandRows) {
+    common::ImageInput input;
+    if (!openScaled(input, params.input_file)) {
+      return false;
+    }
+    common::ImageOutput output;
+    if (!output.open(params.output_file)) {
+      std::cerr << "Error al abrir el fichero " << params.output_file << '\n';
+      return false;
+    }
+    try {
+      common::image_header header = input.header();
+      header.max_color             = static_cast<int>(newMaxValue);
+      common::write_ppm_header(output, header);
+
+      // Cada banda se carga en una imagen compacta reutilizada de pocas filas y se escala con maxlevel
+      int const inputMax = input.header().max_color;
+      common::level_table const table(static_cast<unsigned int>(inputMax), newMaxValue, mode);
+      common::dispatch_sample(inputMax, [&]<typename In>(In) {
+        common::dispatch_sample(header.max_color, [&]<typename Out>(Out) {
+          ImageOf<In> band;
+          ImageOf<Out> scaled;
+          common::stream_bands(input, output, [&](common::row_band const & rows, std::vector<uint8_t> & out) {
+            band.pixels.resize(rows.rows * header.width);
+            unpackInto(rows.data, band.pixels);
+            maxlevel(band, scaled, table);
+            out.resize(scaled.pixels.size() * common::CHANNELS * sizeof(Out));
+            common::pack_pixels<Out>(std::span<PixelOf<Out> const>(scaled.pixels), out);
+          }, bandRows);
+        });
+      });
+      output.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  bool process_parametersAOS(std::vector<std::string> const &args, progargsCommon::options const & opts) {
     int newMaxValue = 0;
     try {
       newMaxValue = std::stoi(args[4]);
     } catch (const std::invalid_argument&) {
-      std::cerr << "Error: Maxlevel invalido: " << args[4] << "\n";
-      exit(-1);
+      throw std::invalid_argument("Error: Maxlevel invalido: " + args[4]);
     }
 
     if (newMaxValue < 0 || newMaxValue > MAX_COLOR_VALUE_EXTENDED) {
-      std::cerr << "Error: Maxlevel invalido: " << newMaxValue << "\n";
-      exit(-1);
+      throw std::invalid_argument("Error: Maxlevel invalido: " + std::to_string(newMaxValue));
     }
 
     progargsCommon::parameters_files const params{.input_file=args[1], .output_file=args[2]};
-    handle_maxlevel_optionAOS(args, params);
+    return handle_maxlevel_optionAOS(args, params, opts);
   }
 
-  void callCutfreq(std::vector<std::string> const &args) {
+  bool callCutfreq(std::vector<std::string> const &args, progargsCommon::options const & opts) {
     const std::string& inputFile = args[1];
     const std::string& outputFile = args[2];
     int const numColorsToRemove = std::stoi(args[4]);
+    if (numColorsToRemove < 1) {
+      std::cerr << "Error: Operación no válida o número de colores a eliminar no válido.\n";
+      return false;
+    }
+
+    common::ImageInput input;
+    if (!input.open(inputFile)) {
+      std::cerr << "Error: No se pudo abrir el archivo de entrada. " << inputFile << '\n';
+      return false;
+    }
+    common::image_header const & header = input.header();
+    if (header.magic != "P6") {
+      std::cerr << "Error: Formato de archivo PPM no soportado.\n";
+      return false;
+    }
+    if (header.max_color > MAX_COLOR_VALUE_EXTENDED) {
+      std::cerr << "Error: Valor máximo no soportado: " << header.max_color << '\n';
+      return false;
+    }
 
-    std::size_t width = 0;
-    std::size_t height = 0;
-    std::vector<imgaos::Pixel> image;
-    image = readPPM(inputFile, width, height);
-    CutFreqParams params(image, {.width = width, .height = height}, numColorsToRemove);
-    std::unordered_map<imgaos::Pixel, int, imgaos::PixelHash> frequencyMap;
-    // Contar frecuencia de colores
-    frequencyMap = imgaos::countColorFrequencyWithParams(params);
-    std::vector<Pixel> colorsToRemove;
-    // Encontrar colores menos frecuentes
-    colorsToRemove = getLeastFrequentColors(frequencyMap, numColorsToRemove);
-    // Almacenar colores menos frecuentes en los parámetros antes de llamar a cutfreq
-    params.image = image;
-    // Reemplazo de colores
-    cutfreq(params);
-    // Escribir la imagen
-    writePPM(outputFile, image, width, height);
+    return common::dispatch_sample(header.max_color, [&]<typename T>(T) {
+      ImageOf<T> image;
+      readImage(input, image);
+      input.release(0, input.payload_size());  // Las páginas del fichero ya no hacen falta
+      // Reemplazo de los colores menos frecuentes
+      cutfreq(image, numColorsToRemove, opts.threads);
+      // Escribir la imagen procesada con el mismo maxval; saveImage ya informa del error
+      bool const saved = saveImage(image, outputFile);
+      recycleImage(image);
+      return saved;
+    });
   }
-}
 
+
+  template void readImage<uint8_t>(common::ImageInput const & input, ImageOf<uint8_t> & image);
+  template void readImage<uint16_t>(common::ImageInput const & input, ImageOf<uint16_t> & image);
+  template common::palette buildPalette<uint8_t>(ImageOf<uint8_t> const & image, unsigned int threads);
+  template common::palette buildPalette<uint16_t>(ImageOf<uint16_t> const & image, unsigned int threads);
+  template void maxlevel<uint8_t, uint8_t>(ImageOf<uint8_t> const & input, ImageOf<uint8_t> & output,
+                                           common::level_table const & table);
+  template void maxlevel<uint8_t, uint16_t>(ImageOf<uint8_t> const & input, ImageOf<uint16_t> & output,
+                                            common::level_table const & table);
+  template void maxlevel<uint16_t, uint8_t>(ImageOf<uint16_t> const & input, ImageOf<uint8_t> & output,
+                                            common::level_table const & table);
+  template void maxlevel<uint16_t, uint16_t>(ImageOf<uint16_t> const & input, ImageOf<uint16_t> & output,
+                                             common::level_table const & table);
+  template ImageOf<uint8_t> resizeImage<uint8_t>(ImageOf<uint8_t> const & original, int newWidth, int newHeight,
+                                                 progargsCommon::options const & opts);
+  template ImageOf<uint16_t> resizeImage<uint16_t>(ImageOf<uint16_t> const & original, int newWidth,
+                                                   int newHeight, progargsCommon::options const & opts);
+  template void cutfreq<uint8_t>(ImageOf<uint8_t> & image, int n, unsigned int threads);
+  template void cutfreq<uint16_t>(ImageOf<uint16_t> & image, int n, unsigned int threads);
+}
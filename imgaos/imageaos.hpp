@@ -3,7 +3,12 @@
 
 #include <cstdint>
 #include <map>
+#include <span>
 #include <string>
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/levels.hpp"
+#include "common/palette.hpp"
 #include "common/progargs.hpp"
 #include <vector>
 #include <unordered_map>
@@ -13,10 +18,6 @@ namespace imgaos{
     constexpr int MAX_COLOR_VALUE = 255;
 // Constante para el valor máximo de color extendido
     constexpr int MAX_COLOR_VALUE_EXTENDED = 65535;
-// Constantes para el grid
-    constexpr int GRID_SIZE = 8;
-    constexpr int RED_MULTIPLIER = 10000;
-    constexpr int GREEN_MULTIPLIER = 100;
   struct image_size {
     int width;
     int height;
@@ -61,16 +62,50 @@ namespace imgaos{
     std::vector<Pixel> pixels;
     };
 
+  // Píxel compacto con muestras de 8 o 16 bits: 3 o 6 bytes frente a los 12 de Pixel
+  template <typename T>
+  struct PixelOf {
+    T r, g, b;
+
+    bool operator== (PixelOf const & other) const = default;
+  };
+
+  // Imagen AOS compacta; el tipo de muestra (uint8_t o uint16_t) se elige al cargarla según su
+  // maxval con common::dispatch_sample
+  template <typename T>
+  struct ImageOf {
+    std::size_t width  = 0;
+    std::size_t height = 0;
+    int max_color      = 0;
+    std::vector<PixelOf<T>> pixels;
+  };
+
   bool loadPhoto(Photo& photo, const std::string& filename);
   bool savePhoto(const Photo& photo, const std::string& filename);
-  bool readHeader(std::ifstream& file, Photo& photo);
+  bool readHeader(common::ImageInput const & input, Photo& photo);
   template<typename T>
-  void readPixels(std::ifstream& file, Photo& photo);
-
-  void maxlevel(Photo& photo, unsigned int newMaxValue);
+  void readPixels(common::ImageInput const & input, Photo& photo);
+  // Desempaqueta photo.pixels.size() píxeles intercalados de tipo T desde data
+  template<typename T>
+  void unpackPixels(std::span<uint8_t const> data, Photo& photo);
 
-  // Función para comprimir una imagen
-  void compress(progargsCommon::parameters_files & params);
+  // Desempaqueta la carga útil P6 de input, cuyas muestras deben ser de tipo T, en image
+  template<typename T>
+  void readImage(common::ImageInput const & input, ImageOf<T> & image);
+
+  void maxlevel(Photo& photo, unsigned int newMaxValue, common::rounding mode = common::rounding::truncate);
+  // Aplica una tabla de maxlevel ya construida (reutilizable entre bandas de la misma imagen)
+  void maxlevel(Photo& photo, common::level_table const & table);
+  // maxlevel entre imágenes compactas: Out es el tipo de muestra que corresponde al nuevo máximo
+  template<typename In, typename Out>
+  void maxlevel(ImageOf<In> const & input, ImageOf<Out> & output, common::level_table const & table);
+
+  // Función para comprimir una imagen; false si no se puede leer la entrada o escribir la salida
+  bool compress(progargsCommon::parameters_files & params, progargsCommon::options const & opts = {});
+  // Función para reconstruir una imagen P6 a partir de un fichero C6
+  bool decompress(progargsCommon::parameters_files const & params);
+  // Función para desempaquetar la carga útil P6 en píxeles AOS
+  void readImagePixels(common::ImageInput const & input, std::vector<Pixel> & pixels);
   // Función para obtener los píxeles de una imagen
   void getPixels(std::string const & input_file, Image & picture);
 
@@ -82,14 +117,20 @@ namespace imgaos{
 
   void write_dataCPPM(Image & picture, std::map<Pixel, uint32_t> & colorlist ,std::string const & output_file);
 
-  struct PixelHash {
-    static constexpr std::size_t RED_SHIFT = 16;
-    static constexpr std::size_t GREEN_SHIFT = 8;
+  // Función para construir la paleta ordenada y el índice de cada píxel sin árboles intermedios
+  common::palette buildPalette(std::vector<Pixel> const & pixels, int max_color, unsigned int threads = 1);
+  template<typename T>
+  common::palette buildPalette(ImageOf<T> const & image, unsigned int threads = 1);
+  // Función para escribir el fichero C6 a partir de una paleta ya construida
+  void write_dataCPPM(Image const & picture, common::palette const & colors, std::string const & output_file,
+                      unsigned int threads = 1);
 
-    std::size_t operator()(const Pixel& pixel) const {
-      return (static_cast<std::size_t>(pixel.r) << RED_SHIFT) ^
-             (static_cast<std::size_t>(pixel.g) << GREEN_SHIFT) ^
-             static_cast<std::size_t>(pixel.b);
+  // Hash de píxel sobre la clave empaquetada de los tres canales
+  struct PixelHash {
+    template <typename P>
+    std::size_t operator()(const P& pixel) const {
+      return static_cast<std::size_t>(common::hash_color(common::pack_color(
+          static_cast<std::uint64_t>(pixel.r), static_cast<std::uint64_t>(pixel.g), static_cast<std::uint64_t>(pixel.b))));
     }
   };
 
@@ -106,20 +147,21 @@ namespace imgaos{
   };
 
   std::unordered_map<Pixel, int, PixelHash> countColorFrequencyWithParams(CutFreqParams const & params);
-  std::vector<Pixel> getLeastFrequentColors(std::unordered_map<Pixel, int, PixelHash> frequencyMap, int n);
+  std::vector<Pixel> getLeastFrequentColors(std::unordered_map<Pixel, int, PixelHash> const & frequencyMap, int n);
   Pixel findClosestColor(Pixel const & color,
                          std::vector<std::pair<Pixel, int>> const & colorFrequency,
                          std::unordered_set<Pixel, PixelHash> const & colorsToRemove);
   void cutfreq(CutFreqParams& params);
+  // cutfreq sobre una imagen compacta; lanza std::invalid_argument si n < 1. Con threads > 1 el
+  // histograma, la búsqueda de sustitutos y la sustitución se reparten entre hilos, con el mismo
+  // resultado que en secuencial
+  template<typename T>
+  void cutfreq(ImageOf<T> & image, int n, unsigned int threads = 1);
 
   // Declaraciones de las funciones para leer y escribir PPM
   std::vector<Pixel> readPPM(std::string const & filename, std::size_t & width, std::size_t & height);
   void writePPM(std::string const & filename, std::vector<Pixel> const & image, std::size_t width, std::size_t height);
 
-  // Nuevas funciones para la optimización con grid
-  std::unordered_map<int, std::vector<Pixel>> buildGrid(const std::vector<Pixel>& image, int gridSize);
-  Pixel findClosestColorOptimized(const Pixel& color, const std::unordered_map<int, std::vector<Pixel>>& grid, int gridSize);
-
   static constexpr int kMaxColorValue = 255;
   static constexpr int kMaxLineLength = 256;
 
@@ -147,12 +189,34 @@ namespace imgaos{
 
   std::vector<std::vector<Pixel>> resizeImage(std::vector<std::vector<Pixel>> const & original,
                                               int newWidth, int newHeight);
+  // resize sobre el búfer contiguo de una imagen compacta, con una vista por fila
+  template<typename T>
+  ImageOf<T> resizeImage(ImageOf<T> const & original, int newWidth, int newHeight,
+                         progargsCommon::options const & opts = {});
   int clamp(int value, int minValue, int maxValue);
-
-  void callCutfreq(std::vector<std::string> const &args);
-
-  void process_parametersAOS(std::vector<std::string> const &args);
-  void handle_maxlevel_optionAOS(std::vector<std::string> const &args, const progargsCommon::parameters_files& params);
+  // Redimensiona el fichero de entrada con muestras de 8 o 16 bits según su maxval, que se conserva.
+  // Usa el filtro de opts.filter y, con opts.threads > 1, reparte las bandas de filas entre hilos
+  bool resize(progargsCommon::parameters_files const & params, int newWidth, int newHeight,
+              progargsCommon::options const & opts = {});
+  // Varios tamaños con una sola lectura de la entrada: se escribe un fichero por tamaño
+  // (progargsCommon::sized_filename) y cada nivel sale del nivel mayor más próximo que lo contiene.
+  // Con opts.stream cada tamaño se genera por separado sin cargar la entrada
+  bool resizeMany(progargsCommon::parameters_files const & params, std::vector<common::resize_target> const & sizes,
+                  progargsCommon::options const & opts = {});
+
+  // cutfreq con el número de colores de args[4]; false y mensaje si no es positivo o si no se puede
+  // leer la entrada o escribir la salida
+  bool callCutfreq(std::vector<std::string> const &args, progargsCommon::options const & opts = {});
+
+  // maxlevel con el nuevo máximo de args[4]; lanza std::invalid_argument si no es un entero entre 0 y 65535
+  // y devuelve false si no se puede procesar la imagen
+  bool process_parametersAOS(std::vector<std::string> const &args, progargsCommon::options const & opts = {});
+  bool handle_maxlevel_optionAOS(std::vector<std::string> const &args, const progargsCommon::parameters_files& params,
+                                 progargsCommon::options const & opts = {});
+  // Función para aplicar maxlevel por bandas de filas, con memoria acotada e independiente del tamaño.
+  // bandRows fija las filas por banda (0: las que ocupen unos common::BAND_BYTES)
+  bool streamMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                      common::rounding mode = common::rounding::truncate, std::size_t bandRows = 0);
 }
 
 #endif
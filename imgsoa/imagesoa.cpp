@@ -1,15 +1,25 @@
 #include "imgsoa/imagesoa.hpp"
 
-#include "common/binario.hpp"
+#include "common/bands.hpp"
+#include "common/cppm.hpp"
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+#include "common/levels.hpp"
+#include "common/nearest.hpp"
+#include "common/palette.hpp"
+#include "common/parallel.hpp"
+#include "common/recycle.hpp"
+#include "common/resample.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <iostream>
-#include <limits>
 #include <map>
 #include <stdexcept>
 #include <string>
@@ -27,70 +37,111 @@ namespace imgsoa {
   blue(static_cast<std::vector<uint16_t>::size_type>(size.width * size.height)){ }
 
 
-  std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> getColors(Image& image) {
-    std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> color_map;
+  // Desempaqueta la carga útil P6 en tres planos de color, con muestras de 8 o 16 bits
+  template <typename T>
+  void readPlanes(common::ImageInput const & input, std::vector<T> & red, std::vector<T> & green,
+                  std::vector<T> & blue) {
+    common::image_header const & header = input.header();
+    auto const data  = input.payload(red.size() * common::CHANNELS * header.sample_size());
+    auto const store = [&](std::size_t i, auto r_val, auto g_val, auto b_val) {
+      red[i]   = static_cast<T>(r_val);
+      green[i] = static_cast<T>(g_val);
+      blue[i]  = static_cast<T>(b_val);
+    };
+    if (header.max_color <= MAX_COLOR_VALUE) {
+      common::unpack_rgb<uint8_t>(data, red.size(), store);
+    } else {
+      common::unpack_rgb<uint16_t>(data, red.size(), store);
+    }
+  }
 
-    for (std::size_t i = 0; i < image.red.size(); i++) {
-      std::tuple<uint16_t, uint16_t, uint16_t> const color = std::make_tuple(image.red[i], image.green[i], image.blue[i]);
+  // Desempaqueta muestras intercaladas de tipo T en los planos de image, ya dimensionados
+  template <typename T>
+  void unpackPlanes(std::span<uint8_t const> data, PlanesOf<T> & image) {
+    common::unpack_rgb<T>(data, image.r.size(), [&image](std::size_t i, T red, T green, T blue) {
+      image.r[i] = red;
+      image.g[i] = green;
+      image.b[i] = blue;
+    });
+  }
 
-      if (color_map.find(color) == color_map.end()) {
-        color_map[color] = 0;
-        ++image.n_colors;
-      }
-    }
+  common::palette buildPalette(Image const & image, unsigned int threads) {
+    return common::build_palette(image.red.size(), image.max_color, [&image](std::size_t i) {
+      return common::pack_color(image.red[i], image.green[i], image.blue[i]);
+    }, threads);
+  }
 
-    uint32_t indice = 0;
-    for (auto [color, index]:color_map) {
-      color_map[color] = indice;
-      ++indice;
-    }
+  template <typename T>
+  common::palette buildPalette(PlanesOf<T> const & image, unsigned int threads) {
+    return common::build_palette(image.r.size(), image.max_color, [&image](std::size_t i) {
+      return common::pack_color(image.r[i], image.g[i], image.b[i]);
+    }, threads);
+  }
 
-    return color_map;
+  template <typename T>
+  void readImage(common::ImageInput const & input, PlanesOf<T> & image) {
+    common::image_header const & header = input.header();
+    image.width     = header.width;
+    image.height    = header.height;
+    image.max_color = header.max_color;
+    common::size_buffer(image.r, header.pixel_count());
+    common::size_buffer(image.g, header.pixel_count());
+    common::size_buffer(image.b, header.pixel_count());
+    readPlanes(input, image.r, image.g, image.b);
   }
 
+  namespace {
+    // Devuelve los planos de una imagen que ya no se usa para la siguiente (modo batch)
+    template <typename T>
+    void recyclePlanes(PlanesOf<T> & image) {
+      common::recycle_buffer(std::move(image.r));
+      common::recycle_buffer(std::move(image.g));
+      common::recycle_buffer(std::move(image.b));
+    }
+  }  // namespace
 
+  std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> getColors(Image& image) {
+    // La paleta ya sale ordenada: cada color se inserta al final del mapa
+    common::palette const colors = buildPalette(image);
+    std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> color_map;
+    for (uint32_t indice = 0; indice < colors.colors.size(); ++indice) {
+      uint64_t const key = colors.colors[indice];
+      color_map.emplace_hint(color_map.end(),
+                             std::make_tuple(common::key_red(key), common::key_green(key), common::key_blue(key)),
+                             indice);
+    }
+    image.n_colors += static_cast<uint32_t>(colors.colors.size());
+    return color_map;
+  }
 
   void write_color_table(Image & image,
                   std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> & color_list,
                   std::string & filename) {
-    std::ofstream file(filename, std::ios::binary);
+    common::ImageOutput file;
 
-    if (!file.is_open()) {
+    if (!file.open(filename)) {
       std::cerr << "Error opening output file: " << filename << "\n";
       return;
     }
-    constexpr int limit1 = 255;
 
+    // Planos temporales con la paleta ordenada; 1 byte por muestra si max_color <= 255, si no 2
+    std::vector<uint16_t> red;
+    std::vector<uint16_t> green;
+    std::vector<uint16_t> blue;
     for (const auto & [color, index] : color_list) {
-      if (image.max_color <= limit1) {
-        // Access elements of the tuple using std::get
-        auto red = static_cast<uint8_t>(std::get<0>(color));
-        auto green = static_cast<uint8_t>(std::get<1>(color));
-        auto blue = static_cast<uint8_t>(std::get<2>(color));
-
-        binario::write_birary(file, red);
-        binario::write_birary(file, green);
-        binario::write_birary(file, blue);
-      } else {
-        // Handle the case when max_color > 255
-        uint16_t const red = std::get<0>(color);
-        uint16_t const green = std::get<1>(color);
-        uint16_t const blue = std::get<2>(color);
-
-        // Write color values to the file (2 bytes per color component)
-        binario::write_birary(file, red);
-        binario::write_birary(file, green);
-        binario::write_birary(file, blue);
-      }
+      red.push_back(std::get<0>(color));
+      green.push_back(std::get<1>(color));
+      blue.push_back(std::get<2>(color));
     }
+    common::write_planes(file, common::planes_view<uint16_t>{red, green, blue}, image.max_color);
   }
 
   void write_pixels(Image& image,
                     std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t>& color_list,
                     std::string& filename) {
-    std::ofstream file(filename, std::ios::binary);
+    common::ImageOutput file;
 
-    if (!file.is_open()) {
+    if (!file.open(filename)) {
       std::cerr << "Error opening output file: " << filename << "\n";
       return;
     }
@@ -103,176 +154,335 @@ namespace imgsoa {
 
       // Write the index corresponding to the pixel's color
       if (image.n_colors <= limit1) {
-        auto index = static_cast<uint8_t>(color_list[pixel_color]);
-        binario::write_birary(file, index);
+        file.write_value(static_cast<uint8_t>(color_list[pixel_color]));
       } else if (image.n_colors >= limit1 + 1 && image.n_colors <= limit2) {
-        auto index = static_cast<uint16_t>(color_list[pixel_color]);
-        binario::write_birary(file, index);
+        file.write_value(static_cast<uint16_t>(color_list[pixel_color]));
       } else {
-        auto index = color_list[pixel_color];
-        binario::write_birary(file, index);
+        file.write_value(color_list[pixel_color]);
+      }
+    }
+  }
+
+  namespace {
+    // Tabla de colores de la paleta como tres planos temporales, con muestras de 1 o 2 bytes
+    void writeColorTable(common::ImageOutput & file, common::palette const & colors, int max_color) {
+      std::vector<uint16_t> red(colors.colors.size());
+      std::vector<uint16_t> green(colors.colors.size());
+      std::vector<uint16_t> blue(colors.colors.size());
+      for (std::size_t i = 0; i < colors.colors.size(); ++i) {
+        red[i]   = common::key_red(colors.colors[i]);
+        green[i] = common::key_green(colors.colors[i]);
+        blue[i]  = common::key_blue(colors.colors[i]);
       }
+      common::write_planes(file, common::planes_view<uint16_t>{red, green, blue}, max_color);
     }
+  }  // namespace
+
+  void write_color_table(common::ImageOutput & file, Image const & image, common::palette const & colors) {
+    writeColorTable(file, colors, image.max_color);
   }
 
-  void compress(progargsCommon::parameters_files params) {
-    std::ifstream input(params.input_file, std::ios::binary);
-    std::ofstream output(params.output_file, std::ios::binary);
-    if (input.fail()) {
+  void write_pixels(common::ImageOutput & file, Image const & image, common::palette const & colors,
+                    unsigned int threads) {
+    common::write_indices(file, colors.indices, image.n_colors, threads);
+  }
+
+  bool compress(progargsCommon::parameters_files params, progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!input.open(params.input_file)) {
       std::cerr << "Error opening file " << params.input_file << '\n';
-      return;
+      return false;
     }
-    std::string idn;
-    int width = 0;
-    int height = 0;
-    int max_color = 0;
-    input >> idn >> width >> height >> max_color;
-    input.get();
-    if (strcmp(idn.c_str(), "P6")!=0) {
+    common::image_header const & header = input.header();
+    if (header.magic != "P6") {
       std::cerr << "Invalid file type, the file:"<<params.input_file << " must be in PPM format\n";
-      return;
+      return false;
     }
-    image_size const size_init(width, height);
-    Image image(size_init, max_color);
-    int const limit = 255;
-    for(std::size_t i = 0; i < image.red.size(); i++) {
-      if (image.max_color <= limit) {
-        image.red[i] = binario::read_binary<uint8_t>(input);
-        image.green[i] = binario::read_binary<uint8_t>(input);
-        image.blue[i] = binario::read_binary<uint8_t>(input);
-      } else {
-        image.red[i] = binario::read_binary<uint16_t>(input);
-        image.green[i] = binario::read_binary<uint16_t>(input);
-        image.blue[i] = binario::read_binary<uint16_t>(input);
+    // Planos de 1 byte por muestra si maxval <= 255 y de 2 si no
+    return common::dispatch_sample(header.max_color, [&]<typename T>(T) {
+      PlanesOf<T> image;
+      readImage(input, image);
+      common::palette const color_list = buildPalette(image, opts.threads);
+
+      // Un único descriptor: cabecera, paleta e índices se escriben en orden a través del mismo búfer
+      common::ImageOutput output;
+      if (!output.open(params.output_file)) {
+        std::cerr << "Error opening output file: " << params.output_file << "\n";
+        return false;
+      }
+      try {
+        common::write_cppm_header(output, {.magic = "C6", .width = header.width, .height = header.height,
+                                           .max_color = image.max_color}, color_list.colors.size());
+        writeColorTable(output, color_list, image.max_color);
+        common::write_indices(output, color_list.indices, color_list.colors.size(), opts.threads);
+        output.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
       }
+      recyclePlanes(image);
+      return true;
+    });
+  }
+
+  bool decompress(progargsCommon::parameters_files const & params) {
+    common::ImageInput input;
+    if (!input.open(params.input_file)) {
+      std::cerr << "Error opening file " << params.input_file << '\n';
+      return false;
     }
-    std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t> color_list = getColors(image);
-    output<< "C6"<< " " << image.size.width << " " << image.size.height << " " << image.max_color << " "<< image.n_colors << "\n";
-    write_color_table(image, color_list, params.output_file);
-    write_pixels(image, color_list, params.output_file);
+    if (input.header().magic != "C6") {
+      std::cerr << "Invalid file type, the file:" << params.input_file << " must be in CPPM format\n";
+      return false;
+    }
+    common::ImageOutput output;
+    if (!output.open(params.output_file)) {
+      std::cerr << "Error opening output file: " << params.output_file << '\n';
+      return false;
+    }
+    try {
+      common::decompress_cppm(input, output);
+      output.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
+    }
+    return true;
   }
 
+  namespace {
+    // Escribe unos planos con muestras de tipo T (Picture o PlanesOf<T>) como P6 con max_color
+    template <typename I>
+    bool savePlanes(std::string const & filename, I const & image, int max_color) {
+      using Sample = typename decltype(image.r)::value_type;
+      common::ImageOutput file;
+      if (!file.open(filename)) {
+        std::cerr << "Error: Could not open file " << filename << " for writing." << '\n';
+        return false;
+      }
+
+      try {
+        common::write_ppm_header(file, {.magic     = "P6",
+                                        .width     = static_cast<std::size_t>(image.width),
+                                        .height    = static_cast<std::size_t>(image.height),
+                                        .max_color = max_color});
+        common::write_planes(file, common::planes_view<Sample>{image.r, image.g, image.b}, max_color);
+        file.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      return true;
+    }
+
+    // Interpolación bilineal de un píxel de unos planos de cualquier tipo de muestra
+    template <typename I, typename T>
+    void interpolateAt(I const & original, double xcoord, double ycoord, std::array<T, 3> & color) {
+      auto getClampedIndex = [](double value, std::size_t max) {
+        return std::clamp(static_cast<std::size_t>(value), 0UL, max);
+      };
+
+      auto const width = static_cast<std::size_t>(original.width);
+      std::size_t const xl_ = getClampedIndex(std::floor(xcoord), width - 1);
+      std::size_t const xh_ = getClampedIndex(std::ceil(xcoord), width - 1);
+      std::size_t const yl_ = getClampedIndex(std::floor(ycoord), static_cast<std::size_t>(original.height) - 1);
+      std::size_t const yh_ = getClampedIndex(std::ceil(ycoord), static_cast<std::size_t>(original.height) - 1);
+
+      std::array<std::size_t, 4> const index = {(yl_ * width) + xl_, (yl_ * width) + xh_, (yh_ * width) + xl_,
+                                                (yh_ * width) + xh_};
+      double const xWeight = xcoord - static_cast<double>(xl_);
+      double const yWeight = ycoord - static_cast<double>(yl_);
+      std::array<double, 4> const weight = {(1 - xWeight) * (1 - yWeight), xWeight * (1 - yWeight),
+                                            (1 - xWeight) * yWeight, xWeight * yWeight};
+
+      auto interpolate = [&](auto const & plane) {
+        return static_cast<T>((weight[0] * plane[index[0]]) + (weight[1] * plane[index[1]]) +
+                              (weight[2] * plane[index[2]]) + (weight[3] * plane[index[3]]));
+      };
+      color = {interpolate(original.r), interpolate(original.g), interpolate(original.b)};
+    }
+
+    // Rellena resized, que ya trae su ancho y alto, redimensionando cada plano por separado con
+    // muestras saturadas a max_color
+    template <typename I>
+    void resizePlanes(I const & original, I & resized, int max_color, common::resize_settings settings = {}) {
+      using Sample = typename decltype(resized.r)::value_type;
+      auto const source = [&](std::vector<Sample> const & plane) {
+        return common::sample_grid<Sample const>{.data     = plane,
+                                                 .width    = static_cast<std::size_t>(original.width),
+                                                 .height   = static_cast<std::size_t>(original.height),
+                                                 .channels = 1};
+      };
+      auto const target = [&](std::vector<Sample> & plane) {
+        common::size_buffer(plane, static_cast<std::size_t>(resized.width) * static_cast<std::size_t>(resized.height));
+        return common::sample_grid<Sample>{.data     = plane,
+                                           .width    = static_cast<std::size_t>(resized.width),
+                                           .height   = static_cast<std::size_t>(resized.height),
+                                           .channels = 1};
+      };
+      common::resample<Sample>(source(original.r), target(resized.r), max_color, settings);
+      common::resample<Sample>(source(original.g), target(resized.g), max_color, settings);
+      common::resample<Sample>(source(original.b), target(resized.b), max_color, settings);
+    }
+  }  // namespace
+
   bool loadPPM(std::string const & filename, Picture & image) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
+  common::ImageInput input;
+  if (!input.open(filename)) {
     std::cerr << "Error: Could not open file " << filename << '\n';
     return false;
   }
 
-  std::string header;
-  file >> header;
-  if (header != "P6") {
-    std::cerr << "Error: Unsupported PPM format (" << header << ")" << '\n';
+  common::image_header const & header = input.header();
+  if (header.magic != "P6") {
+    std::cerr << "Error: Unsupported PPM format (" << header.magic << ")" << '\n';
     return false;
   }
 
-  file >> image.width >> image.height;
-  int maxColorValue = 0;
-  file >> maxColorValue;
-  file.get();
-
-  image.r.resize(static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height));
-  image.g.resize(static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height));
-  image.b.resize(static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height));
-
-  for (std::size_t i = 0; i < image.r.size(); ++i) {
-    image.r[i] = binario::read_binary<uint8_t>(file);
-    image.g[i] = binario::read_binary<uint8_t>(file);
-    image.b[i] = binario::read_binary<uint8_t>(file);
-  }
+  image.width  = static_cast<int>(header.width);
+  image.height = static_cast<int>(header.height);
+  image.r.resize(header.pixel_count());
+  image.g.resize(header.pixel_count());
+  image.b.resize(header.pixel_count());
+
+  // La carga útil se interpreta siempre como muestras de 8 bits
+  auto const data = input.payload(header.pixel_count() * common::CHANNELS);
+  common::unpack_rgb<uint8_t>(data, header.pixel_count(),
+                              [&image](std::size_t i, uint8_t red, uint8_t green, uint8_t blue) {
+    image.r[i] = red;
+    image.g[i] = green;
+    image.b[i] = blue;
+  });
 
   return true;
 }
 
 bool savePPM(std::string const & filename, Picture const & image) {
-  std::ofstream file(filename, std::ios::binary);
-  if (!file) {
-    std::cerr << "Error: Could not open file " << filename << " for writing." << '\n';
-    return false;
-  }
-
-  file << "P6\n" << image.width << " " << image.height << "\n255\n";
-
-  for (std::size_t i = 0; i < image.r.size(); ++i) {
-    binario::write_birary(file, image.r[i]);
-    binario::write_birary(file, image.g[i]);
-    binario::write_birary(file, image.b[i]);
-  }
-
-  return true;
+  return savePlanes(filename, image, MAX_COLOR_VALUE);
 }
 
 void bilinearInterpolate(const Picture& original, double xcoord, double ycoord, Pixel& color) {
-  auto getClampedIndex = [](double value, std::size_t max) {
-    return std::clamp(static_cast<std::size_t>(value), 0UL, max);
-  };
-
-  auto interpolate = [](double w1_, double w2_, double w3_, double w4_, uint8_t c1_, uint8_t c2_,
-                        uint8_t c3_, uint8_t c4_) {
-    return static_cast<uint8_t>((w1_ * c1_) + (w2_ * c2_) + (w3_ * c3_) + (w4_ * c4_));
-  };
-
-  std::size_t const xl_ = getClampedIndex(std::floor(xcoord), static_cast<size_t>(original.width - 1));
-  std::size_t const xh_ = getClampedIndex(std::ceil(xcoord), static_cast<size_t>(original.width - 1));
-  std::size_t const yl_ = getClampedIndex(std::floor(ycoord), static_cast<size_t>(original.height - 1));
-  std::size_t const yh_ = getClampedIndex(std::ceil(ycoord), static_cast<size_t>(original.height - 1));
-
-  std::size_t const idx1 = (yl_ * static_cast<size_t>(original.width)) + xl_;
-  std::size_t const idx2 = (yl_ * static_cast<size_t>(original.width)) + xh_;
-  std::size_t const idx3 = (yh_ * static_cast<size_t>(original.width)) + xl_;
-  std::size_t const idx4 = (yh_ * static_cast<size_t>(original.width)) + xh_;
-
-  double const xWeight = xcoord - static_cast<double>(xl_);
-  double const yWeight = ycoord - static_cast<double>(yl_);
-
-  color.red = interpolate((1 - xWeight) * (1 - yWeight), xWeight * (1 - yWeight),
-                            (1 - xWeight) * yWeight, xWeight * yWeight,
-                            original.r[idx1], original.r[idx2], original.r[idx3], original.r[idx4]);
-  color.green = interpolate((1 - xWeight) * (1 - yWeight), xWeight * (1 - yWeight),
-                            (1 - xWeight) * yWeight, xWeight * yWeight,
-                            original.g[idx1], original.g[idx2], original.g[idx3], original.g[idx4]);
-  color.blue = interpolate((1 - xWeight) * (1 - yWeight), xWeight * (1 - yWeight),
-                            (1 - xWeight) * yWeight, xWeight * yWeight,
-                            original.b[idx1], original.b[idx2], original.b[idx3], original.b[idx4]);
+  std::array<uint8_t, 3> sample{};
+  interpolateAt(original, xcoord, ycoord, sample);
+  color = {.red = sample[0], .green = sample[1], .blue = sample[2]};
 }
 
 Picture resizeImage(Picture const & original, int newWidth, int newHeight) {
   Picture resized;
   resized.width  = newWidth;
   resized.height = newHeight;
-  resized.r.resize(static_cast<std::size_t>(newWidth) * static_cast<std::size_t>(newHeight));
-  resized.g.resize(static_cast<std::size_t>(newWidth) * static_cast<std::size_t>(newHeight));
-  resized.b.resize(static_cast<std::size_t>(newWidth) * static_cast<std::size_t>(newHeight));
-
-  for (std::size_t y_ = 0; y_ < static_cast<std::size_t>(newHeight); ++y_) {
-    for (std::size_t x_ = 0; x_ < static_cast<std::size_t>(newWidth); ++x_) {
-      auto const originalX = static_cast<double>(x_) * (static_cast<double>(original.width - 1) /
-                                                        static_cast<double>(newWidth - 1));
-      auto const originalY = static_cast<double>(y_) * (static_cast<double>(original.height - 1) /
-                                                        static_cast<double>(newHeight - 1));
+  resizePlanes(original, resized, MAX_COLOR_VALUE);
+  return resized;
+}
 
-      Pixel color{};
-      bilinearInterpolate(original, originalX, originalY, color);
+  template <typename T>
+  PlanesOf<T> resizeImage(PlanesOf<T> const & original, int newWidth, int newHeight,
+                          progargsCommon::options const & opts) {
+    PlanesOf<T> resized;
+    resized.width     = static_cast<std::size_t>(newWidth);
+    resized.height    = static_cast<std::size_t>(newHeight);
+    resized.max_color = original.max_color;
+    resizePlanes(original, resized, original.max_color, {.filter = opts.filter, .threads = opts.threads});
+    return resized;
+  }
 
-      std::size_t const idx = (y_ * static_cast<std::size_t>(newWidth)) +
-                              x_;
-      resized.r[idx] = color.red;
-      resized.g[idx] = color.green;
-      resized.b[idx] = color.blue;
+  namespace {
+    // Abre la imagen de entrada de resize y comprueba que es P6
+    bool openResizable(common::ImageInput & input, std::string const & filename) {
+      if (!input.open(filename)) {
+        std::cerr << "Error: Could not open file " << filename << '\n';
+        return false;
+      }
+      if (input.header().magic != "P6") {
+        std::cerr << "Error: Unsupported PPM format (" << input.header().magic << ")" << '\n';
+        return false;
+      }
+      return true;
     }
+
+    // resize --stream: las filas de destino se escriben según salen, sin cargar la imagen
+    bool streamResize(common::ImageInput const & input, std::string const & filename, common::resize_target target,
+                      progargsCommon::options const & opts) {
+      if (opts.filter != common::resize_filter::bilinear) {
+        std::cerr << "Error: --stream only supports the bilinear filter" << '\n';
+        return false;
+      }
+      common::ImageOutput output;
+      if (!output.open(filename)) {
+        std::cerr << "Error: Could not open file " << filename << " for writing." << '\n';
+        return false;
+      }
+      try {
+        common::stream_resize(input, output, target);
+        output.close();
+      } catch (std::runtime_error const & error) {
+        std::cerr << error.what() << '\n';
+        return false;
+      }
+      return true;
+    }
+  }  // namespace
+
+  bool resize(progargsCommon::parameters_files const & params, int newWidth, int newHeight,
+              progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!openResizable(input, params.input_file)) { return false; }
+    if (opts.stream) {
+      return streamResize(input, params.output_file,
+                          {.width  = static_cast<std::size_t>(newWidth),
+                           .height = static_cast<std::size_t>(newHeight)}, opts);
+    }
+    return common::dispatch_sample(input.header().max_color, [&]<typename T>(T) {
+      PlanesOf<T> original;
+      readImage(input, original);
+      PlanesOf<T> resized = resizeImage(original, newWidth, newHeight, opts);
+      bool const saved    = savePlanes(params.output_file, resized, resized.max_color);
+      recyclePlanes(original);
+      recyclePlanes(resized);
+      return saved;
+    });
   }
 
-  return resized;
-}
+  bool resizeMany(progargsCommon::parameters_files const & params, std::vector<common::resize_target> const & sizes,
+                  progargsCommon::options const & opts) {
+    common::ImageInput input;
+    if (!openResizable(input, params.input_file)) { return false; }
+    if (opts.stream) {
+      // Con --stream cada tamaño se genera por separado a partir de la entrada, sin cargarla
+      return std::ranges::all_of(sizes, [&](common::resize_target const & size) {
+        return streamResize(input, progargsCommon::sized_filename(params.output_file, size), size, opts);
+      });
+    }
+    return common::dispatch_sample(input.header().max_color, [&]<typename T>(T) {
+      PlanesOf<T> original;
+      readImage(input, original);
+      common::pyramid_plan const plan = common::plan_pyramid({.width = original.width, .height = original.height},
+                                                             sizes);
+      std::vector<PlanesOf<T>> levels(sizes.size());
+      std::atomic<bool> saved{true};
+      common::for_each_level(plan, opts.threads, [&](std::size_t level, unsigned int threads) {
+        PlanesOf<T> const & parent = plan.parent[level] == sizes.size() ? original : levels[plan.parent[level]];
+        progargsCommon::options inner = opts;
+        inner.threads = threads;
+        levels[level] = resizeImage(parent, static_cast<int>(sizes[level].width),
+                                    static_cast<int>(sizes[level].height), inner);
+        std::string const output = progargsCommon::sized_filename(params.output_file, sizes[level]);
+        if (!savePlanes(output, levels[level], levels[level].max_color)) { saved = false; }
+      });
+      recyclePlanes(original);
+      for (auto & level : levels) { recyclePlanes(level); }
+      return saved.load();
+    });
+  }
 
   bool loadPhoto(const std::string& filename, Photo& photo) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
+    common::ImageInput input;
+    if (!input.open(filename)) {
       std::cerr << "Error opening file: " << filename << '\n';
       return false;
     }
 
-    if (!readHeader(file, photo)) {
+    if (!readHeader(input, photo)) {
       return false;
     }
 
@@ -282,17 +492,20 @@ Picture resizeImage(Picture const & original, int newWidth, int newHeight) {
     photo.blue.resize(pixelCount);
 
     if (photo.maxColorValue <= MAX_COLOR_VALUE_8BIT) {
-      readPixels<unsigned char>(file, pixelCount, photo);
+      readPixels<unsigned char>(input, pixelCount, photo);
     } else {
-      readPixels<unsigned short>(file, pixelCount, photo);
+      readPixels<unsigned short>(input, pixelCount, photo);
     }
 
     return true;
   }
 
-  bool readHeader(std::ifstream& file, Photo& photo) {
-    file >> photo.magicNumber >> photo.width >> photo.height >> photo.maxColorValue;
-    file.ignore(1); // Ignore the newline character after maxColorValue
+  bool readHeader(common::ImageInput const & input, Photo& photo) {
+    common::image_header const & header = input.header();
+    photo.magicNumber   = header.magic;
+    photo.width         = static_cast<int>(header.width);
+    photo.height        = static_cast<int>(header.height);
+    photo.maxColorValue = static_cast<unsigned int>(header.max_color);
 
     if (photo.magicNumber != "P6") {
       std::cerr << "Error: Unsupported file format.\n";
@@ -302,56 +515,112 @@ Picture resizeImage(Picture const & original, int newWidth, int newHeight) {
   }
 
   template<typename T>
-  void readPixels(std::ifstream& file, size_t pixelCount, Photo &photo) {
-    for (size_t i = 0; i < pixelCount; ++i) {
-      photo.red[i] = binario::read_binary<T>(file);
-      photo.green[i] = binario::read_binary<T>(file);
-      photo.blue[i] = binario::read_binary<T>(file);
-    }
+  void readPixels(common::ImageInput const & input, size_t pixelCount, Photo &photo) {
+    unpackPixels<T>(input.payload(pixelCount * common::CHANNELS * sizeof(T)), pixelCount, photo);
+  }
+
+  template<typename T>
+  void unpackPixels(std::span<uint8_t const> data, size_t pixelCount, Photo &photo) {
+    common::unpack_rgb<T>(data, pixelCount, [&photo](std::size_t i, T red, T green, T blue) {
+      photo.red[i]   = red;
+      photo.green[i] = green;
+      photo.blue[i]  = blue;
+    });
   }
 
   bool savePhoto(const std::string& filename, const Photo& photo) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) {
+    common::ImageOutput file;
+    if (!file.open(filename)) {
       std::cerr << "Error opening file: " << filename << '\n';
       return false;
     }
 
-    file << photo.magicNumber << "\n" << photo.width << " " << photo.height << "\n" << photo.maxColorValue << "\n";
-
-    size_t const pixelCount = static_cast<size_t>(photo.width) * static_cast<size_t>(photo.height);
-    if (photo.maxColorValue <= MAX_COLOR_VALUE_8BIT) {
-      for (size_t i = 0; i < pixelCount; ++i) {
-        binario::write_birary(file, static_cast<unsigned char>(photo.red[i]));
-        binario::write_birary(file, static_cast<unsigned char>(photo.green[i]));
-        binario::write_birary(file, static_cast<unsigned char>(photo.blue[i]));
-      }
-    } else {
-      for (size_t i = 0; i < pixelCount; ++i) {
-        binario::write_birary(file, static_cast<unsigned short>(photo.red[i]));
-        binario::write_birary(file, static_cast<unsigned short>(photo.green[i]));
-        binario::write_birary(file, static_cast<unsigned short>(photo.blue[i]));
-      }
+    try {
+      auto const max_color = static_cast<int>(photo.maxColorValue);
+      common::write_ppm_header(file, {.magic     = photo.magicNumber,
+                                      .width     = static_cast<std::size_t>(photo.width),
+                                      .height    = static_cast<std::size_t>(photo.height),
+                                      .max_color = max_color});
+      common::write_planes(file, common::planes_view<unsigned int>{photo.red, photo.green, photo.blue},
+                           max_color);
+      file.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
     }
 
     return true;
   }
 
-  void maxlevel(Photo& photo, unsigned int newMaxValue) {
-    double const scaleFactor = static_cast<double>(newMaxValue) / photo.maxColorValue;
-    for (size_t i = 0; i < photo.red.size(); ++i) {
-      photo.red[i] = static_cast<unsigned int>(photo.red[i] * scaleFactor);
-      photo.green[i] = static_cast<unsigned int>(photo.green[i] * scaleFactor);
-      photo.blue[i] = static_cast<unsigned int>(photo.blue[i] * scaleFactor);
-    }
-    photo.maxColorValue = newMaxValue;
+  void maxlevel(Photo& photo, unsigned int newMaxValue, common::rounding mode) {
+    maxlevel(photo, common::level_table(photo.maxColorValue, newMaxValue, mode));
+  }
+
+  void maxlevel(Photo& photo, common::level_table const & table) {
+    table.apply(photo.red);
+    table.apply(photo.green);
+    table.apply(photo.blue);
+    photo.maxColorValue = table.new_max();
+  }
+
+  template <typename In, typename Out>
+  void maxlevel(PlanesOf<In> const & input, PlanesOf<Out> & output, common::level_table const & table) {
+    output.width     = input.width;
+    output.height    = input.height;
+    output.max_color = static_cast<int>(table.new_max());
+    common::size_buffer(output.r, input.r.size());
+    common::size_buffer(output.g, input.g.size());
+    common::size_buffer(output.b, input.b.size());
+    table.apply(std::span<In const>(input.r), std::span<Out>(output.r));
+    table.apply(std::span<In const>(input.g), std::span<Out>(output.g));
+    table.apply(std::span<In const>(input.b), std::span<Out>(output.b));
   }
 
-  void handle_maxlevel_optionSOA(std::vector<std::string> const &args, const progargsCommon::parameters_files& params) {
+  namespace {
+    // Abre la imagen de entrada de maxlevel y comprueba que es P6
+    bool openScaled(common::ImageInput & input, std::string const & filename) {
+      if (!input.open(filename)) {
+        std::cerr << "Error opening file: " << filename << '\n';
+        return false;
+      }
+      if (input.header().magic != "P6") {
+        std::cerr << "Error: Unsupported file format.\n";
+        return false;
+      }
+      return true;
+    }
+
+    // maxlevel de la imagen completa: se carga con el ancho de muestra de la entrada y se escribe
+    // con el que corresponde al nuevo máximo
+    bool imageMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                       common::rounding mode) {
+      common::ImageInput input;
+      if (!openScaled(input, params.input_file)) {
+        return false;
+      }
+      int const inputMax = input.header().max_color;
+      common::level_table const table(static_cast<unsigned int>(inputMax), newMaxValue, mode);
+      return common::dispatch_sample(inputMax, [&]<typename In>(In) {
+        PlanesOf<In> image;
+        readImage(input, image);
+        return common::dispatch_sample(static_cast<int>(newMaxValue), [&]<typename Out>(Out) {
+          PlanesOf<Out> result;
+          maxlevel(image, result, table);
+          bool const saved = savePlanes(params.output_file, result, result.max_color);
+          recyclePlanes(image);
+          recyclePlanes(result);
+          return saved;
+        });
+      });
+    }
+  }  // namespace
+
+  bool handle_maxlevel_optionSOA(std::vector<std::string> const &args, const progargsCommon::parameters_files& params,
+                                 progargsCommon::options const & opts) {
         size_t const size =5;
       if (args.size() != size) {
       std::cerr << "Error: Invalid number of extra arguments for maxlevel: " << args.size() - 4 << '\n';
-      return;
+      return false;
     }
 
     int newMaxValue = 0;
@@ -359,40 +628,86 @@ Picture resizeImage(Picture const & original, int newWidth, int newHeight) {
       newMaxValue = std::stoi(args[4]);
     } catch (const std::invalid_argument&) {
       std::cerr << "Error: The fourth argument must be an integer.\n";
-      return;
+      return false;
     }
 
     if (newMaxValue < 0 || newMaxValue > progargsCommon::MAX_COLOR_VALUE_16BIT) {
       std::cerr << "Error: The new max value must be between 0 and " << progargsCommon::MAX_COLOR_VALUE_16BIT << ".\n";
-      return;
+      return false;
     }
 
-    Photo photo;
-    if (!loadPhoto(params.input_file, photo)) {
-      return;
+    if (opts.stream) {
+      if (!streamMaxlevel(params, static_cast<unsigned int>(newMaxValue), opts.rounding)) {
+        return false;
+      }
+      std::cout << "Image processing completed successfully.\n";
+      return true;
     }
 
-    maxlevel(photo, static_cast<unsigned int>(newMaxValue));
-
-    if (!savePhoto(params.output_file, photo)) {
-      return;
+    if (!imageMaxlevel(params, static_cast<unsigned int>(newMaxValue), opts.rounding)) {
+      return false;
     }
 
     std::cout << "Image processing completed successfully.\n";
+    return true;
   }
 
-  void process_parametersSOA(std::vector<std::string> const &args) {
+  bool streamMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                      common::rounding mode, std::size_t bandRows) {
+    common::ImageInput input;
+    if (!openScaled(input, params.input_file)) {
+      return false;
+    }
+    common::ImageOutput output;
+    if (!output.open(params.output_file)) {
+      std::cerr << "Error opening file: " << params.output_file << '\n';
+      return false;
+    }
+    try {
+      common::image_header header = input.header();
+      header.max_color             = static_cast<int>(newMaxValue);
+      common::write_ppm_header(output, header);
+
+      // Los planos compactos de la banda se reutilizan; solo crecen hasta el tamaño de una banda
+      int const inputMax = input.header().max_color;
+      common::level_table const table(static_cast<unsigned int>(inputMax), newMaxValue, mode);
+      common::dispatch_sample(inputMax, [&]<typename In>(In) {
+        common::dispatch_sample(header.max_color, [&]<typename Out>(Out) {
+          PlanesOf<In> band;
+          PlanesOf<Out> scaled;
+          common::stream_bands(input, output, [&](common::row_band const & rows, std::vector<uint8_t> & out) {
+            size_t const count = rows.rows * header.width;
+            band.r.resize(count);
+            band.g.resize(count);
+            band.b.resize(count);
+            unpackPlanes(rows.data, band);
+            maxlevel(band, scaled, table);
+            out.resize(count * common::CHANNELS * sizeof(Out));
+            common::pack_planes<Out>(common::planes_view<Out>{scaled.r, scaled.g, scaled.b}, 0, out);
+          }, bandRows);
+        });
+      });
+      output.close();
+    } catch (std::runtime_error const & error) {
+      std::cerr << error.what() << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  bool process_parametersSOA(std::vector<std::string> const &args, progargsCommon::options const & opts) {
     if (args.size() < 4) {
       std::cerr << "Usage: <input_file> <output_file> <option> [<value>]\n";
-      return;
+      return false;
     }
 
     progargsCommon::parameters_files const params{.input_file=args[1], .output_file=args[2]};
     const std::string& option = args[3];
 
     if (option == "maxlevel") {
-      handle_maxlevel_optionSOA(args, params);
+      return handle_maxlevel_optionSOA(args, params, opts);
     }
+    return false;
   }
 
   void initializeImageSOA(ImageSOA &image, std::size_t width, std::size_t height) {
@@ -405,191 +720,176 @@ Picture resizeImage(Picture const & original, int newWidth, int newHeight) {
 
 // Lee una imagen PPM y la almacena en la estructura ImageSOA
 ImageSOA readPPM(const std::string &filename, std::size_t &width, std::size_t &height) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
+  common::ImageInput input;
+  if (!input.open(filename)) {
     throw std::runtime_error("Error: No se pudo abrir el archivo de entrada. " + filename);
   }
 
-  std::string header;
-  file >> header;  // Leer el encabezado del archivo
-  if (header != "P6") {
+  common::image_header const & header = input.header();
+  if (header.magic != "P6") {
     throw std::runtime_error("Error: Formato de archivo PPM no soportado.");
   }
+  if (header.max_color > progargsCommon::MAX_COLOR_VALUE_16BIT) {
+    throw std::runtime_error("Error: Valor máximo no soportado: " + std::to_string(header.max_color));
+  }
 
-  file >> width >> height; // Leer el ancho y alto de la imagen
-  int max_val = 0;
-  file >> max_val; // Leer el valor máximo de color
-  file.ignore(1);  // Ignorar el carácter de nueva línea
-
+  width  = header.width;
+  height = header.height;
   ImageSOA image;
   initializeImageSOA(image, width, height);
-
-  if (max_val <= MAX_COLOR_VALUE) {
-    // Leer los píxeles si el valor máximo de color es menor o igual a 255
-    for (std::size_t i = 0; i < width * height; ++i) {
-      image.r[i] = binario::read_binary<unsigned char>(file);
-      image.g[i] = binario::read_binary<unsigned char>(file);
-      image.b[i] = binario::read_binary<unsigned char>(file);
-    }
-  } else if (max_val <= static_cast<int>(MAX_COLOR_VALUE_8BIT)) {
-    // Leer los píxeles si el valor máximo de color es menor o igual a 65535
-    for (std::size_t i = 0; i < width * height; ++i) {
-      image.r[i] = binario::read_binary<uint16_t>(file);
-      image.g[i] = binario::read_binary<uint16_t>(file);
-      image.b[i] = binario::read_binary<uint16_t>(file);
-    }
-  } else {
-    throw std::runtime_error("Error: Valor máximo no soportado: " + std::to_string(max_val));
-  }
-
+  readPlanes(input, image.r, image.g, image.b);
   return image;
 }
 
 // Escribe una imagen PPM desde la estructura ImageSOA
 void writePPM(const std::string & filename, const ImageSOA & image, std::size_t width, std::size_t height) {
-  std::ofstream file(filename, std::ios::binary);
-  if (!file) {
+  common::ImageOutput file;
+  if (!file.open(filename)) {
     throw std::runtime_error("Error: No se pudo abrir el archivo de salida. " + filename);
   }
 
-  file << "P6\n" << width << " " << height << "\n" << MAX_COLOR_VALUE << "\n";
-  for (std::size_t i = 0; i < width * height; ++i) {
-    binario::write_birary(file, static_cast<unsigned char>(image.r[i]));
-    binario::write_birary(file, static_cast<unsigned char>(image.g[i]));
-    binario::write_birary(file, static_cast<unsigned char>(image.b[i]));
-  }
+  common::write_ppm_header(file, {.magic = "P6", .width = width, .height = height, .max_color = MAX_COLOR_VALUE});
+  common::write_planes(file, common::planes_view<int>{image.r, image.g, image.b}, MAX_COLOR_VALUE);
+  file.close();
 }
 
-// Función para contar la frecuencia de colores en la imagen
-std::unordered_map<std::tuple<int, int, int>, int, TupleHash> countColorFrequencySOA(CutFreqParamsSOA const & params) {
-  std::unordered_map<std::tuple<int, int, int>, int, TupleHash> frequencyMap;
-
-  for (std::size_t i = 0; i < params.image->width * params.image->height; ++i) {
-    auto color = std::make_tuple(params.image->r[i], params.image->g[i], params.image->b[i]);
-    frequencyMap[color]++;
+namespace {
+  // Versiones genéricas de cutfreq: I es ImageSOA o PlanesOf<T>; los colores se manejan como tuplas
+  template <typename I>
+  common::color_histogram countFrequency(I const & image, unsigned int threads) {
+    using Sample = typename decltype(image.r)::value_type;
+    std::size_t const pixels = image.width * image.height;
+    int const maxColor = sizeof(Sample) == 1 ? MAX_COLOR_VALUE : progargsCommon::MAX_COLOR_VALUE_16BIT;
+    common::color_histogram histogram(pixels, maxColor);
+    histogram.count(pixels, [&](std::size_t i) {
+      return common::pack_color(static_cast<std::uint64_t>(image.r[i]), static_cast<std::uint64_t>(image.g[i]),
+                                static_cast<std::uint64_t>(image.b[i]));
+    }, threads);
+    return histogram;
   }
 
-  return frequencyMap;
-}
-
-// Función para obtener los n colores menos frecuentes
-std::vector<std::tuple<int, int, int>> getLeastFrequentColors(std::unordered_map<std::tuple<int, int, int>, int, TupleHash> const & frequencyMap, int n) {
-  std::vector<std::pair<std::tuple<int, int, int>, int>> colorFrequency(frequencyMap.begin(), frequencyMap.end());
+  std::tuple<int, int, int> colorOf(std::uint64_t key) {
+    return {int{common::key_red(key)}, int{common::key_green(key)}, int{common::key_blue(key)}};
+  }
 
-  // Ordenar los colores por frecuencia (menor a mayor) y luego por componentes b, g, r
-  std::ranges::sort(colorFrequency, [](auto const & pixelA, auto const & pixelB) {
-    if (pixelA.second != pixelB.second) {
-      return pixelA.second < pixelB.second;
-    }
-    if (std::get<2>(pixelA.first) != std::get<2>(pixelB.first)) {
-      return std::get<2>(pixelA.first) > std::get<2>(pixelB.first);
-    }
-    if (std::get<1>(pixelA.first) != std::get<1>(pixelB.first)) {
-      return std::get<1>(pixelA.first) > std::get<1>(pixelB.first);
+  std::vector<std::tuple<int, int, int>> leastFrequent(std::vector<common::color_count> const & counts, int n) {
+    std::vector<std::tuple<int, int, int>> colorsToRemove;
+    for (auto const key : common::least_frequent(counts, static_cast<std::size_t>(std::max(n, 0)))) {
+      colorsToRemove.push_back(colorOf(key));
     }
-    return std::get<0>(pixelA.first) > std::get<0>(pixelB.first);
-  });
-
-  std::vector<std::tuple<int, int, int>> colorsToRemove;
-  size_t const numColorsToRemove = std::min(static_cast<size_t>(n), colorFrequency.size());
-    colorsToRemove.reserve(numColorsToRemove);
-  for (size_t i = 0; i < numColorsToRemove; ++i) {
-    colorsToRemove.push_back(colorFrequency[i].first);
+    return colorsToRemove;
   }
 
-  return colorsToRemove;
-}
+  template <typename I>
+  void cutfreqPlanes(I & image, int n, unsigned int threads) {
+    using Sample = typename decltype(image.r)::value_type;
+    if (n < 1) {
+      throw std::invalid_argument("Error: Invalid cutfreq: " + std::to_string(n));
+    }
+    auto const plan = common::plan_cutfreq(countFrequency(image, threads), static_cast<std::size_t>(n),
+                                           threads);
+    common::color_remap const remap(plan);
+
+    // Cada hilo sustituye los píxeles de su tramo
+    common::parallel_for(image.width * image.height, threads, [&](std::size_t first, std::size_t last, unsigned int) {
+      for (std::size_t i = first; i < last; ++i) {
+        std::uint64_t const key = common::pack_color(static_cast<std::uint64_t>(image.r[i]),
+                                                     static_cast<std::uint64_t>(image.g[i]),
+                                                     static_cast<std::uint64_t>(image.b[i]));
+        if (std::uint64_t const target = remap(key); target != key) {
+          image.r[i] = static_cast<Sample>(common::key_red(target));
+          image.g[i] = static_cast<Sample>(common::key_green(target));
+          image.b[i] = static_cast<Sample>(common::key_blue(target));
+        }
+      }
+    });
+  }
+}  // namespace
 
-// Construye un grid optimizado para la búsqueda de colores
-std::unordered_map<int, std::vector<std::tuple<int, int, int>>> buildGridOptimized(const ImageSOA& image, int gridSize) {
-  std::unordered_map<int, std::vector<std::tuple<int, int, int>>> grid;
-  for (std::size_t i = 0; i < image.width * image.height; ++i) {
-    int const rIndex = image.r[i] / gridSize;
-    int const gIndex = image.g[i] / gridSize;
-    int const bIndex = image.b[i] / gridSize;
-    int const key =( rIndex * RED_MULTIPLIER) + (gIndex * GREEN_MULTIPLIER) + bIndex;
-    grid[key].emplace_back(image.r[i], image.g[i], image.b[i]);
-  }
-  return grid;
+// Función para contar la frecuencia de colores en la imagen
+std::unordered_map<std::tuple<int, int, int>, int, TupleHash> countColorFrequencySOA(CutFreqParamsSOA const & params) {
+  std::unordered_map<std::tuple<int, int, int>, int, TupleHash> frequencyMap;
+  for (auto const & color : countFrequency(*params.image, 1).counts()) {
+    frequencyMap.emplace(colorOf(color.key), static_cast<int>(color.count));
+  }
+  return frequencyMap;
 }
 
-// Encuentra el color más cercano optimizado usando el grid
-std::tuple<int, int, int> findClosestColorOptimized(const std::tuple<int, int, int>& color, const std::unordered_map<int, std::vector<std::tuple<int, int, int>>>& grid, int gridSize) {
-  int const rIndex = std::get<0>(color) / gridSize;
-  int const gIndex = std::get<1>(color) / gridSize;
-  int const bIndex = std::get<2>(color) / gridSize;
-  int const key = (rIndex * RED_MULTIPLIER) + (gIndex * GREEN_MULTIPLIER) + bIndex;
-
-  std::tuple<int, int, int> closestColor;
-  double minDistance = std::numeric_limits<double>::max();
-
-  for (int dr = -1; dr <= 1; ++dr) {
-    for (int dg = -1; dg <= 1; ++dg) {
-      for (int db = -1; db <= 1; ++db) {
-        int const neighborKey = key + (dr * RED_MULTIPLIER) + (dg * GREEN_MULTIPLIER) + db;
-        if (grid.find(neighborKey) != grid.end()) {
-          for (const auto& neighborColor : grid.at(neighborKey)) {
-            // Calcular la distancia euclidia entre los colores
-            double const distance = std::pow(std::get<0>(color) - std::get<0>(neighborColor), 2) +
-                              std::pow(std::get<1>(color) - std::get<1>(neighborColor), 2) +
-                              std::pow(std::get<2>(color) - std::get<2>(neighborColor), 2);
-            if (distance < minDistance) {
-              minDistance = distance;
-              closestColor = neighborColor;
-            }
-          }
-        }
-      }
-    }
+// Función para obtener los n colores menos frecuentes
+std::vector<std::tuple<int, int, int>> getLeastFrequentColors(std::unordered_map<std::tuple<int, int, int>, int, TupleHash> const & frequencyMap, int n) {
+  std::vector<common::color_count> counts;
+  counts.reserve(frequencyMap.size());
+  for (auto const & [color, count] : frequencyMap) {
+    auto const [red, green, blue] = color;
+    counts.push_back({.key = common::pack_color(static_cast<std::uint64_t>(red), static_cast<std::uint64_t>(green),
+                                                static_cast<std::uint64_t>(blue)),
+                      .count = static_cast<std::uint32_t>(count)});
   }
-  return closestColor;
+  return leastFrequent(counts, n);
 }
 
 // Función principal para eliminar los colores menos frecuentes de la imagen
 void cutfreq(CutFreqParamsSOA const & params) {
-  if (params.n < 1) {
-    throw std::invalid_argument("Error: Invalid cutfreq: " + std::to_string(params.n));
-  }
-  auto frequencyMap = countColorFrequencySOA(params);
-  auto colorsToRemove = getLeastFrequentColors(frequencyMap, params.n);
-  std::unordered_set<std::tuple<int, int, int>, TupleHash> const colorsToRemoveSet(colorsToRemove.begin(), colorsToRemove.end());
-  auto grid = buildGridOptimized(*params.image, GRID_SIZE);
-  std::unordered_map<std::tuple<int, int, int>, std::tuple<int, int, int>, TupleHash> replacementMap;
-  for (const auto& color : colorsToRemove) {
-    auto closestColor = findClosestColorOptimized(color, grid, GRID_SIZE);
-    replacementMap[color] = closestColor;
-  }
+  cutfreqPlanes(*params.image, params.n, 1);
+}
 
-  for (std::size_t i = 0; i < params.image->width * params.image->height; ++i) {
-    auto pixel = std::make_tuple(params.image->r[i], params.image->g[i], params.image->b[i]);
-    auto iter = replacementMap.find(pixel);
-    if (iter != replacementMap.end()) {
-      auto newColor = iter->second;
-      params.image->r[i] = std::get<0>(newColor);
-      params.image->g[i] = std::get<1>(newColor);
-      params.image->b[i] = std::get<2>(newColor);
-    }
+  template <typename T>
+  void cutfreq(PlanesOf<T> & image, int n, unsigned int threads) {
+    cutfreqPlanes(image, n, threads);
   }
-}
 
-  void callCutfreq(std::vector<std::string> const &args) {
-    if (std::stoi(args[4]) < 1) {
-      std::cerr << "Error: Operación no válida o número de colores a eliminar no válido.\n";
-      return;
-    }
+  bool callCutfreq(std::vector<std::string> const &args, progargsCommon::options const & opts) {
     const std::string& inputFile = args[1];
     const std::string& outputFile = args[2];
     int const numColorsToRemove = std::stoi(args[4]);
-    std::size_t width = 0;
-    std::size_t height = 0;
-    ImageSOA image;
-    image = readPPM(inputFile, width, height);
-    CutFreqParamsSOA const params(image, numColorsToRemove);
-    std::unordered_map<std::tuple<int, int, int>, int, TupleHash> frequencyMap;
-    frequencyMap = countColorFrequencySOA(params);
-    std::vector<std::tuple<int, int, int>> colorsToRemove;
-    colorsToRemove = getLeastFrequentColors(frequencyMap, numColorsToRemove);
-    cutfreq(params);
-    writePPM(outputFile, image, width, height);
+    if (numColorsToRemove < 1) {
+      std::cerr << "Error: Operación no válida o número de colores a eliminar no válido.\n";
+      return false;
+    }
+
+    common::ImageInput input;
+    if (!input.open(inputFile)) {
+      std::cerr << "Error: No se pudo abrir el archivo de entrada. " << inputFile << '\n';
+      return false;
+    }
+    common::image_header const & header = input.header();
+    if (header.magic != "P6") {
+      std::cerr << "Error: Formato de archivo PPM no soportado.\n";
+      return false;
+    }
+    if (header.max_color > progargsCommon::MAX_COLOR_VALUE_16BIT) {
+      std::cerr << "Error: Valor máximo no soportado: " << header.max_color << '\n';
+      return false;
+    }
+
+    return common::dispatch_sample(header.max_color, [&]<typename T>(T) {
+      PlanesOf<T> image;
+      readImage(input, image);
+      input.release(0, input.payload_size());  // Las páginas del fichero ya no hacen falta
+      cutfreq(image, numColorsToRemove, opts.threads);
+      bool const saved = savePlanes(outputFile, image, image.max_color);  // savePlanes ya informa del error
+      recyclePlanes(image);
+      return saved;
+    });
   }
-}
\ No newline at end of file
+
+
+  template void readImage<uint8_t>(common::ImageInput const & input, PlanesOf<uint8_t> & image);
+  template void readImage<uint16_t>(common::ImageInput const & input, PlanesOf<uint16_t> & image);
+  template common::palette buildPalette<uint8_t>(PlanesOf<uint8_t> const & image, unsigned int threads);
+  template common::palette buildPalette<uint16_t>(PlanesOf<uint16_t> const & image, unsigned int threads);
+  template void maxlevel<uint8_t, uint8_t>(PlanesOf<uint8_t> const & input, PlanesOf<uint8_t> & output,
+                                           common::level_table const & table);
+  template void maxlevel<uint8_t, uint16_t>(PlanesOf<uint8_t> const & input, PlanesOf<uint16_t> & output,
+                                            common::level_table const & table);
+  template void maxlevel<uint16_t, uint8_t>(PlanesOf<uint16_t> const & input, PlanesOf<uint8_t> & output,
+                                            common::level_table const & table);
+  template void maxlevel<uint16_t, uint16_t>(PlanesOf<uint16_t> const & input, PlanesOf<uint16_t> & output,
+                                             common::level_table const & table);
+  template PlanesOf<uint8_t> resizeImage<uint8_t>(PlanesOf<uint8_t> const & original, int newWidth, int newHeight,
+                                                  progargsCommon::options const & opts);
+  template PlanesOf<uint16_t> resizeImage<uint16_t>(PlanesOf<uint16_t> const & original, int newWidth,
+                                                    int newHeight, progargsCommon::options const & opts);
+  template void cutfreq<uint8_t>(PlanesOf<uint8_t> & image, int n, unsigned int threads);
+  template void cutfreq<uint16_t>(PlanesOf<uint16_t> & image, int n, unsigned int threads);
+}
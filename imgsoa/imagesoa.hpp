@@ -3,7 +3,13 @@
 
 #include <cstdint>
 #include <map>
+#include <span>
 #include <string>
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
+#include "common/levels.hpp"
+#include "common/palette.hpp"
 #include "common/progargs.hpp"
 #include <vector>
 
@@ -13,9 +19,6 @@ namespace imgsoa {
 
   constexpr unsigned int MAX_COLOR_VALUE_8BIT = 255;
   constexpr int MAX_COLOR_VALUE = 255;
-  constexpr int GRID_SIZE = 8;
-  constexpr int RED_MULTIPLIER = 10000;
-  constexpr int GREEN_MULTIPLIER = 100;
 
   struct ImageSOA {
     std::vector<int> r;  // Componente rojo
@@ -25,6 +28,18 @@ namespace imgsoa {
     std::size_t height = 0;
   };
 
+  // Imagen SOA compacta: tres planos con muestras de 8 o 16 bits (uint8_t o uint16_t), tipo que
+  // se elige al cargarla según su maxval con common::dispatch_sample
+  template <typename T>
+  struct PlanesOf {
+    std::vector<T> r;
+    std::vector<T> g;
+    std::vector<T> b;
+    std::size_t width  = 0;
+    std::size_t height = 0;
+    int max_color      = 0;
+  };
+
   // Estructura para encapsular los parámetros de la función
   struct CutFreqParamsSOA {
     ImageSOA * image;
@@ -34,14 +49,14 @@ namespace imgsoa {
       : image(&img), n(num) { }
   };
 
-  // Custom hash function for std::tuple<int, int, int>
+  // Hash de color para std::tuple<int, int, int> sobre la clave empaquetada de los tres canales
   struct TupleHash {
     template <class T1, class T2, class T3>
     std::size_t operator()(const std::tuple<T1, T2, T3>& tuple) const {
-      auto hash1 = std::hash<T1>{}(std::get<0>(tuple));
-      auto hash2 = std::hash<T2>{}(std::get<1>(tuple));
-      auto hash3 = std::hash<T3>{}(std::get<2>(tuple));
-      return hash1 ^ hash2 ^ hash3;
+      std::uint64_t const key = common::pack_color(static_cast<std::uint64_t>(std::get<0>(tuple)),
+                                                   static_cast<std::uint64_t>(std::get<1>(tuple)),
+                                                   static_cast<std::uint64_t>(std::get<2>(tuple)));
+      return static_cast<std::size_t>(common::hash_color(key));
     }
   };
 
@@ -85,14 +100,29 @@ namespace imgsoa {
 
   bool loadPhoto(const std::string& filename, Photo& photo);
   bool savePhoto(const std::string& filename, const Photo& photo);
-  bool readHeader(std::ifstream& file, Photo& photo);
+  bool readHeader(common::ImageInput const & input, Photo& photo);
   template<typename T>
-  void readPixels(std::ifstream& file, size_t pixelCount, Photo &photo);
+  void readPixels(common::ImageInput const & input, size_t pixelCount, Photo &photo);
+  // Desempaqueta pixelCount píxeles intercalados de tipo T desde data en los planos de photo
+  template<typename T>
+  void unpackPixels(std::span<uint8_t const> data, size_t pixelCount, Photo &photo);
+
 
+  void maxlevel(Photo& photo, unsigned int newMaxValue, common::rounding mode = common::rounding::truncate);
+  // Aplica una tabla de maxlevel ya construida (reutilizable entre bandas de la misma imagen)
+  void maxlevel(Photo& photo, common::level_table const & table);
+  // maxlevel entre planos compactos: Out es el tipo de muestra que corresponde al nuevo máximo
+  template<typename In, typename Out>
+  void maxlevel(PlanesOf<In> const & input, PlanesOf<Out> & output, common::level_table const & table);
 
-  void maxlevel(Photo& photo, unsigned int newMaxValue);
+  // Desempaqueta la carga útil P6 de input, cuyas muestras deben ser de tipo T, en image
+  template<typename T>
+  void readImage(common::ImageInput const & input, PlanesOf<T> & image);
 
-  void compress(progargsCommon::parameters_files params);
+  // Comprime una imagen P6 en un fichero C6; false si no se puede leer la entrada o escribir la salida
+  bool compress(progargsCommon::parameters_files params, progargsCommon::options const & opts = {});
+  // Reconstruye una imagen P6 a partir de un fichero C6
+  bool decompress(progargsCommon::parameters_files const & params);
 
   void getPixels(Image & image, std::string & filename) ;
 
@@ -104,6 +134,16 @@ namespace imgsoa {
 
   void write_pixels(Image& image, std::map<std::tuple<uint16_t, uint16_t, uint16_t>, uint32_t>& color_list,std::string& filename);
 
+  // Función para construir la paleta ordenada y el índice de cada píxel sin árboles intermedios
+  common::palette buildPalette(Image const & image, unsigned int threads = 1);
+  template<typename T>
+  common::palette buildPalette(PlanesOf<T> const & image, unsigned int threads = 1);
+  // Equivalentes de write_color_table y write_pixels que escriben una paleta ya construida en un
+  // fichero abierto, a continuación de lo que ya contenga
+  void write_color_table(common::ImageOutput & file, Image const & image, common::palette const & colors);
+  void write_pixels(common::ImageOutput & file, Image const & image, common::palette const & colors,
+                    unsigned int threads = 1);
+
   bool loadPPM(std::string const & filename, Picture & image);
 
   bool savePPM(std::string const & filename, Picture const & image);
@@ -111,10 +151,28 @@ namespace imgsoa {
   void bilinearInterpolate(const Picture& original, double xcoord, double ycoord, Pixel& color);
 
   Picture resizeImage(Picture const & original, int newWidth, int newHeight);
-
-  void handle_maxlevel_optionSOA(std::vector<std::string> const &args, const progargsCommon::parameters_files& params);
-
-  void process_parametersSOA(std::vector<std::string> const &args);
+  template<typename T>
+  PlanesOf<T> resizeImage(PlanesOf<T> const & original, int newWidth, int newHeight,
+                          progargsCommon::options const & opts = {});
+  // Redimensiona el fichero de entrada con muestras de 8 o 16 bits según su maxval, que se conserva.
+  // Usa el filtro de opts.filter y, con opts.threads > 1, reparte las bandas de filas entre hilos
+  bool resize(progargsCommon::parameters_files const & params, int newWidth, int newHeight,
+              progargsCommon::options const & opts = {});
+  // Varios tamaños con una sola lectura de la entrada: se escribe un fichero por tamaño
+  // (progargsCommon::sized_filename) y cada nivel sale del nivel mayor más próximo que lo contiene.
+  // Con opts.stream cada tamaño se genera por separado sin cargar la entrada
+  bool resizeMany(progargsCommon::parameters_files const & params, std::vector<common::resize_target> const & sizes,
+                  progargsCommon::options const & opts = {});
+
+  // maxlevel con el nuevo máximo de args[4]; false si no es válido o no se puede procesar la imagen
+  bool handle_maxlevel_optionSOA(std::vector<std::string> const &args, const progargsCommon::parameters_files& params,
+                                 progargsCommon::options const & opts = {});
+  // Función para aplicar maxlevel por bandas de filas, con memoria acotada e independiente del tamaño.
+  // bandRows fija las filas por banda (0: las que ocupen unos common::BAND_BYTES)
+  bool streamMaxlevel(progargsCommon::parameters_files const & params, unsigned int newMaxValue,
+                      common::rounding mode = common::rounding::truncate, std::size_t bandRows = 0);
+
+  bool process_parametersSOA(std::vector<std::string> const &args, progargsCommon::options const & opts = {});
 
   std::unordered_map<std::tuple<int, int, int>, int, TupleHash> countColorFrequencySOA(CutFreqParamsSOA const & params);
 
@@ -123,15 +181,19 @@ namespace imgsoa {
 
   // Función que corta los colores menos frecuentes de la imagen
   void cutfreq(CutFreqParamsSOA const & params);
+  // cutfreq sobre planos compactos; lanza std::invalid_argument si n < 1. Con threads > 1 el
+  // histograma, la búsqueda de sustitutos y la sustitución se reparten entre hilos, con el mismo
+  // resultado que en secuencial
+  template<typename T>
+  void cutfreq(PlanesOf<T> & image, int n, unsigned int threads = 1);
 
   // Declaraciones de las funciones para leer y escribir PPM
   ImageSOA readPPM(const std::string & filename, std::size_t & width, std::size_t & height);
   void writePPM(const std::string & filename, const ImageSOA & image, std::size_t width, std::size_t height);
   void initializeImageSOA(ImageSOA &image, std::size_t width, std::size_t height);
-  void callCutfreq(std::vector<std::string> const &args);
-  // Nuevas funciones para la optimización con grid
-  std::unordered_map<int, std::vector<std::tuple<int, int, int>>> buildGridOptimized(const ImageSOA& image, int gridSize);
-  std::tuple<int, int, int> findClosestColorOptimized(const std::tuple<int, int, int>& color, const std::unordered_map<int, std::vector<std::tuple<int, int, int>>>& grid, int gridSize);
+  // cutfreq con el número de colores de args[4]; false y mensaje si no es positivo o si no se puede
+  // leer la entrada o escribir la salida
+  bool callCutfreq(std::vector<std::string> const &args, progargsCommon::options const & opts = {});
 
 }
 
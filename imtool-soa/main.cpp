@@ -1,36 +1,79 @@
 #include "imgsoa/imagesoa.hpp"
 #include <cstring>
+#include <exception>
 #include <iostream>
 #include <gsl/gsl>
 #include "common/progargs.hpp"
+#include "common/batch.hpp"
 #include "common/info.hpp"
 
-int main(int argc, char *argv[]) {
-  if (!progargsCommon::check_argc(argc)) {
-    std::cerr << "Error : Wrong number of arguments; Needed minimunm 3 parameters \n";
-    return -1;
+namespace {
+  // Una invocación con sus argumentos posicionales, ya sin opciones
+  int runJob(std::vector<std::string> const & args, progargsCommon::options const & opts) {
+    int positional = gsl::narrow<int>(args.size());
+    if (!progargsCommon::check_argc(positional)) {
+      std::cerr << "Error : Wrong number of arguments; Needed minimunm 3 parameters \n";
+      return -1;
+    }
+    if(!progargsCommon::args_checker(args)) {
+      return -1;
+    }
+    if (strcmp(args[3].c_str(), "compress")==0) {
+      progargsCommon::parameters_files const params {.input_file = args[1], .output_file = args[2]};
+      return imgsoa::compress(params, opts) ? 0 : -1;
+    } if (strcmp(args[3].c_str(), "decompress") == 0) {
+      progargsCommon::parameters_files const params {.input_file = args[1], .output_file = args[2]};
+      return imgsoa::decompress(params) ? 0 : -1;
+    } if (strcmp(args[3].c_str(), "maxlevel") == 0){
+      return imgsoa::process_parametersSOA(args, opts) ? 0 : -1;
+    } if (strcmp(args[3].c_str(), "cutfreq") == 0) {
+      return imgsoa::callCutfreq(args, opts) ? 0 : -1;
+    } if (strcmp(args[3].c_str(), "info") == 0) {
+      progargsCommon::parameters_files const params {.input_file = args[1], .output_file = args[2]};
+      return common::info(params, opts) ? 0 : -1;
+    } if (strcmp(args[3].c_str(), "resize") == 0) {
+      progargsCommon::parameters_files const params {.input_file = args[1], .output_file = args[2]};
+      if (std::vector<common::resize_target> sizes; progargsCommon::parse_sizes(args, sizes)) {
+        if (!imgsoa::resizeMany(params, sizes, opts)) { return 1; }
+        std::cout << "Resized images saved next to " << args[2] << "\n";
+        return 0;
+      }
+      if (!imgsoa::resize(params, std::stoi(args[4]), std::stoi(args[5]), opts)) { return 1; }
+      std::cout << "Resized image saved to " << args[2] << "\n";
+    }
+    return 0;
   }
+
+  // Modo batch: cada trabajo se ejecuta como una invocación con las opciones globales, que el
+  // trabajo puede completar con las suyas
+  int runBatch(std::vector<std::string> const & args, progargsCommon::options const & opts) {
+    std::vector<common::batch_job> jobs;
+    if (!common::collect_jobs(args, opts, jobs)) { return -1; }
+    std::size_t const failed = common::run_batch(jobs, opts.threads, [&opts](common::batch_job const & job,
+                                                                             unsigned int threads) {
+      std::vector<std::string> job_args = job;
+      progargsCommon::options job_opts  = opts;
+      job_opts.batch.clear();
+      job_opts.threads = threads;
+      return progargsCommon::extract_options(job_args, job_opts) && runJob(job_args, job_opts) == 0;
+    });
+    std::cout << "Batch: " << jobs.size() - failed << " of " << jobs.size() << " jobs completed\n";
+    return failed == 0 ? 0 : -1;
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
   gsl::span const args_view{argv, gsl::narrow<std::size_t>(argc)};
-  std::vector<std::string> const args(args_view.begin(), args_view.end());
-  if(!progargsCommon::args_checker(args)) {
+  std::vector<std::string> args(args_view.begin(), args_view.end());
+  progargsCommon::options opts;
+  if (!progargsCommon::extract_options(args, opts)) {
     return -1;
   }
-  if (strcmp(args[3].c_str(), "compress")==0) {
-    progargsCommon::parameters_files const params {.input_file = args[1], .output_file = args[2]};
-    imgsoa::compress(params);
-    return 0;
-  } if (strcmp(args[3].c_str(), "maxlevel") == 0){
-    imgsoa::process_parametersSOA(args);
-    return 0;
-  } if (strcmp(args[3].c_str(), "cutfreq") == 0) {
-    imgsoa::callCutfreq(args);
-    return 0;
-  } if (strcmp(args[3].c_str(), "resize") == 0) {
-    imgsoa::Picture original;
-    if (!imgsoa::loadPPM(args[1], original)) { return 1; }
-    imgsoa::Picture const resized = resizeImage(original, std::stoi(args[4]), std::stoi(args[5]));
-    if (!imgsoa::savePPM(args[2], resized)) { return 1; }
-    std::cout << "Resized image saved to " << args[2] << "\n";
+  if (common::batch_requested(args, opts)) { return runBatch(args, opts); }
+  try {
+    return runJob(args, opts);
+  } catch (std::exception const & error) {
+    std::cerr << error.what() << '\n';
+    return -1;
   }
-  return 0;
-}
\ No newline at end of file
+}
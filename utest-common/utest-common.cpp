@@ -1,13 +1,30 @@
 //
 // Created by claud on 14/11/2024.
 //
+#include "common/batch.hpp"
+#include "common/cppm.hpp"
+#include "common/histogram.hpp"
+#include "common/imagein.hpp"
+#include "common/imageout.hpp"
 #include "common/info.hpp"
+#include "common/levels.hpp"
+#include "common/nearest.hpp"
+#include "common/palette.hpp"
+#include "common/probe.hpp"
 #include "common/progargs.hpp"
+#include "common/recycle.hpp"
+#include "common/resample.hpp"
 
 #include <common/binario.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <limits>
+#include <numbers>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -25,11 +42,14 @@ namespace common::test {
     };
 
     TEST_F(InfoTest, InfoFunction_ValidInput) {
-        // Simular archivo de entrada
-        std::string const inputFileContent = "P6 4 4 255\n";
+        // Simular archivo de entrada: 12 píxeles rojos y 4 azules
+        std::string inputFileContent = "P6 4 4 255\n";
+        for (int i = 0; i < 16; ++i) {
+            inputFileContent += i < 12 ? std::string{"\xFF\x00\x00", 3} : std::string{"\x00\x00\xFF", 3};
+        }
 
         // Crear un archivo temporal para simular el archivo de entrada
-        std::ofstream tempFile("input.ppm");
+        std::ofstream tempFile("input.ppm", std::ios::binary);
         tempFile << inputFileContent;
         tempFile.close();
 
@@ -50,10 +70,58 @@ namespace common::test {
         std::cout.rdbuf(oldCoutStreamBuf);
 
         // Verificar la salida
-        std::string const expectedOutput = "Input: input.ppm\nOutput: output.ppm\nOperation: info\nImage size: 4x4\nMax level: 255";
+        std::string const expectedOutput = "Input: input.ppm\nOutput: output.ppm\nOperation: info\nImage size: 4x4\nMax level: 255\n"
+                                           "Unique colors: 2\n"
+                                           "Channel red: min 0, max 255, mean 191.250\n"
+                                           "Channel green: min 0, max 0, mean 0.000\n"
+                                           "Channel blue: min 0, max 255, mean 63.750\n"
+                                           "Most frequent colors:\n  (255, 0, 0): 12\n  (0, 0, 255): 4\n";
         EXPECT_EQ(outputStream.str(), expectedOutput);
     }
 
+    TEST_F(InfoTest, InfoFunction_JsonOutput) {
+        std::ofstream tempFile("input.ppm", std::ios::binary);
+        tempFile << "P6 2 1 3\n" << std::string{"\x01\x02\x03\x01\x02\x03", 6};
+        tempFile.close();
+
+        progargsCommon::options opts;
+        opts.json = true;
+        opts.top  = 1;
+        std::ostringstream const outputStream;
+        std::streambuf* oldCoutStreamBuf = std::cout.rdbuf();
+        std::cout.rdbuf(outputStream.rdbuf());
+        bool const done = info({.input_file = "input.ppm", .output_file = "output.ppm"}, opts);
+        std::cout.rdbuf(oldCoutStreamBuf);
+
+        EXPECT_TRUE(done);
+        EXPECT_EQ(outputStream.str(),
+                  "{\"input\": \"input.ppm\", \"width\": 2, \"height\": 1, \"max_color\": 3, \"pixels\": 2, "
+                  "\"unique_colors\": 1, \"channels\": {"
+                  "\"red\": {\"min\": 1, \"max\": 1, \"mean\": 1.000, \"histogram\": [0, 2, 0, 0]}, "
+                  "\"green\": {\"min\": 2, \"max\": 2, \"mean\": 2.000, \"histogram\": [0, 0, 2, 0]}, "
+                  "\"blue\": {\"min\": 3, \"max\": 3, \"mean\": 3.000, \"histogram\": [0, 0, 0, 2]}}, "
+                  "\"top_colors\": [{\"red\": 1, \"green\": 2, \"blue\": 3, \"count\": 2}]}\n");
+    }
+
+    TEST_F(InfoTest, AnalyzeThreadsMatchSerial) {
+        constexpr std::size_t side = 300;  // Suficientes píxeles para repartir entre hilos
+        std::vector<std::uint8_t> data(side * side * CHANNELS);
+        for (std::size_t i = 0; i < data.size(); ++i) { data[i] = static_cast<std::uint8_t>((i * 7919) % 251); }
+        image_header const header{.magic = "P6", .width = side, .height = side, .max_color = 255};
+        image_stats const serial   = analyze_pixels(data, header, 5, 1);
+        image_stats const parallel = analyze_pixels(data, header, 5, 4);
+        EXPECT_EQ(serial.unique_colors, parallel.unique_colors);
+        for (std::size_t channel = 0; channel < CHANNELS; ++channel) {
+            EXPECT_EQ(serial.channels[channel].histogram, parallel.channels[channel].histogram);
+            EXPECT_EQ(serial.channels[channel].histogram.size(), 256U);
+        }
+        ASSERT_EQ(serial.top.size(), 5U);
+        for (std::size_t i = 0; i < serial.top.size(); ++i) {
+            EXPECT_EQ(serial.top[i].key, parallel.top[i].key);
+            EXPECT_EQ(serial.top[i].count, parallel.top[i].count);
+        }
+    }
+
     TEST_F(InfoTest, InfoFunction_InvalidInput) {
         // Simular archivo de entrada con contenido inválido
         std::string const inputFileContent = "Invalid content";
@@ -101,7 +169,7 @@ TEST(ProgArgsCommonTest, Pertenencia) {
 // Test para progargsCommon::args_checker
 TEST(ProgArgsCommonTest, ArgsChecker) {
     std::vector<std::string> const args1 = {"program", "file1", "file2", "compress"};
-    std::vector<std::string> const args2 = {"program", "file1", "file2", "resize", "width", "height"};
+    std::vector<std::string> const args2 = {"program", "file1", "file2", "resize", "640", "480"};
     std::vector<std::string> const args3 = {"program", "file1", "file2", "maxlevel", "level"};
     std::vector<std::string> const args4 = {"program", "file1", "file2", "cutfreq", "frequency"};
     std::vector<std::string> const invalidArgs = {"program", "file1", "file2", "invalid"};
@@ -113,6 +181,51 @@ TEST(ProgArgsCommonTest, ArgsChecker) {
     EXPECT_FALSE(progargsCommon::args_checker(invalidArgs));
 }
 
+// Test para progargsCommon::extract_options
+TEST(ProgArgsCommonTest, ExtractOptions) {
+    std::vector<std::string> args = {"program", "file1", "--stream", "file2", "maxlevel", "255"};
+    progargsCommon::options opts;
+    EXPECT_TRUE(progargsCommon::extract_options(args, opts));
+    EXPECT_TRUE(opts.stream);
+    EXPECT_EQ(args, (std::vector<std::string>{"program", "file1", "file2", "maxlevel", "255"}));
+
+    std::vector<std::string> invalid = {"program", "file1", "file2", "maxlevel", "255", "--fast"};
+    EXPECT_FALSE(progargsCommon::extract_options(invalid, opts));
+
+    std::vector<std::string> threaded = {"program", "--threads", "4", "file1", "file2", "compress"};
+    EXPECT_TRUE(progargsCommon::extract_options(threaded, opts));
+    EXPECT_EQ(opts.threads, 4U);
+    EXPECT_EQ(threaded.size(), 4U);
+    std::vector<std::string> zero = {"program", "--threads=0", "file1", "file2", "compress"};
+    EXPECT_FALSE(progargsCommon::extract_options(zero, opts));
+
+    std::vector<std::string> filtered = {"program", "file1", "file2", "resize", "10", "10", "--filter=lanczos3"};
+    EXPECT_TRUE(progargsCommon::extract_options(filtered, opts));
+    EXPECT_EQ(opts.filter, common::resize_filter::lanczos3);
+    std::vector<std::string> unknown = {"program", "--filter", "sinc", "file1", "file2", "resize", "10", "10"};
+    EXPECT_FALSE(progargsCommon::extract_options(unknown, opts));
+}
+
+TEST(ProgArgsCommonTest, ResizeSizeList) {
+    std::vector<common::resize_target> sizes;
+    EXPECT_TRUE(progargsCommon::parse_sizes({"program", "in", "out", "resize", "800x600", "64x48", "1x1"}, sizes));
+    ASSERT_EQ(sizes.size(), 3U);
+    EXPECT_EQ(sizes[1].width, 64U);
+    EXPECT_EQ(sizes[1].height, 48U);
+    EXPECT_FALSE(progargsCommon::parse_sizes({"program", "in", "out", "resize", "800", "600"}, sizes));
+    EXPECT_FALSE(progargsCommon::parse_sizes({"program", "in", "out", "resize", "800x0"}, sizes));
+    EXPECT_TRUE(progargsCommon::args_checker({"program", "in", "out", "resize", "800x600", "64x48", "32x32"}));
+    EXPECT_TRUE(progargsCommon::args_checker({"program", "in", "out", "resize", "800x600", "64x48"}));
+    for (auto const & [width, height] : std::vector<std::pair<std::string, std::string>>{
+             {"0", "10"}, {"-5", "10"}, {"10", "0"}, {"10", "abc"}, {"10x", "10"}, {"99999999999", "10"}}) {
+        EXPECT_FALSE(progargsCommon::args_checker({"program", "in", "out", "resize", width, height})) << width;
+    }
+    EXPECT_EQ(progargsCommon::sized_filename("dir.v2/out.ppm", {.width = 64, .height = 48}), "dir.v2/out-64x48.ppm");
+    EXPECT_EQ(progargsCommon::sized_filename("dir.v2/out", {.width = 64, .height = 48}), "dir.v2/out-64x48");
+    EXPECT_EQ(progargsCommon::sized_filename("dir/.hidden", {.width = 64, .height = 48}), "dir/.hidden-64x48");
+    EXPECT_EQ(progargsCommon::sized_filename(".out.ppm", {.width = 64, .height = 48}), ".out-64x48.ppm");
+}
+
 // Test para binario::read_binary y binario::write_binary
 TEST(BinaryTest, ReadWriteBinary) {
     std::ostringstream output_stream;
@@ -138,7 +251,7 @@ TEST(BinaryTest, ReadBinaryError) {
 // Test para binario::write_birary
 TEST(BinaryTest, WriteBinary) {
     std::ostringstream output_stream;
-    double const input_value = std::numbres::pi;
+    double const input_value = std::numbers::pi;
 
     binario::write_birary(output_stream, input_value);
 
@@ -146,6 +259,702 @@ TEST(BinaryTest, WriteBinary) {
     EXPECT_EQ(output_stream.str().size(), sizeof(double));
 }
 
+// Test para common::parse_header con comentarios entre los campos
+TEST(ImageInputTest, ParseHeaderWithComments) {
+    std::string const text = "P6\n# comentario\n4 2\n# otro\n255\nXYZ";
+    std::vector<uint8_t> const data(text.begin(), text.end());
+    image_header header;
+    ASSERT_TRUE(parse_header(data, header));
+    EXPECT_EQ(header.magic, "P6");
+    EXPECT_EQ(header.width, 4);
+    EXPECT_EQ(header.height, 2);
+    EXPECT_EQ(header.max_color, 255);
+    EXPECT_EQ(data[header.offset], 'X');
+}
+
+// Test para ImageInput: la vista de la carga útil empieza tras la cabecera
+TEST(ImageInputTest, PayloadView) {
+    std::ofstream file("payload.ppm", std::ios::binary);
+    file << "P6 2 1 255\n" << static_cast<char>(1) << static_cast<char>(2) << static_cast<char>(3)
+         << static_cast<char>(4) << static_cast<char>(5) << static_cast<char>(6);
+    file.close();
+
+    ImageInput input;
+    ASSERT_TRUE(input.open("payload.ppm"));
+    EXPECT_EQ(input.header().pixel_count(), 2);
+    auto const data = input.payload(6);
+    std::vector<int> samples;
+    unpack_rgb<uint8_t>(data, 2, [&samples](std::size_t, uint8_t red, uint8_t green, uint8_t blue) {
+        samples.insert(samples.end(), {red, green, blue});
+    });
+    EXPECT_EQ(samples, (std::vector<int>{1, 2, 3, 4, 5, 6}));
+    (void)std::remove("payload.ppm");
+}
+
+// Test para ImageInput con fichero truncado o inexistente
+TEST(ImageInputTest, TruncatedPayloadThrows) {
+    std::ofstream file("short.ppm", std::ios::binary);
+    file << "P6 2 2 255\n" << static_cast<char>(1);
+    file.close();
+
+    ImageInput input;
+    ASSERT_TRUE(input.open("short.ppm"));
+    EXPECT_THROW((void)input.payload(12), std::runtime_error);
+    EXPECT_FALSE(input.open("nonexistent.ppm"));
+    (void)std::remove("short.ppm");
+}
+
+// Test para parse_header: cabeceras incompletas, máximos fuera de 1..65535 y tamaños que desbordan
+TEST(ImageInputTest, RejectsInvalidHeaders) {
+    for (std::string const text : {"P6\n", "P6 2 2 0\n", "P6 2 2 65536\n", "P6 9223372036854775808 2 255\n",
+                                   "P6 4294967296 4294967296 255\n", "C6 2 2 255 9223372036854775807\n"}) {
+        std::vector<uint8_t> const data(text.begin(), text.end());
+        image_header header;
+        EXPECT_FALSE(parse_header(data, header)) << text;
+    }
+
+    std::ofstream file("header-only.ppm", std::ios::binary);
+    file << "P6\n";
+    file.close();
+    ImageInput input;
+    EXPECT_FALSE(input.open("header-only.ppm"));
+    (void)std::remove("header-only.ppm");
+}
+
+// Test para ImageOutput: cabecera y planos empaquetados con saturación a 8 bits
+TEST(ImageOutputTest, WritePlanesSaturates) {
+    std::vector<int> const red = {300, 0};
+    std::vector<int> const green = {-5, 128};
+    std::vector<int> const blue = {255, 7};
+    {
+        ImageOutput output;
+        ASSERT_TRUE(output.open("planes.ppm"));
+        write_ppm_header(output, {.magic = "P6", .width = 2, .height = 1, .max_color = 255});
+        write_planes(output, planes_view<int>{red, green, blue}, 255);
+        output.close();
+    }
+    std::ifstream file("planes.ppm", std::ios::binary);
+    std::string const content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string const expected = std::string("P6\n2 1\n255\n") + '\xFF' + '\x00' + '\xFF' + '\x00' + '\x80' + '\x07';
+    EXPECT_EQ(content, expected);
+    (void)std::remove("planes.ppm");
+}
+
+// Test para ImageOutput: las muestras de 16 bits se escriben en el mismo orden que lee ImageInput
+TEST(ImageOutputTest, SixteenBitRoundTrip) {
+    std::vector<uint16_t> const red = {65535, 1};
+    std::vector<uint16_t> const green = {256, 2};
+    std::vector<uint16_t> const blue = {0, 3};
+    {
+        ImageOutput output;
+        ASSERT_TRUE(output.open("planes16.ppm"));
+        write_ppm_header(output, {.magic = "P6", .width = 2, .height = 1, .max_color = 65535});
+        write_planes(output, planes_view<uint16_t>{red, green, blue}, 65535);
+    }
+    ImageInput input;
+    ASSERT_TRUE(input.open("planes16.ppm"));
+    auto const data = input.payload(12);
+    std::vector<int> samples;
+    unpack_rgb<uint16_t>(data, 2, [&samples](std::size_t, uint16_t r_val, uint16_t g_val, uint16_t b_val) {
+        samples.insert(samples.end(), {r_val, g_val, b_val});
+    });
+    EXPECT_EQ(samples, (std::vector<int>{65535, 256, 0, 1, 2, 3}));
+    (void)std::remove("planes16.ppm");
+}
+
+// Test para ImageOutput con ruta no válida
+TEST(ImageOutputTest, OpenInvalidPath) {
+    ImageOutput output;
+    EXPECT_FALSE(output.open("/invalid_path/output.ppm"));
+}
+
+// Test para level_table: la truncación coincide con la fórmula en coma flotante original
+TEST(LevelTableTest, TruncateMatchesFloatingPoint) {
+    unsigned int const old_max = 1000;
+    unsigned int const new_max = 255;
+    level_table const table(old_max, new_max);
+    std::vector<unsigned int> samples(old_max + 20);
+    for (unsigned int i = 0; i < samples.size(); ++i) { samples[i] = i; }
+    table.apply(samples);
+    double const factor = static_cast<double>(new_max) / old_max;
+    for (unsigned int i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(samples[i], static_cast<unsigned int>(i * factor));
+    }
+    EXPECT_EQ(table.new_max(), new_max);
+}
+
+// Test para level_table con redondeo al más próximo
+TEST(LevelTableTest, NearestRounding) {
+    level_table const table(128, 255, rounding::nearest);
+    EXPECT_EQ(table(64U), 128U);   // 127.5 -> 128
+    EXPECT_EQ(table(1), 2);        // 1.99 -> 2
+    EXPECT_EQ(table(128U), 255U);
+    EXPECT_EQ(level_table(128, 255)(64U), 127U);
+}
+
+// Test para level_table: un máximo de entrada o de salida fuera de 16 bits se rechaza sin reservar la tabla
+TEST(LevelTableTest, RejectsWideMaximum) {
+    EXPECT_THROW(level_table(std::numeric_limits<int>::max(), 255), std::runtime_error);
+    EXPECT_THROW(level_table(255, 65536), std::runtime_error);
+}
+
+// Test para build_palette: la tabla densa de 8 bits y la ordenación de 16 bits coinciden
+TEST(PaletteTest, DenseAndSortedPathsAgree) {
+    std::vector<std::uint64_t> const keys = {pack_color(200, 0, 3), pack_color(0, 255, 0), pack_color(200, 0, 3),
+                                             pack_color(0, 0, 255), pack_color(0, 255, 0)};
+    auto const key_of = [&keys](std::size_t index) { return keys[index]; };
+    palette const dense  = build_palette(keys.size(), 255, key_of);
+    palette const sorted = build_palette(keys.size(), 65535, key_of);
+
+    std::vector<std::uint64_t> const expected_colors = {pack_color(0, 0, 255), pack_color(0, 255, 0),
+                                                        pack_color(200, 0, 3)};
+    EXPECT_EQ(dense.colors, expected_colors);
+    EXPECT_EQ(dense.indices, (std::vector<std::uint32_t>{2, 1, 2, 0, 1}));
+    EXPECT_EQ(sorted.colors, dense.colors);
+    EXPECT_EQ(sorted.indices, dense.indices);
+}
+
+// Test para build_palette con muestras que no caben en 8 bits pese a max_color <= 255
+TEST(PaletteTest, WideSamplesFallBackToSort) {
+    std::vector<std::uint64_t> const keys = {pack_color(300, 1, 1), pack_color(1, 1, 1)};
+    palette const result = build_palette(keys.size(), 255, [&keys](std::size_t index) { return keys[index]; });
+    EXPECT_EQ(result.colors, (std::vector<std::uint64_t>{pack_color(1, 1, 1), pack_color(300, 1, 1)}));
+    EXPECT_EQ(result.indices, (std::vector<std::uint32_t>{1, 0}));
+    EXPECT_EQ(index_size(255), 1);
+    EXPECT_EQ(index_size(256), 2);
+    EXPECT_EQ(index_size(65536), 4);
+}
+
+// Test para build_palette en paralelo: misma paleta e índices que con un hilo
+TEST(PaletteTest, ThreadedMatchesSequential) {
+    std::vector<std::uint64_t> keys(200000);
+    std::uint64_t state = 12345;
+    for (auto & key : keys) {
+        state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+        key   = pack_color((state >> 40U) & 0xFFU, (state >> 48U) & 0x3FU, (state >> 56U) & 0xFFU);
+    }
+    auto const key_of = [&keys](std::size_t index) { return keys[index]; };
+    for (int const max_color : {255, 65535}) {
+        palette const sequential = build_palette(keys.size(), max_color, key_of);
+        palette const threaded   = build_palette(keys.size(), max_color, key_of, 4);
+        EXPECT_EQ(threaded.colors, sequential.colors);
+        EXPECT_EQ(threaded.indices, sequential.indices);
+    }
+}
+
+// Test para parse_header con la cabecera C6, que lleva el número de colores
+TEST(CppmTest, ParseCompressedHeader) {
+    std::string const text = "C6 3 2 255 4\nXYZ";
+    std::vector<uint8_t> const data(text.begin(), text.end());
+    image_header header;
+    ASSERT_TRUE(parse_header(data, header));
+    EXPECT_EQ(header.magic, "C6");
+    EXPECT_EQ(header.colors, 4);
+    EXPECT_EQ(data[header.offset], 'X');
+}
+
+// Test para expand_indices: 20 índices (camino vectorial y cola escalar) y un índice inválido
+TEST(CppmTest, ExpandIndices) {
+    std::vector<uint8_t> const entries = {10, 20, 30, 0, 40, 50, 60, 0, 70, 80, 90, 0};
+    cppm_palette const palette{.entries = entries, .colors = 3, .sample = 1};
+    std::vector<uint8_t> indices(20);
+    for (std::size_t i = 0; i < indices.size(); ++i) { indices[i] = static_cast<uint8_t>(i % 3); }
+    std::vector<uint8_t> out(indices.size() * 3);
+    expand_indices(indices, 1, palette, out);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        EXPECT_EQ(out[i * 3], entries[(i % 3) * 4]);
+        EXPECT_EQ(out[(i * 3) + 2], entries[((i % 3) * 4) + 2]);
+    }
+    indices[17] = 3;
+    EXPECT_THROW(expand_indices(indices, 1, palette, out), std::runtime_error);
+}
+
+  // dispatch_sample elige el ancho de muestra según el maxval
+  TEST(SampleTest, DispatchByMaxColor) {
+    EXPECT_EQ(common::dispatch_sample(255, [](auto sample) { return sizeof(sample); }), 1U);
+    EXPECT_EQ(common::dispatch_sample(256, [](auto sample) { return sizeof(sample); }), 2U);
+  }
+
+  // convert satura al tipo de salida los valores fuera de la tabla, como el empaquetado
+  TEST(LevelTableTest, ConvertSaturatesToOutput) {
+    common::level_table const table(100, 200);
+    EXPECT_EQ(table.convert<std::uint8_t>(std::uint8_t{100}), 200);
+    EXPECT_EQ(table.convert<std::uint8_t>(std::uint8_t{200}), 255);
+    EXPECT_EQ(table.convert<std::uint16_t>(std::uint8_t{200}), 400);
+  }
+
+  // apply entre muestras de 8 y 16 bits (con AVX2, si lo hay) coincide con convert muestra a muestra,
+  // también con valores fuera de la tabla y longitudes que no son múltiplo del bloque vectorial
+  template <typename In, typename Out>
+  void expect_apply_matches_convert(common::level_table const & table) {
+    constexpr std::size_t samples = 1003;
+    constexpr std::size_t step    = 97;  // Recorre todo el rango de In con saltos irregulares
+    std::vector<In> input(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+      input[i] = static_cast<In>((i * step) % (std::size_t{std::numeric_limits<In>::max()} + 1));
+    }
+    // Un bloque entero dentro de la tabla tras otro con valores fuera
+    std::fill_n(input.begin(), 16, In{1});
+    std::vector<Out> output(samples);
+    table.apply(std::span<In const>(input), std::span<Out>(output));
+    for (std::size_t i = 0; i < samples; ++i) {
+      EXPECT_EQ(output[i], table.convert<Out>(input[i])) << sizeof(In) << "->" << sizeof(Out) << " at " << i;
+    }
+  }
+
+  TEST(LevelTableTest, NarrowApplyMatchesConvert) {
+    for (auto const mode : {common::rounding::truncate, common::rounding::nearest}) {
+      for (auto const & [old_max, new_max] : {std::pair{200U, 255U}, std::pair{255U, 1000U}, std::pair{1000U, 255U},
+                                              std::pair{1000U, 65535U}, std::pair{65535U, 300U}}) {
+        common::level_table const table(old_max, new_max, mode);
+        expect_apply_matches_convert<std::uint8_t, std::uint8_t>(table);
+        expect_apply_matches_convert<std::uint8_t, std::uint16_t>(table);
+        expect_apply_matches_convert<std::uint16_t, std::uint8_t>(table);
+        expect_apply_matches_convert<std::uint16_t, std::uint16_t>(table);
+      }
+    }
+  }
+
+  TEST(ResampleTest, BilinearAxisMapsEnds) {
+    common::resize_axis const axis = common::bilinear_axis(3, 5, 11);
+    EXPECT_EQ(axis.low, (std::vector<std::uint32_t>{0, 0, 1, 1, 2}));
+    EXPECT_EQ(axis.high, (std::vector<std::uint32_t>{0, 1, 1, 2, 2}));
+    EXPECT_EQ(axis.weight, (std::vector<std::uint32_t>{0, 1024, 0, 1024, 0}));
+  }
+
+  TEST(ResampleTest, ResizeBilinearBlendsCorners) {
+    std::vector<std::uint8_t> const source = {0, 200, 100, 250};
+    std::vector<std::uint8_t> target(9);
+    common::resize_bilinear<std::uint8_t>({.data = source, .width = 2, .height = 2, .channels = 1},
+                                          {.data = target, .width = 3, .height = 3, .channels = 1});
+    EXPECT_EQ(target, (std::vector<std::uint8_t>{0, 100, 200, 50, 137, 225, 100, 175, 250}));
+  }
+
+  // Un plano suelto pasa por el núcleo vectorial cuando hay AVX2; intercalado con tres canales
+  // iguales pasa por el escalar en horizontal, y ambos deben coincidir muestra a muestra
+  TEST(ResampleTest, PlaneMatchesInterleaved) {
+    constexpr std::size_t width = 45;
+    constexpr std::size_t height = 7;
+    std::vector<std::uint8_t> plane(width * height);
+    std::vector<std::uint8_t> interleaved;
+    for (std::size_t i = 0; i < plane.size(); ++i) {
+      plane[i] = static_cast<std::uint8_t>((i * 37) % 256);
+      interleaved.insert(interleaved.end(), 3, plane[i]);
+    }
+    std::vector<std::uint8_t> resized_plane(101 * 13);
+    std::vector<std::uint8_t> resized_interleaved(101 * 13 * 3);
+    common::resize_bilinear<std::uint8_t>({.data = plane, .width = width, .height = height, .channels = 1},
+                                          {.data = resized_plane, .width = 101, .height = 13, .channels = 1});
+    common::resize_bilinear<std::uint8_t>({.data = interleaved, .width = width, .height = height, .channels = 3},
+                                          {.data = resized_interleaved, .width = 101, .height = 13, .channels = 3});
+    for (std::size_t i = 0; i < resized_plane.size(); ++i) {
+      EXPECT_EQ(resized_plane[i], resized_interleaved[i * 3]) << "muestra " << i;
+    }
+  }
+
+  TEST(ResampleTest, ThreadsMatchSerial) {
+    std::vector<std::uint16_t> source(64 * 48);
+    for (std::size_t i = 0; i < source.size(); ++i) { source[i] = static_cast<std::uint16_t>((i * 7919) % 65536); }
+    std::vector<std::uint16_t> serial(300 * 200);
+    std::vector<std::uint16_t> threaded(serial.size());
+    common::resize_bilinear<std::uint16_t>({.data = source, .width = 64, .height = 48, .channels = 1},
+                                           {.data = serial, .width = 300, .height = 200, .channels = 1});
+    common::resize_bilinear<std::uint16_t>({.data = source, .width = 64, .height = 48, .channels = 1},
+                                           {.data = threaded, .width = 300, .height = 200, .channels = 1}, 4);
+    EXPECT_EQ(serial, threaded);
+  }
+
+  TEST(ResampleTest, BoxAveragesArea) {
+    std::vector<std::uint8_t> const source = {0, 10, 100, 110, 20, 30, 120, 130};
+    std::vector<std::uint8_t> target(2);
+    common::resample<std::uint8_t>({.data = source, .width = 4, .height = 2, .channels = 1},
+                                   {.data = target, .width = 2, .height = 1, .channels = 1}, 255,
+                                   {.filter = common::resize_filter::box, .threads = 1});
+    EXPECT_EQ(target, (std::vector<std::uint8_t>{15, 115}));
+  }
+
+  // Los pesos de cada banco suman 1 y, con el mismo tamaño, Lanczos deja la imagen igual
+  TEST(ResampleTest, FilterBanksKeepIdentity) {
+    for (auto const filter : {common::resize_filter::box, common::resize_filter::bicubic,
+                              common::resize_filter::lanczos3}) {
+      auto const bank = common::cached_bank(filter, 37, 11);
+      EXPECT_EQ(bank, common::cached_bank(filter, 37, 11));
+      for (std::size_t i = 0; i < 11; ++i) {
+        float sum = 0.0F;
+        for (std::size_t tap = 0; tap < bank->taps; ++tap) { sum += bank->weights[(i * bank->taps) + tap]; }
+        EXPECT_NEAR(sum, 1.0F, 1e-5F);
+        EXPECT_LE(bank->first[i] + bank->taps, 37U);
+      }
+    }
+    std::vector<std::uint16_t> const source = {0, 500, 1000, 65535, 3, 7, 9000, 12};
+    std::vector<std::uint16_t> target(source.size());
+    common::resample<std::uint16_t>({.data = source, .width = 4, .height = 2, .channels = 1},
+                                    {.data = target, .width = 4, .height = 2, .channels = 1}, 65535,
+                                    {.filter = common::resize_filter::lanczos3, .threads = 1});
+    EXPECT_EQ(target, source);
+  }
+
+  // El paso horizontal (vectorial de 8 en 8 columnas, con el resto escalar) es el producto con el banco
+  TEST(ResampleTest, FilterRowsMatchBank) {
+    std::size_t const width  = 29;
+    std::size_t const target = 19;
+    auto const bank = common::cached_bank(common::resize_filter::lanczos3, width, target);
+    for (std::size_t const channels : {1UL, 3UL}) {
+      std::vector<std::uint8_t> source(width * channels);
+      for (std::size_t i = 0; i < source.size(); ++i) { source[i] = static_cast<std::uint8_t>((i * 37) % 256); }
+      std::vector<std::uint8_t> resized(target * channels);
+      common::resample<std::uint8_t>({.data = source, .width = width, .height = 1, .channels = channels},
+                                     {.data = resized, .width = target, .height = 1, .channels = channels}, 255,
+                                     {.filter = common::resize_filter::lanczos3, .threads = 1});
+      for (std::size_t x = 0; x < target; ++x) {
+        for (std::size_t channel = 0; channel < channels; ++channel) {
+          float value = 0.0F;
+          for (std::size_t tap = 0; tap < bank->taps; ++tap) {
+            value += static_cast<float>(source[((bank->first[x] + tap) * channels) + channel]) *
+                     bank->weights[(x * bank->taps) + tap];
+          }
+          auto const expected = static_cast<std::uint8_t>(std::clamp(value, 0.0F, 255.0F) + 0.5F);
+          EXPECT_EQ(resized[(x * channels) + channel], expected) << x << ' ' << channel;
+        }
+      }
+    }
+  }
+
+  // Cada nivel sale del menor de los mayores que lo contienen; las ampliaciones, del origen
+  TEST(ResampleTest, PyramidUsesNearestLargerLevel) {
+    std::vector<common::resize_target> const levels = {
+        {.width = 100, .height = 100}, {.width = 800, .height = 600}, {.width = 2000, .height = 100},
+        {.width = 400, .height = 300}, {.width = 90, .height = 200}};
+    common::pyramid_plan const plan = common::plan_pyramid({.width = 1000, .height = 1000}, levels);
+    EXPECT_EQ(plan.parent, (std::vector<std::size_t>{3, 5, 5, 1, 3}));
+    ASSERT_EQ(plan.waves.size(), 3U);
+    EXPECT_EQ(plan.waves[0], (std::vector<std::size_t>{1, 2}));
+    EXPECT_EQ(plan.waves[1], (std::vector<std::size_t>{3}));
+    EXPECT_EQ(plan.waves[2], (std::vector<std::size_t>{4, 0}));
+  }
+
+  // En flujo el resultado es el mismo que redimensionando la imagen cargada
+  TEST(ResampleTest, StreamMatchesInMemory) {
+    std::vector<std::uint8_t> pixels(7 * 5 * 3);
+    for (std::size_t i = 0; i < pixels.size(); ++i) { pixels[i] = static_cast<std::uint8_t>((i * 53) % 256); }
+    {
+      std::ofstream file("stream.ppm", std::ios::binary);
+      file << "P6 7 5 255\n";
+      file.write(std::string(pixels.begin(), pixels.end()).data(), static_cast<std::streamsize>(pixels.size()));
+    }
+    std::vector<std::uint8_t> expected(12 * 3 * 3);
+    common::resize_bilinear<std::uint8_t>({.data = pixels, .width = 7, .height = 5, .channels = 3},
+                                          {.data = expected, .width = 12, .height = 3, .channels = 3});
+    {
+      ImageInput input;
+      ASSERT_TRUE(input.open("stream.ppm"));
+      ImageOutput output;
+      ASSERT_TRUE(output.open("streamed.ppm"));
+      common::stream_resize(input, output, {.width = 12, .height = 3});
+      output.close();
+    }
+    std::ifstream file("streamed.ppm", std::ios::binary);
+    std::string const content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, std::string("P6\n12 3\n255\n") + std::string(expected.begin(), expected.end()));
+    (void)std::remove("stream.ppm");
+    (void)std::remove("streamed.ppm");
+  }
+
+  TEST(HistogramTest, DenseMatchesSparse) {
+    std::size_t const pixels = std::size_t{1} << 20U;
+    common::color_histogram dense(pixels, 255);
+    common::color_histogram sparse(pixels, 65535);
+    ASSERT_TRUE(dense.dense());
+    ASSERT_FALSE(sparse.dense());
+    for (std::size_t i = 0; i < pixels; ++i) {
+      std::uint64_t const key = common::pack_color((i * 7) % 13, (i * 5) % 256, (i * i) % 251);
+      dense.add(key);
+      sparse.add(key);
+    }
+    auto const expected = dense.counts();
+    auto const counted  = sparse.counts();
+    ASSERT_EQ(expected.size(), counted.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i].key, counted[i].key);
+      EXPECT_EQ(expected[i].count, counted[i].count);
+    }
+  }
+
+  // El conteo denso repartido por tramos de la tabla (varios bloques, el último incompleto) da lo
+  // mismo que con un hilo
+  TEST(HistogramTest, DenseThreadsMatchSerial) {
+    std::size_t const pixels = (std::size_t{1} << 21U) + 12345;
+    auto const key_of = [](std::size_t i) {
+      return common::pack_color((i * 31) % 256, (i * 17) % 256, (i * i) % 251);
+    };
+    common::color_histogram serial(pixels, 255);
+    serial.count(pixels, key_of, 1);
+    for (unsigned int const threads : {3U, 8U}) {
+      common::color_histogram threaded(pixels, 255);
+      ASSERT_TRUE(threaded.dense());
+      threaded.count(pixels, key_of, threads);
+      auto const expected = serial.counts();
+      auto const counted  = threaded.counts();
+      ASSERT_EQ(expected.size(), counted.size());
+      for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].key, counted[i].key);
+        EXPECT_EQ(expected[i].count, counted[i].count);
+      }
+    }
+  }
+
+  TEST(HistogramTest, MergeAddsPartials) {
+    common::color_histogram first(4, 65535);
+    common::color_histogram second(4, 65535);
+    first.add(common::pack_color(1, 2, 3));
+    first.add(common::pack_color(3, 2, 1));
+    second.add(common::pack_color(1, 2, 3), 2);
+    second.add(common::pack_color(65535, 0, 0));
+    first.merge(second);
+    auto const counts = first.counts();
+    ASSERT_EQ(counts.size(), 3U);
+    EXPECT_EQ(counts[0].key, common::pack_color(1, 2, 3));
+    EXPECT_EQ(counts[0].count, 3U);
+    EXPECT_EQ(counts[1].count, 1U);
+    EXPECT_EQ(counts[2].key, common::pack_color(65535, 0, 0));
+  }
+
+  TEST(HistogramTest, HashSeparatesPermutations) {
+    EXPECT_NE(common::hash_color(common::pack_color(1, 2, 3)), common::hash_color(common::pack_color(3, 2, 1)));
+    EXPECT_NE(common::hash_color(common::pack_color(1, 2, 3)), common::hash_color(common::pack_color(2, 1, 3)));
+  }
+
+  TEST(HistogramTest, LeastFrequentBreaksTiesByBlue) {
+    std::vector<common::color_count> const counts = {{.key = common::pack_color(0, 0, 1), .count = 2},
+                                                     {.key = common::pack_color(9, 0, 0), .count = 1},
+                                                     {.key = common::pack_color(0, 0, 5), .count = 1},
+                                                     {.key = common::pack_color(0, 4, 0), .count = 1}};
+    auto const keys = common::least_frequent(counts, 3);
+    ASSERT_EQ(keys.size(), 3U);
+    EXPECT_EQ(keys[0], common::pack_color(0, 0, 5));
+    EXPECT_EQ(keys[1], common::pack_color(0, 4, 0));
+    EXPECT_EQ(keys[2], common::pack_color(9, 0, 0));
+  }
+
+  TEST(HistogramTest, LeastFrequentMatchesFullSort) {
+    std::vector<common::color_count> counts;
+    for (std::uint64_t i = 0; i < 2000; ++i) {
+      counts.push_back({.key   = common::pack_color((i * 13) % 7, (i * 29) % 11, i),
+                        .count = static_cast<std::uint32_t>(i % 5)});
+    }
+    std::vector<common::color_count> sorted = counts;
+    std::ranges::sort(sorted, [](common::color_count const & left, common::color_count const & right) {
+      if (left.count != right.count) { return left.count < right.count; }
+      if (common::key_blue(left.key) != common::key_blue(right.key)) {
+        return common::key_blue(left.key) > common::key_blue(right.key);
+      }
+      if (common::key_green(left.key) != common::key_green(right.key)) {
+        return common::key_green(left.key) > common::key_green(right.key);
+      }
+      return common::key_red(left.key) > common::key_red(right.key);
+    });
+    for (std::size_t const n : std::vector<std::size_t>{0, 1, 37, 2000, 5000}) {
+      auto const keys = common::least_frequent(counts, n);
+      ASSERT_EQ(keys.size(), std::min(n, sorted.size()));
+      for (std::size_t i = 0; i < keys.size(); ++i) { EXPECT_EQ(keys[i], sorted[i].key); }
+    }
+  }
+
+  TEST(NearestTest, MatchesBruteForce) {
+    std::vector<std::uint64_t> colors;
+    for (std::uint64_t i = 0; i < 300; ++i) {
+      colors.push_back(common::pack_color((i * 37) % 251, (i * 91) % 241, (i * i) % 239));
+    }
+    common::color_index const index(colors);
+    for (std::uint64_t i = 0; i < 200; ++i) {
+      std::uint64_t const query = common::pack_color((i * 53) % 256, (i * 17) % 256, (i * 131) % 256);
+      auto const distance = [query](std::uint64_t color) {
+        auto const axis = [](int left, int right) {
+          return static_cast<std::uint64_t>((left - right) * (left - right));
+        };
+        return axis(common::key_red(query), common::key_red(color)) +
+               axis(common::key_green(query), common::key_green(color)) +
+               axis(common::key_blue(query), common::key_blue(color));
+      };
+      auto const best = std::ranges::min(colors, [&](std::uint64_t left, std::uint64_t right) {
+        return distance(left) != distance(right) ? distance(left) < distance(right) : left < right;
+      });
+      EXPECT_EQ(index.nearest(query), best);
+    }
+  }
+
+  TEST(NearestTest, TiesPickSmallestKey) {
+    std::vector<std::uint64_t> const colors = {common::pack_color(12, 10, 10), common::pack_color(8, 10, 10),
+                                               common::pack_color(10, 10, 200)};
+    common::color_index const index(colors);
+    EXPECT_EQ(index.nearest(common::pack_color(10, 10, 10)), common::pack_color(8, 10, 10));
+    EXPECT_EQ(common::color_index({}).nearest(common::pack_color(1, 2, 3)), common::pack_color(1, 2, 3));
+  }
+
+  TEST(NearestTest, PlanSkipsRemovedColors) {
+    common::color_histogram histogram(11, 255);
+    histogram.add(common::pack_color(0, 0, 0), 5);
+    histogram.add(common::pack_color(0, 0, 1));
+    histogram.add(common::pack_color(0, 0, 2));
+    histogram.add(common::pack_color(0, 0, 9), 4);
+    auto const plan = common::plan_cutfreq(histogram, 2, 2);
+    ASSERT_EQ(plan.removed.size(), 2U);
+    EXPECT_EQ(plan.removed[0], common::pack_color(0, 0, 2));
+    EXPECT_EQ(plan.removed[1], common::pack_color(0, 0, 1));
+    EXPECT_EQ(plan.replacement[0], common::pack_color(0, 0, 0));
+    EXPECT_EQ(plan.replacement[1], common::pack_color(0, 0, 0));
+  }
+
+  TEST(NearestTest, RemapReplacesOnlyRemovedColors) {
+    common::cutfreq_plan const narrow{.removed = {common::pack_color(1, 2, 3), common::pack_color(0, 0, 9)},
+                                      .replacement = {common::pack_color(1, 2, 4), common::pack_color(0, 0, 8)}};
+    common::color_remap const dense(narrow);
+    EXPECT_EQ(dense(common::pack_color(1, 2, 3)), common::pack_color(1, 2, 4));
+    EXPECT_EQ(dense(common::pack_color(0, 0, 9)), common::pack_color(0, 0, 8));
+    EXPECT_EQ(dense(common::pack_color(3, 2, 1)), common::pack_color(3, 2, 1));
+    EXPECT_EQ(dense(common::pack_color(257, 2, 3)), common::pack_color(257, 2, 3));
+
+    common::cutfreq_plan const wide{.removed = {common::pack_color(1000, 2, 3), common::pack_color(1, 2, 3)},
+                                    .replacement = {common::pack_color(999, 2, 3), common::pack_color(0, 2, 3)}};
+    common::color_remap const hashed(wide);
+    EXPECT_EQ(hashed(common::pack_color(1000, 2, 3)), common::pack_color(999, 2, 3));
+    EXPECT_EQ(hashed(common::pack_color(1, 2, 3)), common::pack_color(0, 2, 3));
+    EXPECT_EQ(hashed(common::pack_color(3, 2, 1)), common::pack_color(3, 2, 1));
+  }
+
+  TEST(ProbeTest, ReadsHeadersBeyondFirstBlock) {
+    {
+      std::ofstream file("probe_long.ppm", std::ios::binary);
+      file << "P6\n# " << std::string(2 * common::PROBE_BYTES, 'x') << "\n1234 567\n65535\n" << std::string(8, '\0');
+      std::ofstream palette("probe_palette.cppm", std::ios::binary);
+      palette << "C6 7 5 255 3\n" << std::string(9, '\1');
+      std::ofstream other("probe_other.ppm", std::ios::binary);
+      other << "P3 1 1 255\n";
+    }
+    common::image_header header;
+    ASSERT_TRUE(common::probe_header("probe_long.ppm", header));
+    EXPECT_EQ(header.magic, "P6");
+    EXPECT_EQ(header.width, 1234U);
+    EXPECT_EQ(header.height, 567U);
+    EXPECT_EQ(header.max_color, 65535);
+    ASSERT_TRUE(common::probe_header("probe_palette.cppm", header));
+    EXPECT_EQ(header.magic, "C6");
+    EXPECT_EQ(header.colors, 3U);
+    EXPECT_FALSE(common::probe_header("probe_other.ppm", header));
+    EXPECT_FALSE(common::probe_header("probe_missing.ppm", header));
+  }
+
+  TEST(ProbeTest, BatchKeepsDirectoryOrder) {
+    std::filesystem::path const directory = "probe_batch";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directory(directory);
+    constexpr std::size_t files = 150;  // Más de un bloque de sondeo
+    for (std::size_t i = 0; i < files; ++i) {
+      std::ofstream file(directory / ("image" + std::to_string(1000 + i) + ".ppm"), std::ios::binary);
+      file << (i == 3 ? "PX" : "P6") << " " << i + 1 << " 2 255\n";
+    }
+    std::filesystem::create_directory(directory / "nested");
+    auto const listed = common::list_files(directory.string());
+    ASSERT_EQ(listed.size(), files);
+    auto const probes = common::probe_headers(listed, 4);
+    ASSERT_EQ(probes.size(), files);
+    for (std::size_t i = 0; i < files; ++i) {
+      EXPECT_EQ(probes[i].path, listed[i]);
+      EXPECT_EQ(probes[i].valid, i != 3);
+      if (i != 3) { EXPECT_EQ(probes[i].header.width, i + 1); }
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(BatchTest, ManifestSkipsCommentsAndBlankLines) {
+    {
+      std::ofstream manifest("batch_manifest.txt");
+      manifest << "# entrada salida operación\n\na.ppm b.ppm resize 10 20 --filter box\n  c.ppm  d.cppm compress\n";
+    }
+    std::vector<common::batch_job> jobs;
+    ASSERT_TRUE(common::read_manifest("batch_manifest.txt", "imtool", jobs));
+    ASSERT_EQ(jobs.size(), 2U);
+    EXPECT_EQ(jobs[0], (common::batch_job{"imtool", "a.ppm", "b.ppm", "resize", "10", "20", "--filter", "box"}));
+    EXPECT_EQ(jobs[1], (common::batch_job{"imtool", "c.ppm", "d.cppm", "compress"}));
+    EXPECT_FALSE(common::read_manifest("batch_missing.txt", "imtool", jobs));
+  }
+
+  TEST(BatchTest, DirectoryJobsNameOutputsByOperation) {
+    std::filesystem::path const directory = "batch_directory";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directory(directory);
+    std::ofstream(directory / "a.ppm").close();
+    std::ofstream(directory / "b.cppm").close();
+    auto const jobs_for = [&directory](std::vector<std::string> const & operation) {
+      return common::directory_jobs("imtool", directory.string(), "out", operation);
+    };
+    auto const outputs = [](std::vector<common::batch_job> const & jobs) {
+      std::vector<std::string> names;
+      for (auto const & job : jobs) { names.push_back(std::filesystem::path(job[2]).filename().string()); }
+      return names;
+    };
+    EXPECT_EQ(outputs(jobs_for({"compress"})), (std::vector<std::string>{"a.cppm", "b.cppm"}));
+    EXPECT_EQ(outputs(jobs_for({"decompress"})), (std::vector<std::string>{"a.ppm", "b.ppm"}));
+    auto const resized = jobs_for({"resize", "10", "20"});
+    EXPECT_EQ(outputs(resized), (std::vector<std::string>{"a.ppm", "b.cppm"}));
+    EXPECT_EQ(resized[0], (common::batch_job{"imtool", (directory / "a.ppm").string(),
+                                             (std::filesystem::path("out") / "a.ppm").string(), "resize", "10", "20"}));
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(BatchTest, RunCountsFailuresAndReusesBuffers) {
+    std::vector<common::batch_job> jobs(40, common::batch_job{"imtool", "in.ppm", "out.ppm", "compress"});
+    jobs[7][1] = "throw";
+    jobs[9][1] = "fail";
+    std::atomic<std::size_t> reused{0};
+    std::ostringstream const errors;
+    std::streambuf * old_cerr = std::cerr.rdbuf(errors.rdbuf());
+    std::size_t const failed = common::run_batch(jobs, 3, [&](common::batch_job const & job, unsigned int threads) {
+      EXPECT_EQ(threads, 1U);
+      if (job[1] == "throw") { throw std::runtime_error("broken"); }
+      auto buffer = common::take_buffer<int>(1000);
+      if (buffer.capacity() >= 1000 && buffer[0] == 1) { ++reused; }
+      buffer[0] = 1;
+      common::recycle_buffer(std::move(buffer));
+      return job[1] != "fail";
+    });
+    std::cerr.rdbuf(old_cerr);
+    EXPECT_EQ(failed, 2U);
+    EXPECT_EQ(errors.str(), "throw: broken\n");
+    EXPECT_GT(reused.load(), 0U);
+    EXPECT_EQ(common::job_threads(2, 8), 4U);
+    EXPECT_EQ(common::job_threads(0, 8), 8U);
+
+    // Fuera del modo batch no se guarda nada
+    common::recycle_buffer(std::vector<long>(100));
+    EXPECT_EQ(common::take_buffer<long>(0).capacity(), 0U);
+  }
+
+  TEST(BatchTest, RecycleKeepsAByteBudget) {
+    common::recycle_scope const recycling;
+    // Un búfer mayor que todo el presupuesto se libera en lugar de guardarse
+    std::vector<char> huge;
+    huge.reserve(common::SPARE_BYTES + 1);
+    common::recycle_buffer(std::move(huge));
+    EXPECT_EQ(huge.capacity(), 0U);
+    EXPECT_EQ(common::take_buffer<char>(0).capacity(), 0U);
+
+    // Entre todos los tipos no se guarda más de SPARE_BYTES
+    constexpr std::size_t quarter = common::SPARE_BYTES / 4;
+    for (int round = 0; round < 2; ++round) {
+      std::vector<std::uint8_t> bytes;
+      bytes.reserve(quarter);
+      std::vector<std::uint16_t> words;
+      words.reserve(quarter / 2);
+      std::vector<std::uint32_t> wide;
+      wide.reserve(quarter / 4);
+      common::recycle_buffer(std::move(bytes));
+      common::recycle_buffer(std::move(words));
+      common::recycle_buffer(std::move(wide));
+      EXPECT_LE(common::detail::spare_bytes(), common::SPARE_BYTES);
+    }
+    EXPECT_GE(common::take_buffer<std::uint32_t>(0).capacity(), quarter / 4);
+  }
 
 }  // namespace common::test
 
@@ -6,7 +6,6 @@
 #include <gtest/gtest.h>
 #include <map>
 #include <vector>
-static constexpr int GRID_SIZE = 8;
 
 // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
 // NOLINTBEGIN(readability-magic-numbers)
@@ -32,7 +31,7 @@ TEST(CompressTest, NonExistentInputFile) {
     progargsCommon::parameters_files const params = {.input_file = "nonexistent.ppm", .output_file = "output.cppm"};
 
     testing::internal::CaptureStderr();
-    imgsoa::compress(params);
+    EXPECT_FALSE(imgsoa::compress(params));
     std::string const output = testing::internal::GetCapturedStderr();
 
     EXPECT_TRUE(output.find("Error opening file nonexistent.ppm") != std::string::npos);
@@ -50,7 +49,7 @@ TEST(CompressTest, OutputFileGeneration) {
     input.close();
 
     progargsCommon::parameters_files const params = {.input_file = input_filename, .output_file = "test_output.cppm"};
-    imgsoa::compress(params);
+    ASSERT_TRUE(imgsoa::compress(params));
 
     std::ifstream output("test_output.cppm", std::ios::binary);
     ASSERT_TRUE(output.is_open());
@@ -75,7 +74,7 @@ TEST(CompressTest, HighColorDepthHandling) {
     input.close();
 
     progargsCommon::parameters_files const params = {.input_file = input_filename, .output_file = "output.cppm"};
-    imgsoa::compress(params);
+    ASSERT_TRUE(imgsoa::compress(params));
 
     std::ifstream output("output.cppm", std::ios::binary);
     ASSERT_TRUE(output.is_open());
@@ -109,7 +108,7 @@ TEST(CompressTest, EmptyInputFile) {
     progargsCommon::parameters_files const params = {.input_file = filename, .output_file = "output.cppm"};
 
     testing::internal::CaptureStderr();
-    imgsoa::compress(params);
+    EXPECT_FALSE(imgsoa::compress(params));
     std::string const output = testing::internal::GetCapturedStderr();
 
     EXPECT_TRUE(output.find("Error opening file") != std::string::npos);
@@ -126,7 +125,7 @@ TEST(CompressTest, IncorrectPPMHeader) {
     progargsCommon::parameters_files const params = {.input_file = filename, .output_file = "output.cppm"};
 
     testing::internal::CaptureStderr();
-    imgsoa::compress(params);
+    EXPECT_FALSE(imgsoa::compress(params));
     std::string const output = testing::internal::GetCapturedStderr();
 
     EXPECT_TRUE(output.find("Invalid file type, the file") != std::string::npos);
@@ -147,7 +146,7 @@ TEST(CompressTest, SinglePixelImage) {
     file.close();
 
     progargsCommon::parameters_files const params = {.input_file = filename, .output_file = "output.cppm"};
-    imgsoa::compress(params);
+    ASSERT_TRUE(imgsoa::compress(params));
 
     std::ifstream output("output.cppm", std::ios::binary);
     ASSERT_TRUE(output.is_open());
@@ -326,99 +325,6 @@ TEST(ImageSOATest, GetLeastFrequentColors_SameFrequency) {
     EXPECT_EQ(colorsToRemove.size(), 2);
 }
 
-// Test para buildGridOptimized - Caso 1: Imagen con colores repetidos
-TEST(ImageSOATest, BuildGridOptimized_RepeatedColors) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {255, 255, 0, 0};
-    image.g = {0, 0, 255, 0};
-    image.b = {0, 0, 0, 255};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    EXPECT_EQ(grid.size(), 3);
-}
-
-// Test para buildGridOptimized - Caso 2: Imagen sin colores repetidos
-TEST(ImageSOATest, BuildGridOptimized_UniqueColors) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {255, 0, 0, 255};
-    image.g = {0, 255, 0, 255};
-    image.b = {0, 0, 255, 255};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    EXPECT_EQ(grid.size(), 4);
-}
-
-// Test para buildGridOptimized - Caso 3: Imagen con colores en los límites del grid
-TEST(ImageSOATest, BuildGridOptimized_BoundaryColors) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {0, 255};
-    image.g = {0, 255};
-    image.b = {0, 255};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    EXPECT_EQ(grid.size(), 2);
-}
-
-// Test para findClosestColorOptimized - Caso 1: Color objetivo cercano a un color en la imagen
-TEST(ImageSOATest, FindClosestColorOptimized_NearColor) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {255, 0, 0, 128};
-    image.g = {0, 255, 0, 128};
-    image.b = {0, 0, 255, 128};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    std::tuple<int, int, int> const targetColor = {127, 127, 127};
-    auto closestColor =  imgsoa::findClosestColorOptimized(targetColor, grid, GRID_SIZE);
-
-    EXPECT_EQ(closestColor, std::make_tuple(128, 128, 128));
-}
-
-// Test para findClosestColorOptimized - Caso 2: Color objetivo igual a un color en la imagen
-TEST(ImageSOATest, FindClosestColorOptimized_ExactColor) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {255, 0, 0, 128};
-    image.g = {0, 255, 0, 128};
-    image.b = {0, 0, 255, 128};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    std::tuple<int, int, int> const targetColor = {255, 0, 0};
-    auto closestColor = imgsoa::findClosestColorOptimized(targetColor, grid, GRID_SIZE);
-
-    EXPECT_EQ(closestColor, std::make_tuple(255, 0, 0));
-}
-
-// Test para findClosestColorOptimized - Caso 3: Color objetivo fuera del rango de la imagen
-TEST(ImageSOATest, FindClosestColorOptimized_OutOfRange) {
-    imgsoa::ImageSOA image;
-    image.width = 2;
-    image.height = 2;
-    image.r = {255, 0, 0};
-    image.g = {0, 255, 0};
-    image.b = {0, 0, 255};
-
-    auto grid = buildGridOptimized(image, GRID_SIZE);
-
-    std::tuple<int, int, int> const targetColor = {300, 300, 300};
-    auto closestColor = imgsoa::findClosestColorOptimized(targetColor, grid, GRID_SIZE);
-
-    EXPECT_EQ(closestColor, std::make_tuple(0, 0, 0));
-}
-
 TEST(PhotoTest, LoadFunctionFileNotFound) {
     imgsoa::Photo photo;
     // Attempt to load a non-existent file and verify that the function fails without causing a segmentation fault
@@ -452,6 +358,19 @@ TEST(PhotoTest, SaveFunctionFileNotWritable) {
     ASSERT_FALSE(imgsoa::savePhoto("/invalid_path/output_image.ppm", photo));
 }
 
+// Test that a write error (full disk) is reported as false instead of escaping as an exception
+TEST(PhotoTest, SaveFunctionWriteError) {
+    imgsoa::Photo photo;
+    photo.magicNumber   = "P6";
+    photo.width         = 2;
+    photo.height        = 1;
+    photo.maxColorValue = 255;
+    photo.red           = {1, 4};
+    photo.green         = {2, 5};
+    photo.blue          = {3, 6};
+    EXPECT_FALSE(imgsoa::savePhoto("/dev/full", photo));
+}
+
 // Case 1: from 255 to 128
 TEST(MaxLevelTest, MaxLevelScaling_255to128) {
     imgsoa::Photo photo;
@@ -785,9 +704,149 @@ TEST(ImageResizeTest, ResizeNonUniformDimensionsSOA) {
     EXPECT_EQ(resizedImage.r.size(), static_cast<size_t>(newWidth * newHeight));
 }
 
+// Test para maxlevel por bandas: misma salida que el procesamiento en memoria
+TEST(StreamMaxlevelTest, MatchesInMemorySOA) {
+    std::ofstream file("stream_input.ppm", std::ios::binary);
+    file << "P6 3 5 255\n";
+    for (int i = 0; i < 45; ++i) {
+        file << static_cast<char>(i * 5);
+    }
+    file.close();
+
+    std::vector<std::string> const args = {"imtool", "stream_input.ppm", "memory.ppm", "maxlevel", "1000"};
+    progargsCommon::parameters_files const memory = {.input_file="stream_input.ppm", .output_file="memory.ppm"};
+    progargsCommon::parameters_files const banded = {.input_file="stream_input.ppm", .output_file="banded.ppm"};
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(imgsoa::handle_maxlevel_optionSOA(args, memory));
+    (void)testing::internal::GetCapturedStdout();
+    std::ifstream memory_file("memory.ppm", std::ios::binary);
+    std::string const expected((std::istreambuf_iterator<char>(memory_file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(expected.size(), 12 + 90);
+
+    // Bandas de una fila, de dos (la última incompleta) y una sola banda con la imagen entera
+    for (std::size_t const rows : {1UL, 2UL, 0UL}) {
+        ASSERT_TRUE(imgsoa::streamMaxlevel(banded, 1000, common::rounding::truncate, rows));
+        std::ifstream banded_file("banded.ppm", std::ios::binary);
+        std::string const actual((std::istreambuf_iterator<char>(banded_file)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(actual, expected) << rows;
+    }
+
+    (void)std::remove("stream_input.ppm");
+    (void)std::remove("memory.ppm");
+    (void)std::remove("banded.ppm");
+}
+
+// Test para decompress con un fichero que no es C6
+TEST(DecompressTest, RejectsPPMInputSOA) {
+    std::ofstream file("not_cppm.ppm", std::ios::binary);
+    file << "P6 1 1 255\n" << static_cast<char>(1) << static_cast<char>(2) << static_cast<char>(3);
+    file.close();
+
+    progargsCommon::parameters_files const params = {.input_file="not_cppm.ppm", .output_file="out.ppm"};
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgsoa::decompress(params));
+    std::string const output = testing::internal::GetCapturedStderr();
+    EXPECT_NE(output.find("must be in CPPM format"), std::string::npos);
+
+    (void)std::remove("not_cppm.ppm");
+}
+
+// Test para compress: el fichero completo (cabecera, paleta e índices) tiene el formato de imtool-aos
+TEST(CompressTest, SingleHandleLayoutSOA) {
+    std::ofstream file("layout.ppm", std::ios::binary);
+    file << "P6\n2 2\n255\n";
+    for (int const value : {9, 9, 9, 1, 2, 3, 9, 9, 9, 0, 0, 0}) {
+        file << static_cast<char>(value);
+    }
+    file.close();
+
+    progargsCommon::parameters_files const params = {.input_file="layout.ppm", .output_file="layout.cppm"};
+    ASSERT_TRUE(imgsoa::compress(params));
+
+    std::ifstream output("layout.cppm", std::ios::binary);
+    std::string const result((std::istreambuf_iterator<char>(output)), std::istreambuf_iterator<char>());
+    std::string const expected = std::string("C6 2 2 255 3\n") +
+                                 std::string("\x00\x00\x00\x01\x02\x03\x09\x09\x09", 9) +
+                                 std::string("\x02\x01\x02\x00", 4);
+    EXPECT_EQ(result, expected);
+
+    // Un error de escritura de la salida hace fallar compress
+    progargsCommon::parameters_files const full = {.input_file="layout.ppm", .output_file="/dev/full"};
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgsoa::compress(full));
+    (void)testing::internal::GetCapturedStderr();
+
+    (void)std::remove("layout.ppm");
+    (void)std::remove("layout.cppm");
+}
+
+// Test para los planos compactos: maxlevel de 16 a 8 bits coincide con la versión de Photo
+TEST(CompactPlanesTest, MaxlevelNarrowsSamples) {
+    imgsoa::PlanesOf<uint16_t> const input{.r = {0, 1000, 65535}, .g = {1, 2, 3}, .b = {40000, 5, 6},
+                                           .width = 3, .height = 1, .max_color = 65535};
+    imgsoa::Photo photo{.magicNumber = "P6", .width = 3, .height = 1, .maxColorValue = 65535,
+                        .red = {0, 1000, 65535}, .green = {1, 2, 3}, .blue = {40000, 5, 6}};
+    common::level_table const table(65535, 255);
+    imgsoa::PlanesOf<uint8_t> output;
+    imgsoa::maxlevel(input, output, table);
+    imgsoa::maxlevel(photo, table);
+
+    EXPECT_EQ(output.max_color, 255);
+    EXPECT_EQ(std::vector<unsigned int>(output.r.begin(), output.r.end()), photo.red);
+    EXPECT_EQ(std::vector<unsigned int>(output.g.begin(), output.g.end()), photo.green);
+    EXPECT_EQ(std::vector<unsigned int>(output.b.begin(), output.b.end()), photo.blue);
+}
+
+// Test para resize sobre planos de 8 bits: mismo resultado que Picture
+TEST(CompactPlanesTest, ResizeMatchesPicture) {
+    imgsoa::PlanesOf<uint8_t> const planes{.r = {0, 100, 200, 250}, .g = {10, 20, 30, 40}, .b = {255, 0, 255, 0},
+                                           .width = 2, .height = 2, .max_color = 255};
+    imgsoa::Picture picture;
+    picture.r = planes.r;
+    picture.g = planes.g;
+    picture.b = planes.b;
+    picture.width = 2;
+    picture.height = 2;
+
+    imgsoa::PlanesOf<uint8_t> const resized = imgsoa::resizeImage(planes, 5, 3);
+    imgsoa::Picture const expected = imgsoa::resizeImage(picture, 5, 3);
+    EXPECT_EQ(resized.width, 5U);
+    EXPECT_EQ(resized.max_color, 255);
+    EXPECT_EQ(resized.r, expected.r);
+    EXPECT_EQ(resized.g, expected.g);
+    EXPECT_EQ(resized.b, expected.b);
+}
+
+// Test para cutfreq con varios hilos: mismo resultado que en secuencial
+TEST(CompactPlanesTest, CutfreqThreadsMatchSerial) {
+    imgsoa::PlanesOf<uint8_t> serial{.r = {}, .g = {}, .b = {}, .width = 512, .height = 256, .max_color = 255};
+    for (std::size_t i = 0; i < serial.width * serial.height; ++i) {
+        serial.r.push_back(static_cast<uint8_t>((i * 7) % 61));
+        serial.g.push_back(static_cast<uint8_t>((i * i) % 53));
+        serial.b.push_back(static_cast<uint8_t>(i % 47));
+    }
+    imgsoa::PlanesOf<uint8_t> threaded = serial;
+    imgsoa::cutfreq(serial, 300);
+    imgsoa::cutfreq(threaded, 300, 4);
+    EXPECT_EQ(threaded.r, serial.r);
+    EXPECT_EQ(threaded.g, serial.g);
+    EXPECT_EQ(threaded.b, serial.b);
+}
+
 // NOLINTEND(readability-magic-numbers)
 // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
 
+// Test para callCutfreq: un número de colores no positivo o una entrada que no existe hacen fallar
+// la operación sin lanzar excepciones
+TEST(CallCutfreqTest, ReportsFailuresSOA) {
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgsoa::callCutfreq({"imtool", "missing.ppm", "out.ppm", "cutfreq", "0"}));
+    EXPECT_FALSE(imgsoa::callCutfreq({"imtool", "missing.ppm", "out.ppm", "cutfreq", "3"}));
+    std::string const errors = testing::internal::GetCapturedStderr();
+    EXPECT_NE(errors.find("colores a eliminar"), std::string::npos);
+    EXPECT_NE(errors.find("missing.ppm"), std::string::npos);
+}
+
 int main(int argc, char **argv) {
 ::testing::InitGoogleTest(&argc, argv);
 return RUN_ALL_TESTS();
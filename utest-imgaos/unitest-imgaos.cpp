@@ -7,14 +7,13 @@
 #include "common/progargs.hpp"
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 #include <vector>
 #include <fstream>
 
 
-static constexpr int GRID_SIZE = 8;
-
 // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
 // NOLINTBEGIN(readability-magic-numbers)
 
@@ -146,6 +145,10 @@ TEST(WriteDataCPPMTest, SixteenBitColorDepth) {
     std::getline(file, line);
     EXPECT_EQ(line, "C6 2 2 65535 4");
 
+    // La tabla de colores ocupa 2 bytes por canal: 4 colores * 6 bytes + 4 índices de 1 byte
+    std::string const rest((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(rest.size(), 28);
+
     file.close();
     (void)std::remove(filename.c_str());
 }
@@ -162,7 +165,7 @@ TEST(CompressTest, ValidPPMFile) {
     file.close();
 
     progargsCommon::parameters_files params = {.input_file="test_valid.ppm", .output_file="test_output.cppm"};
-    imgaos::compress(params);
+    ASSERT_TRUE(imgaos::compress(params));
 
     std::ifstream output_file("test_output.cppm", std::ios::binary);
     ASSERT_TRUE(output_file.is_open());
@@ -187,7 +190,7 @@ TEST(CompressTest, InvalidPPMFileFormat) {
 
   // Capturar la salida de error estándar
   testing::internal::CaptureStderr();
-  imgaos::compress(params);
+  EXPECT_FALSE(imgaos::compress(params));
   std::string const output = testing::internal::GetCapturedStderr();
 
   // Verificar que el mensaje de error contenga la advertencia esperada
@@ -317,81 +320,6 @@ TEST(ImageAOSTest, GetLeastFrequentColors_SameFrequency) {
     EXPECT_EQ(colorsToRemove.size(), 2);
 }
 
-// Test para buildGrid - Caso 1: Imagen con colores repetidos
-TEST(ImageAOSTest, BuildGrid_RepeatedColors) {
-    std::vector<imgaos::Pixel> const image1 = {
-            {.r=255, .g=0, .b=0}, {.r=255, .g=0, .b=0}, {.r=0, .g=255, .b=0}, {.r=0, .g=0, .b=255}
-    };
-    auto grid1 = imgaos::buildGrid(image1, 8);
-
-    EXPECT_EQ(grid1.size(), 3);
-}
-
-// Test para buildGrid - Caso 2: Imagen sin colores repetidos
-TEST(ImageAOSTest, BuildGrid_UniqueColors) {
-    std::vector<imgaos::Pixel> const image2 = {
-            {.r=255, .g=0, .b=0}, {.r=0, .g=255, .b=0}, {.r=0, .g=0, .b=255}, {.r=255, .g=255, .b=255}
-    };
-    auto grid2 = imgaos::buildGrid(image2, 8);
-
-    EXPECT_EQ(grid2.size(), 4);
-}
-
-// Test para buildGrid - Caso 3: Imagen con colores en los límites del grid
-TEST(ImageAOSTest, BuildGrid_BoundaryColors) {
-    std::vector<imgaos::Pixel> const image = {
-            {.r=0, .g=0, .b=0}, {.r=255, .g=255, .b=255}
-    };
-    auto grid = imgaos::buildGrid(image, 8);
-
-    EXPECT_EQ(grid.size(), 2);
-}
-
-// Test para findClosestColorOptimized - Caso 1: Color objetivo cercano a un color en la imagen
-TEST(ImageAOSTest, FindClosestColorOptimized_NearColor) {
-    std::vector<imgaos::Pixel> const image1 = {
-            {.r=255, .g=0, .b=0}, {.r=0, .g=255, .b=0}, {.r=0, .g=0, .b=255}, {.r=128, .g=128, .b=128}
-    };
-    auto grid1 = imgaos::buildGrid(image1, GRID_SIZE);
-
-    imgaos::Pixel const targetColor1 = {.r=127, .g=127, .b=127};
-    imgaos::Pixel const closestColor1 = imgaos::findClosestColorOptimized(targetColor1, grid1, GRID_SIZE);
-
-    EXPECT_EQ(closestColor1.r, 128);
-    EXPECT_EQ(closestColor1.g, 128);
-    EXPECT_EQ(closestColor1.b, 128);
-}
-
-// Test para findClosestColorOptimized - Caso 2: Color objetivo igual a un color en la imagen
-TEST(ImageAOSTest, FindClosestColorOptimized_ExactColor) {
-    std::vector<imgaos::Pixel> const image1 = {
-            {.r=255, .g=0, .b=0}, {.r=0, .g=255, .b=0}, {.r=0, .g=0, .b=255}, {.r=128, .g=128, .b=128}
-    };
-    auto grid1 = imgaos::buildGrid(image1, GRID_SIZE);
-
-    imgaos::Pixel const targetColor2 = {.r=255, .g=0, .b=0};
-    imgaos::Pixel const closestColor2 = imgaos::findClosestColorOptimized(targetColor2, grid1, GRID_SIZE);
-
-    EXPECT_EQ(closestColor2.r, 255);
-    EXPECT_EQ(closestColor2.g, 0);
-    EXPECT_EQ(closestColor2.b, 0);
-}
-
-// Test para findClosestColorOptimized - Caso 3: Color objetivo fuera del rango de la imagen
-TEST(ImageAOSTest, FindClosestColorOptimized_OutOfRange) {
-    std::vector<imgaos::Pixel> const image = {
-            {.r=255, .g=0, .b=0}, {.r=0, .g=255, .b=0}, {.r=0, .g=0, .b=255}
-    };
-    auto grid = imgaos::buildGrid(image, GRID_SIZE);
-
-    imgaos::Pixel const targetColor = {.r=300, .g=300, .b=300};
-    imgaos::Pixel const closestColor = imgaos::findClosestColorOptimized(targetColor, grid, GRID_SIZE);
-
-    EXPECT_EQ(closestColor.r, 0);
-    EXPECT_EQ(closestColor.g, 0);
-    EXPECT_EQ(closestColor.b, 0);
-}
-
 TEST(PhotoTest, LoadFunctionFileNotFound) {
     imgaos::Photo photo;
     // Intenta cargar un archivo que no existe y verifica que la función falle sin causar un fallo de segmentación
@@ -427,6 +355,18 @@ TEST(PhotoTest, SaveFunctionFileNotWritable) {
     ASSERT_FALSE(imgaos::savePhoto(photo, "/invalid_path/output_image.ppm"));
 }
 
+// Test para verificar que un error de escritura (disco lleno) se devuelve como false y no como excepción
+TEST(PhotoTest, SaveFunctionWriteError) {
+    imgaos::Photo photo;
+    photo.magicNumber   = "P6";
+    photo.width         = 2;
+    photo.height        = 1;
+    photo.maxColorValue = 255;
+    photo.pixels        = {{.r = 1, .g = 2, .b = 3}, {.r = 4, .g = 5, .b = 6}};
+    EXPECT_FALSE(imgaos::savePhoto(photo, "/dev/full"));
+    EXPECT_FALSE(imgaos::savePPM("/dev/full", {{{.r = 1, .g = 2, .b = 3}}}));
+}
+
 // Caso 1: de 255 a 128
 TEST(MaxLevelTest, MaxLevelScaling_255to128) {
     imgaos::Photo photo;
@@ -725,9 +665,205 @@ TEST(ImageResizeTest, ResizeToVeryLargeSize) {
     EXPECT_EQ(resizedImage[0].size(), static_cast<size_t>(newWidth));
 }
 
+// Test para maxlevel por bandas: misma salida que el procesamiento en memoria
+TEST(StreamMaxlevelTest, MatchesInMemoryAOS) {
+    std::ofstream file("stream_input.ppm", std::ios::binary);
+    file << "P6 3 5 255\n";
+    for (int i = 0; i < 45; ++i) {
+        file << static_cast<char>(i * 5);
+    }
+    file.close();
+
+    std::vector<std::string> const args = {"imtool", "stream_input.ppm", "memory.ppm", "maxlevel", "1000"};
+    progargsCommon::parameters_files const memory = {.input_file="stream_input.ppm", .output_file="memory.ppm"};
+    progargsCommon::parameters_files const banded = {.input_file="stream_input.ppm", .output_file="banded.ppm"};
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(imgaos::handle_maxlevel_optionAOS(args, memory));
+    (void)testing::internal::GetCapturedStdout();
+    std::ifstream memory_file("memory.ppm", std::ios::binary);
+    std::string const expected((std::istreambuf_iterator<char>(memory_file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(expected.size(), 12 + 90);
+
+    // Bandas de una fila, de dos (la última incompleta) y una sola banda con la imagen entera
+    for (std::size_t const rows : {1UL, 2UL, 0UL}) {
+        ASSERT_TRUE(imgaos::streamMaxlevel(banded, 1000, common::rounding::truncate, rows));
+        std::ifstream banded_file("banded.ppm", std::ios::binary);
+        std::string const actual((std::istreambuf_iterator<char>(banded_file)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(actual, expected) << rows;
+    }
+
+    (void)std::remove("stream_input.ppm");
+    (void)std::remove("memory.ppm");
+    (void)std::remove("banded.ppm");
+}
+
+// Test para decompress: compress seguido de decompress reproduce la imagen original
+TEST(DecompressTest, RoundTripAOS) {
+    std::string const original = std::string("P6\n3 2\n255\n") + std::string("\x01\x02\x03\xff\x00\x00\x01\x02\x03"
+                                                                            "\x00\x00\x00\xff\x00\x00\x07\x08\x09", 18);
+    std::ofstream file("roundtrip.ppm", std::ios::binary);
+    file << original;
+    file.close();
+
+    progargsCommon::parameters_files compressed = {.input_file="roundtrip.ppm", .output_file="roundtrip.cppm"};
+    ASSERT_TRUE(imgaos::compress(compressed));
+    progargsCommon::parameters_files const restored = {.input_file="roundtrip.cppm", .output_file="restored.ppm"};
+    EXPECT_TRUE(imgaos::decompress(restored));
+
+    std::ifstream restored_file("restored.ppm", std::ios::binary);
+    std::string const result((std::istreambuf_iterator<char>(restored_file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(result, original);
+
+    // Un error de escritura de la salida hace fallar compress
+    progargsCommon::parameters_files full = {.input_file="roundtrip.ppm", .output_file="/dev/full"};
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgaos::compress(full));
+    (void)testing::internal::GetCapturedStderr();
+
+    (void)std::remove("roundtrip.ppm");
+    (void)std::remove("roundtrip.cppm");
+    (void)std::remove("restored.ppm");
+}
+
+// Test para las imágenes compactas: maxlevel de 8 a 16 bits coincide con la versión de Photo
+TEST(CompactImageTest, MaxlevelWidensSamples) {
+    imgaos::ImageOf<uint8_t> const input{.width = 2, .height = 1, .max_color = 255,
+                                         .pixels = {{.r = 0, .g = 128, .b = 255}, {.r = 7, .g = 8, .b = 9}}};
+    imgaos::Photo photo{.magicNumber = "P6", .width = 2, .height = 1, .maxColorValue = 255,
+                        .pixels = {{.r = 0, .g = 128, .b = 255}, {.r = 7, .g = 8, .b = 9}}};
+    common::level_table const table(255, 1000);
+    imgaos::ImageOf<uint16_t> output;
+    imgaos::maxlevel(input, output, table);
+    imgaos::maxlevel(photo, table);
+
+    EXPECT_EQ(output.max_color, 1000);
+    ASSERT_EQ(output.pixels.size(), photo.pixels.size());
+    for (std::size_t i = 0; i < photo.pixels.size(); ++i) {
+        EXPECT_EQ(output.pixels[i].r, photo.pixels[i].r);
+        EXPECT_EQ(output.pixels[i].g, photo.pixels[i].g);
+        EXPECT_EQ(output.pixels[i].b, photo.pixels[i].b);
+    }
+}
+
+// Test para cutfreq sobre muestras de 16 bits: el resultado solo contiene colores de la imagen
+TEST(CompactImageTest, CutfreqSixteenBit) {
+    imgaos::ImageOf<uint16_t> image{.width = 4, .height = 1, .max_color = 65535,
+                                    .pixels = {{.r = 1000, .g = 1000, .b = 1000}, {.r = 1000, .g = 1000, .b = 1000},
+                                               {.r = 1001, .g = 1000, .b = 1000}, {.r = 60000, .g = 0, .b = 0}}};
+    std::vector<imgaos::PixelOf<uint16_t>> const original = image.pixels;
+    imgaos::cutfreq(image, 1);
+    for (auto const & pixel : image.pixels) {
+        EXPECT_NE(std::ranges::find(original, pixel), original.end());
+    }
+    EXPECT_THROW(imgaos::cutfreq(image, 0), std::invalid_argument);
+}
+
+// Test para resize: una imagen de 16 bits conserva su maxval y sus muestras de 2 bytes
+TEST(CompactImageTest, ResizeKeepsSixteenBitSamples) {
+    std::ofstream file("wide_input.ppm", std::ios::binary);
+    file << "P6\n2 2\n1000\n";
+    // Muestras de 16 bits en orden nativo (little-endian): (1000, 0, 500) en los cuatro píxeles
+    std::string const pixel("\xe8\x03\x00\x00\xf4\x01", 6);
+    file << pixel << pixel << pixel << pixel;
+    file.close();
+
+    progargsCommon::parameters_files const params = {.input_file="wide_input.ppm", .output_file="wide_output.ppm"};
+    EXPECT_TRUE(imgaos::resize(params, 3, 2));
+
+    std::ifstream result_file("wide_output.ppm", std::ios::binary);
+    std::string const result((std::istreambuf_iterator<char>(result_file)), std::istreambuf_iterator<char>());
+    std::string const header = "P6\n3 2\n1000\n";
+    ASSERT_EQ(result.size(), header.size() + (6 * pixel.size()));
+    EXPECT_EQ(result.substr(0, header.size()), header);
+    EXPECT_EQ(result.substr(header.size()), pixel + pixel + pixel + pixel + pixel + pixel);
+
+    (void)std::remove("wide_input.ppm");
+    (void)std::remove("wide_output.ppm");
+}
+
+// Test para resize con varios tamaños y --stream: cada tamaño coincide con el resize en memoria
+TEST(CompactImageTest, StreamResizeManyMatchesSingle) {
+    std::ofstream file("many_input.ppm", std::ios::binary);
+    file << "P6\n4 3\n255\n";
+    for (int i = 0; i < 36; ++i) {
+        file << static_cast<char>(i * 7);
+    }
+    file.close();
+
+    auto const read_file = [](std::string const & name) {
+        std::ifstream input(name, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    };
+    progargsCommon::options streamed;
+    streamed.stream = true;
+    progargsCommon::parameters_files const many = {.input_file="many_input.ppm", .output_file="many.ppm"};
+    ASSERT_TRUE(imgaos::resizeMany(many, {{.width = 3, .height = 2}, {.width = 6, .height = 5}}, streamed));
+    for (auto const & [width, height, name] : {std::tuple{3, 2, "many-3x2.ppm"}, std::tuple{6, 5, "many-6x5.ppm"}}) {
+        progargsCommon::parameters_files const single = {.input_file="many_input.ppm", .output_file="single.ppm"};
+        ASSERT_TRUE(imgaos::resize(single, width, height));
+        EXPECT_EQ(read_file(name), read_file("single.ppm")) << name;
+        (void)std::remove(name);
+    }
+    streamed.filter = common::resize_filter::box;
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgaos::resizeMany(many, {{.width = 3, .height = 2}}, streamed));
+    (void)testing::internal::GetCapturedStderr();
+
+    (void)std::remove("many_input.ppm");
+    (void)std::remove("single.ppm");
+}
+
+// Test para resize sobre el búfer contiguo: mismo resultado que la versión por filas
+TEST(CompactImageTest, FlatResizeMatchesRows) {
+    std::vector<std::vector<imgaos::Pixel>> const rows = {
+        {{.r = 0, .g = 10, .b = 255}, {.r = 100, .g = 20, .b = 0}, {.r = 50, .g = 50, .b = 50}},
+        {{.r = 200, .g = 30, .b = 255}, {.r = 250, .g = 40, .b = 0}, {.r = 1, .g = 2, .b = 3}}};
+    imgaos::ImageOf<uint8_t> flat{.width = 3, .height = 2, .max_color = 255, .pixels = {}};
+    for (auto const & row : rows) {
+        for (auto const & pixel : row) {
+            flat.pixels.push_back({.r = static_cast<uint8_t>(pixel.r), .g = static_cast<uint8_t>(pixel.g),
+                                   .b = static_cast<uint8_t>(pixel.b)});
+        }
+    }
+
+    auto const expected = imgaos::resizeImage(rows, 7, 5);
+    imgaos::ImageOf<uint8_t> const resized = imgaos::resizeImage(flat, 7, 5);
+    ASSERT_EQ(resized.pixels.size(), 35U);
+    for (std::size_t i = 0; i < resized.pixels.size(); ++i) {
+        imgaos::Pixel const & pixel = expected[i / 7][i % 7];
+        EXPECT_EQ(resized.pixels[i].r, pixel.r);
+        EXPECT_EQ(resized.pixels[i].g, pixel.g);
+        EXPECT_EQ(resized.pixels[i].b, pixel.b);
+    }
+}
+
+// Test para cutfreq con varios hilos: mismo resultado que en secuencial
+TEST(CompactImageTest, CutfreqThreadsMatchSerial) {
+    imgaos::ImageOf<uint8_t> serial{.width = 512, .height = 256, .max_color = 255, .pixels = {}};
+    for (std::size_t i = 0; i < serial.width * serial.height; ++i) {
+        serial.pixels.push_back({.r = static_cast<uint8_t>((i * 7) % 61), .g = static_cast<uint8_t>((i * i) % 53),
+                                 .b = static_cast<uint8_t>(i % 47)});
+    }
+    imgaos::ImageOf<uint8_t> threaded = serial;
+    imgaos::cutfreq(serial, 300);
+    imgaos::cutfreq(threaded, 300, 4);
+    EXPECT_EQ(threaded.pixels, serial.pixels);
+}
+
 // NOLINTEND(readability-magic-numbers)
 // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
 
+// Test para callCutfreq: un número de colores no positivo o una entrada que no existe hacen fallar
+// la operación sin lanzar excepciones
+TEST(CallCutfreqTest, ReportsFailures) {
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(imgaos::callCutfreq({"imtool", "missing.ppm", "out.ppm", "cutfreq", "0"}));
+    EXPECT_FALSE(imgaos::callCutfreq({"imtool", "missing.ppm", "out.ppm", "cutfreq", "3"}));
+    std::string const errors = testing::internal::GetCapturedStderr();
+    EXPECT_NE(errors.find("colores a eliminar"), std::string::npos);
+    EXPECT_NE(errors.find("missing.ppm"), std::string::npos);
+}
+
 int main(int argc, char **argv) {
 ::testing::InitGoogleTest(&argc, argv);
 return RUN_ALL_TESTS();